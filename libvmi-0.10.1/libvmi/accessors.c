@@ -41,6 +41,33 @@ vmi_get_page_mode(
     }
 }
 
+status_t
+vmi_set_page_mode(
+    vmi_instance_t vmi,
+    page_mode_t page_mode)
+{
+    switch (page_mode) {
+    case VMI_PM_LEGACY:
+        vmi->pae = vmi->lme = 0;
+        break;
+    case VMI_PM_PAE:
+        vmi->pae = 1;
+        vmi->lme = 0;
+        break;
+    case VMI_PM_IA32E:
+        vmi->pae = vmi->lme = 1;
+        break;
+    default:
+        errprint("Unknown page mode %d\n", page_mode);
+        return VMI_FAILURE;
+    }
+
+    vmi->page_mode = page_mode;
+    v2p_select(vmi);
+    v2p_cache_flush(vmi);
+    return VMI_SUCCESS;
+}
+
 uint8_t vmi_get_address_width(
     vmi_instance_t vmi)
 {
@@ -204,6 +231,7 @@ status_t
 vmi_pause_vm(
     vmi_instance_t vmi)
 {
+    cache_epoch_advance(vmi);
     return driver_pause_vm(vmi);
 }
 
@@ -211,6 +239,7 @@ status_t
 vmi_resume_vm(
     vmi_instance_t vmi)
 {
+    cache_epoch_advance(vmi);
     return driver_resume_vm(vmi);
 }
 
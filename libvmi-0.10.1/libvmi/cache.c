@@ -38,9 +38,75 @@
 #include <string.h>
 
 #include "glib_compat.h"
+#include "driver/memory_cache.h"
+
+/* prefer the cheap coarse clock where the platform has one */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define EPOCH_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define EPOCH_CLOCK CLOCK_MONOTONIC
+#endif
+
+//
+// Cache epochs
+// Entries are stamped with the epoch they were filled in rather than the
+// wall clock.  The epoch advances on pause/resume and on v2p cache flushes
+// and, when the epoch clock is enabled, once for every second that has
+// passed.  Reading the epoch is free unless the clock is enabled.
+uint64_t
+cache_epoch(
+    vmi_instance_t vmi)
+{
+    if (vmi->epoch_clock) {
+        struct timespec now;
+
+        clock_gettime(EPOCH_CLOCK, &now);
+        if (now.tv_sec != vmi->epoch_clock_sec) {
+            if (vmi->epoch_clock_sec) {
+                vmi->epoch += now.tv_sec - vmi->epoch_clock_sec;
+            }
+            vmi->epoch_clock_sec = now.tv_sec;
+        }
+    }
+    return vmi->epoch;
+}
+
+void
+cache_epoch_advance(
+    vmi_instance_t vmi)
+{
+    vmi->epoch++;
+}
 
 #if ENABLE_ADDRESS_CACHE == 1
 
+/*
+ * Unmapped pages and the dtbs of pids can also be given a time bound of
+ * their own (see vmi_set_cache_recheck_age), which leaves the epoch and
+ * the translations stamped with it alone.  Zero while there is no bound.
+ */
+static inline time_t
+cache_recheck_clock(
+    vmi_instance_t vmi)
+{
+    struct timespec now;
+
+    if (!vmi->recheck_age) {
+        return 0;
+    }
+    clock_gettime(EPOCH_CLOCK, &now);
+    return now.tv_sec;
+}
+
+static inline int
+cache_recheck_due(
+    vmi_instance_t vmi,
+    time_t found)
+{
+    return vmi->recheck_age &&
+        cache_recheck_clock(vmi) - found >= vmi->recheck_age;
+}
+
 /* Custom 128-bit key functions */
 struct key_128 {
     uint64_t low;
@@ -83,7 +149,7 @@ static gboolean key_128_equals(gconstpointer key1, gconstpointer key2){
  */
 static void key_128_init(vmi_instance_t vmi, key_128_t key, uint64_t low, uint64_t high)
 {
-    low = (low & ~(vmi->page_size - 1));
+    low = (low & ~((uint64_t)vmi->page_size - 1));
     key->low = low;
     key->high = high;
 }
@@ -95,13 +161,35 @@ static key_128_t key_128_build (vmi_instance_t vmi, uint64_t low, uint64_t high)
     return key;
 }
 
+/* Sum the sizes of the per-(base, pid) tables of the sym and rva caches */
+static void
+nested_table_size(
+    gpointer key,
+    gpointer value,
+    gpointer data)
+{
+    *(uint64_t *) data += g_hash_table_size((GHashTable *) value);
+}
+
+static uint64_t
+nested_cache_size(
+    GHashTable *cache)
+{
+    uint64_t size = 0;
+
+    g_hash_table_foreach(cache, nested_table_size, &size);
+    return size;
+}
+
 //
 // PID --> DTB cache implementation
 // Note: DTB is a physical address
 struct pid_cache_entry {
     int pid;
     addr_t dtb;
-    time_t last_used;
+    uint64_t last_used;
+    uint64_t epoch;     /* epoch the dtb was found in */
+    time_t found;       /* cache_recheck_clock when it was found */
 };
 typedef struct pid_cache_entry *pid_cache_entry_t;
 
@@ -125,6 +213,7 @@ pid_cache_entry_free(
 
 static pid_cache_entry_t
 pid_cache_entry_create(
+    vmi_instance_t vmi,
     int pid,
     addr_t dtb)
 {
@@ -132,7 +221,9 @@ pid_cache_entry_create(
         (pid_cache_entry_t) safe_malloc(sizeof(struct pid_cache_entry));
     entry->pid = pid;
     entry->dtb = dtb;
-    entry->last_used = time(NULL);
+    entry->last_used = cache_epoch(vmi);
+    entry->epoch = entry->last_used;
+    entry->found = cache_recheck_clock(vmi);
     return entry;
 }
 
@@ -161,13 +252,16 @@ pid_cache_get(
     pid_cache_entry_t entry = NULL;
     gint key = (gint) pid;
 
+    vmi->cache_stats[VMI_CACHE_PID].lookups++;
     if ((entry = g_hash_table_lookup(vmi->pid_cache, &key)) != NULL) {
-        entry->last_used = time(NULL);
+        entry->last_used = cache_epoch(vmi);
         *dtb = entry->dtb;
+        vmi->cache_stats[VMI_CACHE_PID].hits++;
         dbprint("--PID cache hit %d -- 0x%.16"PRIx64"\n", pid, *dtb);
         return VMI_SUCCESS;
     }
 
+    vmi->cache_stats[VMI_CACHE_PID].misses++;
     return VMI_FAILURE;
 }
 
@@ -180,9 +274,10 @@ pid_cache_set(
     gint *key = (gint *) safe_malloc(sizeof(gint));
 
     *key = pid;
-    pid_cache_entry_t entry = pid_cache_entry_create(pid, dtb);
+    pid_cache_entry_t entry = pid_cache_entry_create(vmi, pid, dtb);
 
     g_hash_table_insert(vmi->pid_cache, key, entry);
+    vmi->cache_stats[VMI_CACHE_PID].inserts++;
     dbprint("--PID cache set %d -- 0x%.16"PRIx64"\n", pid, dtb);
 }
 
@@ -195,6 +290,7 @@ pid_cache_del(
 
     dbprint("--PID cache del %d\n", pid);
     if (TRUE == g_hash_table_remove(vmi->pid_cache, &key)) {
+        vmi->cache_stats[VMI_CACHE_PID].evictions++;
         return VMI_SUCCESS;
     }
     else {
@@ -202,10 +298,31 @@ pid_cache_del(
     }
 }
 
+/*
+ * The dtb of an entry found in an earlier epoch, or longer ago than the
+ * recheck age, may belong to a process that has exited since.
+ */
+int
+pid_cache_stale(
+    vmi_instance_t vmi,
+    int pid)
+{
+    pid_cache_entry_t entry = NULL;
+    gint key = (gint) pid;
+
+    if ((entry = g_hash_table_lookup(vmi->pid_cache, &key)) == NULL) {
+        return 0;
+    }
+    return entry->epoch != cache_epoch(vmi) ||
+        cache_recheck_due(vmi, entry->found);
+}
+
 void
 pid_cache_flush(
     vmi_instance_t vmi)
 {
+    vmi->cache_stats[VMI_CACHE_PID].evictions +=
+        g_hash_table_size(vmi->pid_cache);
     g_hash_table_remove_all(vmi->pid_cache);
     dbprint("--PID cache flushed\n");
 }
@@ -215,7 +332,7 @@ pid_cache_flush(
 struct sym_cache_entry {
     char *sym;
     addr_t va;
-    time_t last_used;
+    uint64_t last_used;
     addr_t base_addr;
     uint32_t pid;
 };
@@ -236,6 +353,7 @@ sym_cache_entry_free(
 
 static sym_cache_entry_t
 sym_cache_entry_create(
+    vmi_instance_t vmi,
     char *sym,
     addr_t va,
     addr_t base_addr,
@@ -247,7 +365,7 @@ sym_cache_entry_create(
     entry->va = va;
     entry->base_addr=base_addr,
     entry->pid=pid,
-    entry->last_used = time(NULL);
+    entry->last_used = cache_epoch(vmi);
     return entry;
 }
 
@@ -285,16 +403,22 @@ sym_cache_get(
     key_128_t key = &local_key;
     key_128_init(vmi, key, (uint64_t)base_addr, (uint64_t)pid);
 
+    vmi->cache_stats[VMI_CACHE_SYM].lookups++;
     if ((symbol_table = g_hash_table_lookup(vmi->sym_cache, key)) == NULL) {
+        vmi->cache_stats[VMI_CACHE_SYM].misses++;
         return ret;
     }
 
     if ((entry = g_hash_table_lookup(symbol_table, sym)) != NULL) {
-        entry->last_used = time(NULL);
+        entry->last_used = cache_epoch(vmi);
         *va = entry->va;
         dbprint("--SYM cache hit %u:0x%.16"PRIx64":%s -- 0x%.16"PRIx64"\n", pid, base_addr, sym, *va);
+        vmi->cache_stats[VMI_CACHE_SYM].hits++;
         ret=VMI_SUCCESS;
     }
+    else {
+        vmi->cache_stats[VMI_CACHE_SYM].misses++;
+    }
 
     return ret;
 }
@@ -308,7 +432,7 @@ sym_cache_set(
     addr_t va)
 {
     GHashTable *symbol_table = NULL;
-    sym_cache_entry_t entry = sym_cache_entry_create(sym, va, base_addr, pid);
+    sym_cache_entry_t entry = sym_cache_entry_create(vmi, sym, va, base_addr, pid);
 
     key_128_t key = key_128_build(vmi, (uint64_t)base_addr, (uint64_t)pid);
 
@@ -320,8 +444,10 @@ sym_cache_set(
         free(key);
     }
 
-    g_hash_table_insert(symbol_table, sym, entry);
-    dbprint("--SYM cache set %s -- 0x%.16"PRIx64"\n", key, va);
+    /* key on the entry's copy of sym, the caller's may not outlive it */
+    g_hash_table_replace(symbol_table, entry->sym, entry);
+    vmi->cache_stats[VMI_CACHE_SYM].inserts++;
+    dbprint("--SYM cache set %u:0x%.16"PRIx64":%s -- 0x%.16"PRIx64"\n", pid, base_addr, sym, va);
 }
 
 status_t
@@ -344,6 +470,7 @@ sym_cache_del(
     dbprint("--SYM cache del %u:0x%.16"PRIx64":%s\n", pid, base_addr, sym);
 
     if (TRUE == g_hash_table_remove(symbol_table, sym)) {
+        vmi->cache_stats[VMI_CACHE_SYM].evictions++;
         ret=VMI_SUCCESS;
 
         if(!g_hash_table_size(symbol_table)) {
@@ -358,6 +485,8 @@ void
 sym_cache_flush(
     vmi_instance_t vmi)
 {
+    vmi->cache_stats[VMI_CACHE_SYM].evictions +=
+        nested_cache_size(vmi->sym_cache);
     g_hash_table_remove_all(vmi->sym_cache);
     dbprint("--SYM cache flushed\n");
 }
@@ -395,21 +524,28 @@ rva_cache_get(
     key_128_t key = &local_key;
     key_128_init(vmi, key, (uint64_t)base_addr, (uint64_t)pid);
 
+    vmi->cache_stats[VMI_CACHE_RVA].lookups++;
     if ((rva_table = g_hash_table_lookup(vmi->rva_cache, key)) == NULL) {
+        vmi->cache_stats[VMI_CACHE_RVA].misses++;
         return ret;
     }
 
-    if ((entry = g_hash_table_lookup(rva_table, GUINT_TO_POINTER(rva))) != NULL) {
-        entry->last_used = time(NULL);
+    if ((entry = g_hash_table_lookup(rva_table, &rva)) != NULL) {
+        entry->last_used = cache_epoch(vmi);
         *sym = entry->sym;
         dbprint("--RVA cache hit %u:0x%.16"PRIx64":%s -- 0x%.16"PRIx64"\n", pid, base_addr, *sym, rva);
+        vmi->cache_stats[VMI_CACHE_RVA].hits++;
         ret=VMI_SUCCESS;
     }
+    else {
+        vmi->cache_stats[VMI_CACHE_RVA].misses++;
+    }
 
     return ret;
 }
 
-void
+/* returns the cached copy of sym */
+char *
 rva_cache_set(
     vmi_instance_t vmi,
     addr_t base_addr,
@@ -418,20 +554,24 @@ rva_cache_set(
     char *sym)
 {
     GHashTable *rva_table = NULL;
-    sym_cache_entry_t entry = sym_cache_entry_create(sym, rva, base_addr, pid);
+    sym_cache_entry_t entry = sym_cache_entry_create(vmi, sym, rva, base_addr, pid);
 
     key_128_t key = key_128_build(vmi, (uint64_t)base_addr, (uint64_t)pid);
 
     if ((rva_table = g_hash_table_lookup(vmi->rva_cache, key)) == NULL) {
-        rva_table = g_hash_table_new_full(g_int_hash, g_int_equal, NULL,
+        /* entries are keyed by their own 64-bit va field */
+        rva_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
                               sym_cache_entry_free);
-        g_hash_table_insert(vmi->rva_cache, GUINT_TO_POINTER(key), rva_table);
+        g_hash_table_insert(vmi->rva_cache, key, rva_table);
     } else {
         free(key);
     }
 
-    g_hash_table_insert(rva_table, GUINT_TO_POINTER(rva), entry);
-    dbprint("--RVA cache set %s -- 0x%.16"PRIx64"\n", key, rva);
+    /* replace the key too, it lives in the entry being freed */
+    g_hash_table_replace(rva_table, &entry->va, entry);
+    vmi->cache_stats[VMI_CACHE_RVA].inserts++;
+    dbprint("--RVA cache set %u:0x%.16"PRIx64":%s -- 0x%.16"PRIx64"\n", pid, base_addr, sym, rva);
+    return entry->sym;
 }
 
 status_t
@@ -451,9 +591,10 @@ rva_cache_del(
         return ret;
     }
 
-    dbprint("--RVA cache del %u:0x%.16"PRIx64":%s\n", pid, base_addr, rva);
+    dbprint("--RVA cache del %u:0x%.16"PRIx64" -- 0x%.16"PRIx64"\n", pid, base_addr, rva);
 
-    if (TRUE == g_hash_table_remove(rva_table, GUINT_TO_POINTER(rva))) {
+    if (TRUE == g_hash_table_remove(rva_table, &rva)) {
+        vmi->cache_stats[VMI_CACHE_RVA].evictions++;
         ret=VMI_SUCCESS;
 
         if(!g_hash_table_size(rva_table)) {
@@ -468,253 +609,1370 @@ void
 rva_cache_flush(
     vmi_instance_t vmi)
 {
+    vmi->cache_stats[VMI_CACHE_RVA].evictions +=
+        nested_cache_size(vmi->rva_cache);
     g_hash_table_remove_all(vmi->rva_cache);
     dbprint("--RVA cache flushed\n");
 }
 
 //
-// Virtual address --> Physical address cache implementation
-struct v2p_cache_entry {
-    addr_t pa;
-    addr_t last_used;
+// Paging-structure cache implementation
+// Like the paging-structure caches of the processor, present upper-level
+// entries are kept by dtb and by the region of the address space that they
+// map, so a walk only reads the levels below the deepest entry found here.
+// The entries live and die with the v2p cache.  The table has a fixed
+// number of slots and an entry simply replaces the one its key hashes to.
+#define PT_CACHE_ENTRIES    (1 << 12)
+
+struct pt_cache_entry {
+    struct key_128 key;
+    uint64_t value;
+    uint64_t stamp;     /* v2p_dtb_stamp when the entry was filled in */
 };
-typedef struct v2p_cache_entry *v2p_cache_entry_t;
 
-static v2p_cache_entry_t v2p_cache_entry_create (vmi_instance_t vmi, addr_t pa)
+static uint64_t v2p_dtb_stamp(vmi_instance_t vmi, addr_t dtb);
+
+static inline struct pt_cache_entry *
+pt_cache_slot(
+    vmi_instance_t vmi,
+    key_128_t key)
 {
-    v2p_cache_entry_t entry = (v2p_cache_entry_t) safe_malloc(sizeof(struct v2p_cache_entry));
-    pa &= ~((addr_t)vmi->page_size - 1);
-    entry->pa = pa;
-    entry->last_used = time(NULL);
-    return entry;
+    return &vmi->pt_cache[hash128to64(key->low, key->high) &
+                          (PT_CACHE_ENTRIES - 1)];
 }
 
-void
-v2p_cache_init(
-    vmi_instance_t vmi)
+static inline int
+pt_cache_entry_live(
+    vmi_instance_t vmi,
+    struct pt_cache_entry *entry)
 {
-    vmi->v2p_cache = g_hash_table_new_full((GHashFunc) key_128_hash, key_128_equals, g_free, g_free);
+    return entry->key.low &&
+        entry->stamp == v2p_dtb_stamp(vmi, entry->key.high);
 }
 
-void
-v2p_cache_destroy(
+/* entries that have not expired, the only ones a lookup can return */
+static uint64_t
+pt_cache_live(
     vmi_instance_t vmi)
 {
-    g_hash_table_destroy(vmi->v2p_cache);
+    uint64_t live = 0;
+    int i = 0;
+
+    for (i = 0; i < PT_CACHE_ENTRIES; ++i) {
+        if (pt_cache_entry_live(vmi, &vmi->pt_cache[i])) {
+            live++;
+        }
+    }
+    return live;
+}
+
+static void
+pt_cache_key_init(
+    key_128_t key,
+    addr_t dtb,
+    addr_t va,
+    int shift)
+{
+    key->low = ((va >> shift) << shift) | shift;
+    key->high = dtb;
 }
 
+/*
+ * The stats count guest reads: a hit stands for the entry found and the
+ * \a levels - 1 entries above it that the walk no longer reads.
+ */
 status_t
-v2p_cache_get(
+pt_cache_get(
     vmi_instance_t vmi,
-    addr_t va,
     addr_t dtb,
-    addr_t *pa)
+    addr_t va,
+    int shift,
+    int levels,
+    uint64_t *value)
 {
-    v2p_cache_entry_t entry = NULL;
+    struct pt_cache_entry *entry = NULL;
     struct key_128 local_key;
-    key_128_t key = &local_key;
 
-    key_128_init(vmi, key, (uint64_t)va, (uint64_t)dtb);
-
-    if ((entry = g_hash_table_lookup(vmi->v2p_cache, key)) != NULL) {
-
-        entry->last_used = time(NULL);
-        *pa = entry->pa | ((vmi->page_size - 1) & va);
-        dbprint("--V2P cache hit 0x%.16"PRIx64" -- 0x%.16"PRIx64" (0x%.16"PRIx64"/0x%.16"PRIx64")\n",
-                va, *pa, key->high, key->low);
-        return VMI_SUCCESS;
+    pt_cache_key_init(&local_key, dtb, va, shift);
+    entry = pt_cache_slot(vmi, &local_key);
+    if (entry->key.low != local_key.low || entry->key.high != local_key.high) {
+        return VMI_FAILURE;
+    }
+    if (entry->stamp != v2p_dtb_stamp(vmi, dtb)) {
+        memset(entry, 0, sizeof(struct pt_cache_entry));
+        vmi->cache_stats[VMI_CACHE_PAGING].evictions++;
+        return VMI_FAILURE;
     }
 
-    return VMI_FAILURE;
+    vmi->cache_stats[VMI_CACHE_PAGING].lookups += levels;
+    vmi->cache_stats[VMI_CACHE_PAGING].hits += levels;
+    *value = entry->value;
+    return VMI_SUCCESS;
 }
 
 void
-v2p_cache_set(
+pt_cache_set(
     vmi_instance_t vmi,
-    addr_t va,
     addr_t dtb,
-    addr_t pa)
+    addr_t va,
+    int shift,
+    uint64_t value)
 {
-    if (!va || !dtb || !pa) {
-        return;
+    struct pt_cache_entry *entry = NULL;
+    struct key_128 local_key;
+
+    pt_cache_key_init(&local_key, dtb, va, shift);
+    entry = pt_cache_slot(vmi, &local_key);
+    if (pt_cache_entry_live(vmi, entry) &&
+        (entry->key.low != local_key.low || entry->key.high != local_key.high)) {
+        vmi->cache_stats[VMI_CACHE_PAGING].evictions++;
     }
-    key_128_t key = key_128_build(vmi, (uint64_t)va, (uint64_t)dtb);
-    v2p_cache_entry_t entry = v2p_cache_entry_create(vmi, pa);
-    g_hash_table_insert(vmi->v2p_cache, key, entry);
-    dbprint("--V2P cache set 0x%.16"PRIx64" -- 0x%.16"PRIx64" (0x%.16"PRIx64"/0x%.16"PRIx64")\n", va,
-            pa, key->high, key->low);
+    entry->key = local_key;
+    entry->value = value;
+    entry->stamp = v2p_dtb_stamp(vmi, dtb);
+    vmi->cache_stats[VMI_CACHE_PAGING].lookups++;
+    vmi->cache_stats[VMI_CACHE_PAGING].misses++;
+    vmi->cache_stats[VMI_CACHE_PAGING].inserts++;
 }
 
+//
+// Unmapped page cache implementation
+// Pages that a walk found unmapped, by dtb and page, so that probing a
+// sparse region does not walk the page tables again for every read.  Like
+// the v2p cache, entries expire with the epoch and with flushes of their
+// dtb, and also once they reach the recheck age; a full table is simply
+// emptied.
+#define V2P_MISS_ENTRIES    (1 << 16)
+
+struct v2p_miss_entry {
+    struct key_128 key;
+    uint64_t stamp;     /* v2p_dtb_stamp when the page was found unmapped */
+    time_t found;       /* cache_recheck_clock at the same time */
+};
+
 status_t
-v2p_cache_del(
+v2p_miss_get(
     vmi_instance_t vmi,
     addr_t va,
     addr_t dtb)
 {
+    struct v2p_miss_entry *entry = NULL;
     struct key_128 local_key;
-    key_128_t key = &local_key;
-    key_128_init(vmi, key, (uint64_t)va, (uint64_t)dtb);
-    dbprint("--V2P cache del 0x%.16"PRIx64" (0x%.16"PRIx64"/0x%.16"PRIx64")\n", va,
-            key->high, key->low);
 
-    // key collision doesn't really matter here because worst case
-    // scenario we incur an small performance hit
-
-    if (TRUE == g_hash_table_remove(vmi->v2p_cache, key)){
-        return VMI_SUCCESS;
+    local_key.low = va >> vmi->page_shift;
+    local_key.high = dtb;
+    vmi->cache_stats[VMI_CACHE_V2P_MISS].lookups++;
+    if ((entry = g_hash_table_lookup(vmi->v2p_misses, &local_key)) == NULL) {
+        vmi->cache_stats[VMI_CACHE_V2P_MISS].misses++;
+        return VMI_FAILURE;
     }
-    else{
+    if (entry->stamp != v2p_dtb_stamp(vmi, dtb) ||
+        cache_recheck_due(vmi, entry->found)) {
+        g_hash_table_remove(vmi->v2p_misses, &local_key);
+        vmi->cache_stats[VMI_CACHE_V2P_MISS].evictions++;
+        vmi->cache_stats[VMI_CACHE_V2P_MISS].misses++;
         return VMI_FAILURE;
     }
+
+    vmi->cache_stats[VMI_CACHE_V2P_MISS].hits++;
+    dbprint("--V2P miss cache hit 0x%.16"PRIx64" (0x%.16"PRIx64")\n", va, dtb);
+    return VMI_SUCCESS;
 }
 
 void
-v2p_cache_flush(
-    vmi_instance_t vmi)
+v2p_miss_set(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb)
 {
-    g_hash_table_remove_all(vmi->v2p_cache);
-    dbprint("--V2P cache flushed\n");
+    struct v2p_miss_entry *entry = NULL;
+
+    if (!dtb) {
+        return;
+    }
+    if (g_hash_table_size(vmi->v2p_misses) >= V2P_MISS_ENTRIES) {
+        vmi->cache_stats[VMI_CACHE_V2P_MISS].evictions +=
+            g_hash_table_size(vmi->v2p_misses);
+        g_hash_table_remove_all(vmi->v2p_misses);
+    }
+
+    entry = (struct v2p_miss_entry *) safe_malloc(sizeof(struct v2p_miss_entry));
+    entry->key.low = va >> vmi->page_shift;
+    entry->key.high = dtb;
+    entry->stamp = v2p_dtb_stamp(vmi, dtb);
+    entry->found = cache_recheck_clock(vmi);
+    g_hash_table_replace(vmi->v2p_misses, &entry->key, entry);
+    vmi->cache_stats[VMI_CACHE_V2P_MISS].inserts++;
 }
 
-#else
-void
-pid_cache_init(
-    vmi_instance_t vmi)
+static void
+v2p_miss_del(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb)
 {
-    return;
+    struct key_128 local_key;
+
+    local_key.low = va >> vmi->page_shift;
+    local_key.high = dtb;
+    if (g_hash_table_remove(vmi->v2p_misses, &local_key)) {
+        vmi->cache_stats[VMI_CACHE_V2P_MISS].evictions++;
+    }
 }
 
-void
-pid_cache_destroy(
-    vmi_instance_t vmi)
+//
+// Virtual address --> Physical address cache implementation
+// A fixed number of 32-byte slots, grouped into buckets of eight that fill
+// four cache lines.  A translation lives in the bucket its key hashes to and
+// a CLOCK sweep over a full bucket picks the slot to reuse, so the cache
+// never grows beyond its capacity (see vmi_set_v2p_cache_capacity).
+// Each entry maps a whole page of the size that the page tables use, so a
+// single entry covers a 2MB, 4MB or 1GB mapping.  The size is part of the
+// key and lookups only probe the sizes that have entries.
+// Hits are not checked against guest memory.  Entries are only trusted in
+// the epoch they were filled in, and writes to page tables and CR3 events
+// drop them explicitly.  Advancing the epoch is all it takes to flush.
+// Each entry is stamped with the generation of its dtb, and flushing a dtb
+// only hands that dtb a new stamp, so a CR3 event costs the same however
+// large the cache is.  Dtbs share V2P_DTB_STAMPS generations by hash, and
+// a flush may drop the entries of another dtb with the same one.
+#define V2P_CACHE_WAYS      8
+#define V2P_CACHE_ENTRIES   (1 << 16)
+#define V2P_DTB_STAMPS      1024
+
+/* flags kept in the low bits of the page-aligned physical address */
+#define V2P_SLOT_VALID      0x1
+#define V2P_SLOT_REFERENCED 0x2
+
+struct v2p_cache_slot {
+    uint64_t key;       /* va of the page | page shift */
+    addr_t dtb;
+    addr_t pa;          /* pa of the page | V2P_SLOT_* flags */
+    uint64_t stamp;     /* v2p_dtb_stamp when the entry was filled in */
+};
+
+/*
+ * The last few translations that were hit are also kept in a small fully
+ * associative array, checked before the table like a processor's TLB.
+ * Translations only enter it when they are used a second time.
+ */
+#define V2P_TLB_ENTRIES     16
+
+struct v2p_tlb_entry {
+    addr_t page;        /* va >> page_shift */
+    addr_t dtb;
+    addr_t pa;          /* pa of the page */
+    uint32_t page_shift;/* 0 if unused */
+    uint64_t epoch;     /* epoch the entry was filled in */
+};
+
+struct v2p_cache {
+    struct v2p_cache_slot *slots;
+    uint32_t buckets;   /* power of two, may be 0 if allocation failed */
+    uint32_t hand;      /* CLOCK hand, taken modulo the bucket size */
+    uint64_t live;      /* entries filled in live_epoch */
+    uint64_t live_epoch;
+    uint64_t stamp;     /* last stamp handed out */
+    uint64_t epoch_stamp;   /* stamp handed out when live_epoch began */
+    uint64_t dtb_stamp[V2P_DTB_STAMPS]; /* stamp of the last flush */
+    uint32_t dtb_live[V2P_DTB_STAMPS];  /* live entries by stamp */
+    struct v2p_tlb_entry tlb[V2P_TLB_ENTRIES];
+    uint32_t tlb_next;  /* next tlb entry to replace */
+    uint32_t tlb_last;  /* tlb entry hit last, checked first */
+};
+
+static const uint32_t v2p_page_shifts[] = {
+    12, PT_SHIFT_PDE, PT_SHIFT_PDE_NOPAE, PT_SHIFT_PDPTE
+};
+
+static inline uint64_t
+v2p_cache_key(
+    addr_t va,
+    uint32_t page_shift)
 {
-    return;
+    return ((va >> page_shift) << page_shift) | page_shift;
 }
 
-status_t
-pid_cache_get(
-    vmi_instance_t vmi,
-    int pid,
-    addr_t *dtb)
+/*
+ * Runs of eight pages hash together and take consecutive buckets, so that
+ * walking through a buffer stays within a few cache lines of the table.
+ */
+static inline struct v2p_cache_slot *
+v2p_cache_bucket(
+    struct v2p_cache *cache,
+    uint64_t key,
+    addr_t dtb)
 {
-    return VMI_FAILURE;
+    uint32_t page_shift = key & 0xfff;
+    uint64_t page = key >> page_shift;
+    uint64_t hash = hash128to64(((page >> 3) << 8) | page_shift, dtb) + (page & 7);
+
+    return cache->slots + (hash & (cache->buckets - 1)) * V2P_CACHE_WAYS;
 }
 
-void
-pid_cache_set(
-    vmi_instance_t vmi,
-    int pid,
-    addr_t dtb)
+static inline int
+v2p_slot_live(
+    struct v2p_cache_slot *slot,
+    uint64_t stamp)
 {
-    return;
+    return (slot->pa & V2P_SLOT_VALID) && slot->stamp == stamp;
 }
 
-status_t
-pid_cache_del(
+/* entries of an earlier epoch have all expired at once */
+static void
+v2p_cache_sync(
     vmi_instance_t vmi,
-    int pid)
+    uint64_t epoch)
 {
-    return VMI_FAILURE;
+    struct v2p_cache *cache = vmi->v2p_cache;
+
+    if (cache->live_epoch != epoch) {
+        vmi->cache_stats[VMI_CACHE_V2P].evictions += cache->live;
+        cache->live = 0;
+        cache->live_epoch = epoch;
+        cache->epoch_stamp = ++cache->stamp;
+        memset(cache->dtb_live, 0, sizeof(cache->dtb_live));
+    }
 }
 
-void
-pid_cache_flush(
-    vmi_instance_t vmi)
+static inline uint32_t
+v2p_dtb_index(
+    addr_t dtb)
 {
-    return;
+    return hash128to64(dtb, 0) & (V2P_DTB_STAMPS - 1);
 }
 
-void
-sym_cache_init(
-    vmi_instance_t vmi)
+/* the stamp that entries for dtb filled in now get, and that live ones
+ * still carry */
+static uint64_t
+v2p_dtb_stamp(
+    vmi_instance_t vmi,
+    addr_t dtb)
 {
-    return;
+    struct v2p_cache *cache = vmi->v2p_cache;
+    uint64_t stamp = cache->dtb_stamp[v2p_dtb_index(dtb)];
+
+    v2p_cache_sync(vmi, cache_epoch(vmi));
+    return stamp > cache->epoch_stamp ? stamp : cache->epoch_stamp;
 }
 
-void
-sym_cache_destroy(
-    vmi_instance_t vmi)
+static inline int
+v2p_tlb_match(
+    struct v2p_tlb_entry *entry,
+    addr_t va,
+    addr_t dtb)
 {
-    return;
+    return entry->page_shift && entry->dtb == dtb &&
+        (va >> entry->page_shift) == entry->page;
 }
 
-status_t
-sym_cache_get(
+static void
+v2p_tlb_fill(
     vmi_instance_t vmi,
-    addr_t base_addr,
-    uint32_t pid,
-    char *sym,
-    addr_t *va)
+    addr_t va,
+    addr_t dtb,
+    addr_t pa,
+    uint32_t page_shift,
+    uint64_t epoch)
 {
-    return VMI_FAILURE;
+    struct v2p_cache *cache = vmi->v2p_cache;
+    struct v2p_tlb_entry *entry =
+        &cache->tlb[cache->tlb_next++ % V2P_TLB_ENTRIES];
+
+    if (entry->page_shift && entry->epoch == epoch) {
+        vmi->cache_stats[VMI_CACHE_TLB].evictions++;
+    }
+    entry->page = va >> page_shift;
+    entry->dtb = dtb;
+    entry->pa = pa;
+    entry->page_shift = page_shift;
+    entry->epoch = epoch;
+    vmi->cache_stats[VMI_CACHE_TLB].inserts++;
 }
 
-void
-sym_cache_set(
+/* drop the entries for va, or for all of dtb if va is ~0 */
+static void
+v2p_tlb_invalidate(
     vmi_instance_t vmi,
-    addr_t base_addr,
-    uint32_t pid,
-    char *sym,
-    addr_t va)
+    addr_t va,
+    addr_t dtb)
 {
-    return;
+    struct v2p_cache *cache = vmi->v2p_cache;
+    uint64_t epoch = cache_epoch(vmi);
+    int i = 0;
+
+    for (i = 0; i < V2P_TLB_ENTRIES; ++i) {
+        struct v2p_tlb_entry *entry = &cache->tlb[i];
+
+        if (entry->page_shift && entry->dtb == dtb &&
+            (va == ~0ULL || (va >> entry->page_shift) == entry->page)) {
+            if (entry->epoch == epoch) {
+                vmi->cache_stats[VMI_CACHE_TLB].evictions++;
+            }
+            entry->page_shift = 0;
+        }
+    }
 }
 
-status_t
-sym_cache_del(
+static status_t
+v2p_cache_alloc(
     vmi_instance_t vmi,
-    addr_t bade_addr,
-    uint32_t pid,
-    char *sym)
+    uint32_t entries)
 {
-    return VMI_FAILURE;
-}
+    struct v2p_cache *cache = vmi->v2p_cache;
+    void *slots = NULL;
+    uint32_t buckets = 1;
 
-void
-sym_cache_flush(
-    vmi_instance_t vmi)
-{
-    return;
+    while (buckets * V2P_CACHE_WAYS < entries && buckets < (1u << 28)) {
+        buckets <<= 1;
+    }
+    if (posix_memalign(&slots, 64,
+                       buckets * V2P_CACHE_WAYS * sizeof(struct v2p_cache_slot))) {
+        errprint("Failed to allocate %u v2p cache entries\n",
+                 buckets * V2P_CACHE_WAYS);
+        return VMI_FAILURE;
+    }
+    memset(slots, 0, buckets * V2P_CACHE_WAYS * sizeof(struct v2p_cache_slot));
+
+    v2p_cache_sync(vmi, cache_epoch(vmi));
+    vmi->cache_stats[VMI_CACHE_V2P].evictions += cache->live;
+    free(cache->slots);
+    memset(cache->tlb, 0, sizeof(cache->tlb));
+    memset(cache->dtb_live, 0, sizeof(cache->dtb_live));
+    cache->slots = slots;
+    cache->buckets = buckets;
+    cache->live = 0;
+    return VMI_SUCCESS;
 }
 
 void
-rva_cache_init(
+v2p_cache_init(
     vmi_instance_t vmi)
 {
-    return;
+    vmi->v2p_cache = (struct v2p_cache *) safe_malloc(sizeof(struct v2p_cache));
+    memset(vmi->v2p_cache, 0, sizeof(struct v2p_cache));
+    v2p_cache_alloc(vmi, V2P_CACHE_ENTRIES);
+    vmi->v2p_table_frames = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                   NULL, g_free);
+    vmi->pt_cache = (struct pt_cache_entry *)
+        safe_malloc(PT_CACHE_ENTRIES * sizeof(struct pt_cache_entry));
+    memset(vmi->pt_cache, 0, PT_CACHE_ENTRIES * sizeof(struct pt_cache_entry));
+    vmi->v2p_misses = g_hash_table_new_full((GHashFunc) key_128_hash, key_128_equals, NULL, g_free);
 }
 
 void
-rva_cache_destroy(
+v2p_cache_destroy(
     vmi_instance_t vmi)
 {
-    return;
+    free(vmi->v2p_cache->slots);
+    free(vmi->v2p_cache);
+    g_hash_table_destroy(vmi->v2p_table_frames);
+    free(vmi->pt_cache);
+    g_hash_table_destroy(vmi->v2p_misses);
+    p2v_index_set(vmi, 0);
 }
 
 status_t
-rva_cache_get(
+v2p_cache_set_capacity(
     vmi_instance_t vmi,
-    char *sym,
-    addr_t *va)
+    uint32_t entries)
 {
-    return VMI_FAILURE;
+    return v2p_cache_alloc(vmi, entries);
 }
 
-void
-rva_cache_set(
+status_t
+v2p_cache_get(
     vmi_instance_t vmi,
-    addr_t base_addr,
-    uint32_t pid,
-    addr_t rva,
-    char *sym)
-{
+    addr_t va,
+    addr_t dtb,
+    addr_t *pa)
+{
+    struct v2p_cache *cache = vmi->v2p_cache;
+    struct v2p_cache_slot *slot = NULL;
+    uint64_t epoch = cache_epoch(vmi);
+    uint64_t stamp = 0;
+    uint64_t key = 0;
+    addr_t mask = 0;
+    int i = 0;
+    int w = 0;
+
+    vmi->cache_stats[VMI_CACHE_TLB].lookups++;
+    for (i = 0; i < V2P_TLB_ENTRIES; ++i) {
+        struct v2p_tlb_entry *entry =
+            &cache->tlb[(cache->tlb_last + i) % V2P_TLB_ENTRIES];
+
+        if (v2p_tlb_match(entry, va, dtb) && entry->epoch == epoch) {
+            vmi->cache_stats[VMI_CACHE_TLB].hits++;
+            cache->tlb_last = entry - cache->tlb;
+            mask = ((addr_t)1 << entry->page_shift) - 1;
+            *pa = entry->pa | (va & mask);
+            return VMI_SUCCESS;
+        }
+    }
+    vmi->cache_stats[VMI_CACHE_TLB].misses++;
+
+    vmi->cache_stats[VMI_CACHE_V2P].lookups++;
+    stamp = v2p_dtb_stamp(vmi, dtb);
+    for (i = 0; cache->buckets && i < sizeof(v2p_page_shifts) / sizeof(uint32_t); ++i) {
+        if (!(vmi->v2p_page_shifts & (1u << v2p_page_shifts[i]))) {
+            continue;
+        }
+
+        key = v2p_cache_key(va, v2p_page_shifts[i]);
+        slot = v2p_cache_bucket(cache, key, dtb);
+        for (w = 0; w < V2P_CACHE_WAYS; ++w, ++slot) {
+            if (slot->key != key || slot->dtb != dtb ||
+                !v2p_slot_live(slot, stamp)) {
+                continue;
+            }
+
+            vmi->cache_stats[VMI_CACHE_V2P].hits++;
+            slot->pa |= V2P_SLOT_REFERENCED;
+            mask = ((addr_t)1 << v2p_page_shifts[i]) - 1;
+            *pa = (slot->pa & ~mask) | (va & mask);
+            v2p_tlb_fill(vmi, va, dtb, slot->pa & ~mask, v2p_page_shifts[i],
+                         epoch);
+            dbprint("--V2P cache hit 0x%.16"PRIx64" -- 0x%.16"PRIx64" (0x%.16"PRIx64"/0x%.16"PRIx64")\n",
+                    va, *pa, dtb, key);
+            return VMI_SUCCESS;
+        }
+    }
+
+    vmi->cache_stats[VMI_CACHE_V2P].misses++;
+    return VMI_FAILURE;
+}
+
+void
+v2p_cache_set(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb,
+    addr_t pa,
+    uint32_t page_shift)
+{
+    struct v2p_cache *cache = vmi->v2p_cache;
+    struct v2p_cache_slot *bucket = NULL;
+    struct v2p_cache_slot *victim = NULL;
+    uint64_t stamp = 0;
+    uint64_t key = 0;
+    int w = 0;
+
+    if (!va || !dtb || !pa || !cache->buckets) {
+        return;
+    }
+    stamp = v2p_dtb_stamp(vmi, dtb);
+    v2p_tlb_invalidate(vmi, va, dtb);
+    v2p_miss_del(vmi, va, dtb);
+    key = v2p_cache_key(va, page_shift);
+    bucket = v2p_cache_bucket(cache, key, dtb);
+
+    /* replace the same page, else take a free slot */
+    for (w = 0; w < V2P_CACHE_WAYS && !victim; ++w) {
+        if (v2p_slot_live(&bucket[w], stamp) &&
+            bucket[w].key == key && bucket[w].dtb == dtb) {
+            victim = &bucket[w];
+        }
+    }
+    for (w = 0; w < V2P_CACHE_WAYS && !victim; ++w) {
+        if (!v2p_slot_live(&bucket[w],
+                           v2p_dtb_stamp(vmi, bucket[w].dtb))) {
+            victim = &bucket[w];
+            cache->live++;
+            cache->dtb_live[v2p_dtb_index(dtb)]++;
+        }
+    }
+
+    /* else give every recently used slot a second chance */
+    while (!victim) {
+        struct v2p_cache_slot *slot =
+            &bucket[cache->hand++ % V2P_CACHE_WAYS];
+
+        if (slot->pa & V2P_SLOT_REFERENCED) {
+            slot->pa &= ~(addr_t)V2P_SLOT_REFERENCED;
+        }
+        else {
+            victim = slot;
+            cache->dtb_live[v2p_dtb_index(slot->dtb)]--;
+            cache->dtb_live[v2p_dtb_index(dtb)]++;
+            vmi->cache_stats[VMI_CACHE_V2P].evictions++;
+        }
+    }
+
+    victim->key = key;
+    victim->dtb = dtb;
+    victim->pa = (pa & ~(((addr_t)1 << page_shift) - 1)) | V2P_SLOT_VALID;
+    victim->stamp = stamp;
+    vmi->v2p_page_shifts |= 1u << page_shift;
+    vmi->cache_stats[VMI_CACHE_V2P].inserts++;
+    dbprint("--V2P cache set 0x%.16"PRIx64" -- 0x%.16"PRIx64" (0x%.16"PRIx64"/0x%.16"PRIx64")\n", va,
+            pa, dtb, key);
+}
+
+status_t
+v2p_cache_del(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb)
+{
+    struct v2p_cache *cache = vmi->v2p_cache;
+    struct v2p_cache_slot *slot = NULL;
+    uint64_t stamp = v2p_dtb_stamp(vmi, dtb);
+    uint64_t key = 0;
+    status_t ret = VMI_FAILURE;
+    int i = 0;
+    int w = 0;
+
+    dbprint("--V2P cache del 0x%.16"PRIx64" (0x%.16"PRIx64")\n", va, dtb);
+    v2p_tlb_invalidate(vmi, va, dtb);
+
+    for (i = 0; cache->buckets && i < sizeof(v2p_page_shifts) / sizeof(uint32_t); ++i) {
+        if (!(vmi->v2p_page_shifts & (1u << v2p_page_shifts[i]))) {
+            continue;
+        }
+
+        key = v2p_cache_key(va, v2p_page_shifts[i]);
+        slot = v2p_cache_bucket(cache, key, dtb);
+        for (w = 0; w < V2P_CACHE_WAYS; ++w, ++slot) {
+            if (slot->key == key && slot->dtb == dtb &&
+                v2p_slot_live(slot, stamp)) {
+                slot->pa &= ~(addr_t)V2P_SLOT_VALID;
+                cache->live--;
+                cache->dtb_live[v2p_dtb_index(dtb)]--;
+                vmi->cache_stats[VMI_CACHE_V2P].evictions++;
+                ret = VMI_SUCCESS;
+            }
+        }
+    }
+    return ret;
+}
+
+void
+v2p_cache_flush(
+    vmi_instance_t vmi)
+{
+    vmi->cache_stats[VMI_CACHE_PAGING].evictions += pt_cache_live(vmi);
+    memset(vmi->pt_cache, 0, PT_CACHE_ENTRIES * sizeof(struct pt_cache_entry));
+    vmi->cache_stats[VMI_CACHE_V2P_MISS].evictions +=
+        g_hash_table_size(vmi->v2p_misses);
+    g_hash_table_remove_all(vmi->v2p_misses);
+    g_hash_table_remove_all(vmi->v2p_table_frames);
+    vmi->v2p_page_shifts = 0;
+    cache_epoch_advance(vmi);
+    v2p_cache_sync(vmi, cache_epoch(vmi));
+    dbprint("--V2P cache flushed\n");
+}
+
+static gboolean
+key_128_high_equals(
+    gpointer key,
+    gpointer value,
+    gpointer dtb)
+{
+    return ((key_128_t) key)->high == *(addr_t *) dtb;
+}
+
+/*
+ * Only the stamp of dtb changes: its translations, paging-structure and
+ * unmapped page entries expire when they are next looked at.
+ */
+void
+v2p_cache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    struct v2p_cache *cache = vmi->v2p_cache;
+    uint32_t i = v2p_dtb_index(dtb);
+
+    v2p_cache_sync(vmi, cache_epoch(vmi));
+    v2p_tlb_invalidate(vmi, ~0ULL, dtb);
+    vmi->cache_stats[VMI_CACHE_V2P].evictions += cache->dtb_live[i];
+    cache->live -= cache->dtb_live[i];
+    cache->dtb_live[i] = 0;
+    cache->dtb_stamp[i] = ++cache->stamp;
+    dbprint("--V2P cache flushed for dtb 0x%.16"PRIx64"\n", dtb);
+}
+
+/*
+ * Every translation expires, as on an epoch change, but the epoch itself and
+ * the other caches keyed by it are left alone.
+ */
+static void
+v2p_cache_expire(
+    vmi_instance_t vmi)
+{
+    struct v2p_cache *cache = vmi->v2p_cache;
+    uint64_t epoch = cache_epoch(vmi);
+    int i = 0;
+
+    v2p_cache_sync(vmi, epoch);
+    for (i = 0; i < V2P_TLB_ENTRIES; ++i) {
+        if (cache->tlb[i].page_shift && cache->tlb[i].epoch == epoch) {
+            vmi->cache_stats[VMI_CACHE_TLB].evictions++;
+        }
+        cache->tlb[i].page_shift = 0;
+    }
+    vmi->cache_stats[VMI_CACHE_V2P].evictions += cache->live;
+    cache->live = 0;
+    memset(cache->dtb_live, 0, sizeof(cache->dtb_live));
+    cache->epoch_stamp = ++cache->stamp;
+    dbprint("--V2P cache expired\n");
+}
+
+/*
+ * Page-table frames are remembered as the cached walk reads them, along with
+ * the dtbs whose walks went through them, so that a write to one of them can
+ * drop just the translations that may depend on it.  A frame shared by more
+ * than V2P_TABLE_DTBS dtbs, like the kernel half of every process, expires
+ * them all.  The set only holds for the epoch it was made in.
+ */
+#define V2P_TABLE_DTBS      4
+
+struct v2p_table_frame {
+    addr_t dtbs[V2P_TABLE_DTBS];
+    uint32_t count;     /* more than V2P_TABLE_DTBS if shared by many */
+};
+
+static void
+v2p_table_frames_sync(
+    vmi_instance_t vmi,
+    uint64_t epoch)
+{
+    if (vmi->v2p_table_epoch != epoch) {
+        g_hash_table_remove_all(vmi->v2p_table_frames);
+        vmi->v2p_table_epoch = epoch;
+    }
+}
+
+void
+v2p_cache_note_table(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    addr_t dtb)
+{
+    gpointer frame = GSIZE_TO_POINTER(paddr >> vmi->page_shift);
+    struct v2p_table_frame *entry = NULL;
+    uint32_t i = 0;
+
+    v2p_table_frames_sync(vmi, cache_epoch(vmi));
+    entry = g_hash_table_lookup(vmi->v2p_table_frames, frame);
+    if (!entry) {
+        entry = g_malloc0(sizeof(struct v2p_table_frame));
+        g_hash_table_insert(vmi->v2p_table_frames, frame, entry);
+    }
+    if (entry->count > V2P_TABLE_DTBS) {
+        return;
+    }
+    for (i = 0; i < entry->count; ++i) {
+        if (entry->dtbs[i] == dtb) {
+            return;
+        }
+    }
+    if (entry->count < V2P_TABLE_DTBS) {
+        entry->dtbs[entry->count] = dtb;
+    }
+    entry->count++;
+}
+
+void
+v2p_cache_invalidate_tables(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length)
+{
+    addr_t frame = paddr >> vmi->page_shift;
+    addr_t last = (paddr + length - 1) >> vmi->page_shift;
+    struct v2p_table_frame *entry = NULL;
+    uint32_t i = 0;
+
+    if (!length) {
+        return;
+    }
+
+    v2p_table_frames_sync(vmi, cache_epoch(vmi));
+    for (; frame <= last; ++frame) {
+        entry = g_hash_table_lookup(vmi->v2p_table_frames,
+                                    GSIZE_TO_POINTER(frame));
+        if (!entry) {
+            continue;
+        }
+
+        dbprint("--V2P cache page-table write 0x%.16"PRIx64"\n", paddr);
+        if (entry->count > V2P_TABLE_DTBS) {
+            v2p_cache_expire(vmi);
+        }
+        else {
+            for (i = 0; i < entry->count; ++i) {
+                v2p_cache_flush_dtb(vmi, entry->dtbs[i]);
+            }
+        }
+        g_hash_table_remove(vmi->v2p_table_frames, GSIZE_TO_POINTER(frame));
+    }
+}
+
+//
+// Physical address --> Virtual address index implementation
+// An optional index of the translations found by page table walks, by the
+// physical page they map to (see vmi_set_p2v_index).  Each dtb also keeps
+// the set of physical pages it has entries for, so that flushing a dtb only
+// visits its own entries.  Entries whose dtb's v2p stamp has moved on since
+// they were seen are checked against the page tables when they are looked
+// up.
+struct p2v_entry {
+    addr_t dtb;
+    addr_t va;          /* va of the page */
+    uint64_t stamp;     /* v2p stamp of dtb when last seen */
+};
+
+struct p2v_frame {
+    uint64_t key;       /* pa of the page | page shift */
+    struct p2v_entry *entries;
+    uint32_t count;
+    uint32_t size;
+};
+
+static void
+p2v_frame_free(
+    gpointer data)
+{
+    struct p2v_frame *frame = (struct p2v_frame *) data;
+
+    free(frame->entries);
+    free(frame);
+}
+
+void
+p2v_index_set(
+    vmi_instance_t vmi,
+    int enable)
+{
+    if (enable && !vmi->p2v_frames) {
+        vmi->p2v_frames =
+            g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                  p2v_frame_free);
+        vmi->p2v_spaces =
+            g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                  (GDestroyNotify) g_hash_table_destroy);
+    }
+    else if (!enable && vmi->p2v_frames) {
+        vmi->cache_stats[VMI_CACHE_P2V].evictions += vmi->p2v_entries;
+        g_hash_table_destroy(vmi->p2v_frames);
+        g_hash_table_destroy(vmi->p2v_spaces);
+        vmi->p2v_frames = NULL;
+        vmi->p2v_spaces = NULL;
+        vmi->p2v_entries = 0;
+        vmi->p2v_page_shifts = 0;
+    }
+}
+
+void
+p2v_index_add(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    addr_t pa,
+    uint32_t page_shift)
+{
+    struct p2v_frame *frame = NULL;
+    GHashTable *space = NULL;
+    uint64_t key = 0;
+    uint32_t i = 0;
+
+    if (!vmi->p2v_frames || !dtb) {
+        return;
+    }
+    key = v2p_cache_key(pa, page_shift);
+    va = (va >> page_shift) << page_shift;
+
+    frame = g_hash_table_lookup(vmi->p2v_frames, GSIZE_TO_POINTER(key));
+    if (!frame) {
+        frame = (struct p2v_frame *) safe_malloc(sizeof(struct p2v_frame));
+        memset(frame, 0, sizeof(struct p2v_frame));
+        frame->key = key;
+        g_hash_table_insert(vmi->p2v_frames, GSIZE_TO_POINTER(key), frame);
+    }
+
+    for (i = 0; i < frame->count; ++i) {
+        if (frame->entries[i].dtb == dtb && frame->entries[i].va == va) {
+            frame->entries[i].stamp = v2p_dtb_stamp(vmi, dtb);
+            return;
+        }
+    }
+    if (frame->count == frame->size) {
+        frame->size = frame->size ? frame->size * 2 : 2;
+        frame->entries = realloc(frame->entries,
+                                 frame->size * sizeof(struct p2v_entry));
+    }
+    frame->entries[frame->count].dtb = dtb;
+    frame->entries[frame->count].va = va;
+    frame->entries[frame->count].stamp = v2p_dtb_stamp(vmi, dtb);
+    frame->count++;
+
+    space = g_hash_table_lookup(vmi->p2v_spaces, GSIZE_TO_POINTER(dtb));
+    if (!space) {
+        space = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_insert(vmi->p2v_spaces, GSIZE_TO_POINTER(dtb), space);
+    }
+    g_hash_table_insert(space, GSIZE_TO_POINTER(key), GINT_TO_POINTER(1));
+    vmi->p2v_page_shifts |= 1u << page_shift;
+    vmi->p2v_entries++;
+    vmi->cache_stats[VMI_CACHE_P2V].inserts++;
+}
+
+/* drop entry i of frame, and frame itself once it is empty */
+static void
+p2v_frame_drop(
+    vmi_instance_t vmi,
+    struct p2v_frame *frame,
+    uint32_t i)
+{
+    addr_t dtb = frame->entries[i].dtb;
+    GHashTable *space = NULL;
+
+    frame->entries[i] = frame->entries[--frame->count];
+    vmi->p2v_entries--;
+    vmi->cache_stats[VMI_CACHE_P2V].evictions++;
+
+    for (i = 0; i < frame->count; ++i) {
+        if (frame->entries[i].dtb == dtb) {
+            return;
+        }
+    }
+    space = g_hash_table_lookup(vmi->p2v_spaces, GSIZE_TO_POINTER(dtb));
+    if (space) {
+        g_hash_table_remove(space, GSIZE_TO_POINTER(frame->key));
+        if (!g_hash_table_size(space)) {
+            g_hash_table_remove(vmi->p2v_spaces, GSIZE_TO_POINTER(dtb));
+        }
+    }
+    if (!frame->count) {
+        g_hash_table_remove(vmi->p2v_frames, GSIZE_TO_POINTER(frame->key));
+    }
+}
+
+static void
+p2v_index_del(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    uint64_t key)
+{
+    struct p2v_frame *frame = NULL;
+    uint32_t i = 0;
+
+    frame = g_hash_table_lookup(vmi->p2v_frames, GSIZE_TO_POINTER(key));
+    for (i = 0; frame && i < frame->count; ++i) {
+        if (frame->entries[i].dtb == dtb && frame->entries[i].va == va) {
+            p2v_frame_drop(vmi, frame, i);
+            return;
+        }
+    }
+}
+
+void
+p2v_index_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    GHashTable *space = NULL;
+    GHashTableIter iter;
+    gpointer key = NULL;
+    uint32_t i = 0;
+
+    if (!vmi->p2v_frames ||
+        !(space = g_hash_table_lookup(vmi->p2v_spaces, GSIZE_TO_POINTER(dtb)))) {
+        return;
+    }
+
+    g_hash_table_iter_init(&iter, space);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        struct p2v_frame *frame = g_hash_table_lookup(vmi->p2v_frames, key);
+
+        for (i = frame->count; i-- > 0;) {
+            if (frame->entries[i].dtb == dtb) {
+                frame->entries[i] = frame->entries[--frame->count];
+                vmi->p2v_entries--;
+                vmi->cache_stats[VMI_CACHE_P2V].evictions++;
+            }
+        }
+        if (!frame->count) {
+            g_hash_table_remove(vmi->p2v_frames, key);
+        }
+    }
+    g_hash_table_remove(vmi->p2v_spaces, GSIZE_TO_POINTER(dtb));
+}
+
+size_t
+p2v_index_lookup(
+    vmi_instance_t vmi,
+    addr_t pa,
+    vmi_p2v_t **mappings)
+{
+    vmi_p2v_t *out = NULL;
+    size_t count = 0;
+    int i = 0;
+
+    *mappings = NULL;
+    if (!vmi->p2v_frames) {
+        dbprint("--P2V index not enabled\n");
+        return 0;
+    }
+
+    vmi->cache_stats[VMI_CACHE_P2V].lookups++;
+    for (i = 0; i < sizeof(v2p_page_shifts) / sizeof(uint32_t); ++i) {
+        uint32_t page_shift = v2p_page_shifts[i];
+        uint64_t key = v2p_cache_key(pa, page_shift);
+        addr_t offset = pa & (((addr_t)1 << page_shift) - 1);
+        struct p2v_frame *frame = NULL;
+        struct p2v_entry *found = NULL;
+        uint32_t n = 0;
+        uint32_t j = 0;
+
+        if (!(vmi->p2v_page_shifts & (1u << page_shift)) ||
+            !(frame = g_hash_table_lookup(vmi->p2v_frames,
+                                          GSIZE_TO_POINTER(key)))) {
+            continue;
+        }
+
+        /* checking an entry walks the page tables, which may change frame */
+        n = frame->count;
+        found = safe_malloc(n * sizeof(struct p2v_entry));
+        memcpy(found, frame->entries, n * sizeof(struct p2v_entry));
+        out = realloc(out, (count + n) * sizeof(vmi_p2v_t));
+
+        for (j = 0; j < n; ++j) {
+            addr_t va = found[j].va | offset;
+
+            if (found[j].stamp != v2p_dtb_stamp(vmi, found[j].dtb)) {
+                if (vmi_pagetable_lookup(vmi, found[j].dtb, va) != pa) {
+                    p2v_index_del(vmi, found[j].dtb, found[j].va, key);
+                    continue;
+                }
+                p2v_index_add(vmi, found[j].dtb, va, pa, page_shift);
+            }
+            out[count].dtb = found[j].dtb;
+            out[count].vaddr = va;
+            count++;
+        }
+        free(found);
+    }
+
+    if (count) {
+        vmi->cache_stats[VMI_CACHE_P2V].hits++;
+        *mappings = out;
+    }
+    else {
+        vmi->cache_stats[VMI_CACHE_P2V].misses++;
+        free(out);
+    }
+    return count;
+}
+
+//
+// PE export directory cache implementation
+// The export directories parsed by peparse, by module base and dtb.  The
+// parsed form is opaque here; peparse checks entries from an earlier
+// epoch against the guest before trusting them.
+void
+export_cache_init(
+    vmi_instance_t vmi)
+{
+    vmi->export_cache =
+        g_hash_table_new_full((GHashFunc)key_128_hash, key_128_equals, g_free,
+                              (GDestroyNotify)peparse_exports_free);
+}
+
+void
+export_cache_destroy(
+    vmi_instance_t vmi)
+{
+    g_hash_table_destroy(vmi->export_cache);
+}
+
+struct pe_exports *
+export_cache_get(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb)
+{
+    struct pe_exports *exports = NULL;
+    struct key_128 local_key;
+    key_128_t key = &local_key;
+    key_128_init(vmi, key, (uint64_t)base_addr, (uint64_t)dtb);
+
+    vmi->cache_stats[VMI_CACHE_EXPORT].lookups++;
+    if ((exports = g_hash_table_lookup(vmi->export_cache, key)) == NULL) {
+        vmi->cache_stats[VMI_CACHE_EXPORT].misses++;
+        return NULL;
+    }
+
+    vmi->cache_stats[VMI_CACHE_EXPORT].hits++;
+    return exports;
+}
+
+status_t
+export_cache_set(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb,
+    struct pe_exports *exports)
+{
+    key_128_t key = key_128_build(vmi, (uint64_t)base_addr, (uint64_t)dtb);
+
+    g_hash_table_replace(vmi->export_cache, key, exports);
+    vmi->cache_stats[VMI_CACHE_EXPORT].inserts++;
+    dbprint("--EXPORT cache set 0x%.16"PRIx64":0x%.16"PRIx64"\n", dtb, base_addr);
+    return VMI_SUCCESS;
+}
+
+void
+export_cache_del(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb)
+{
+    struct key_128 local_key;
+    key_128_t key = &local_key;
+    key_128_init(vmi, key, (uint64_t)base_addr, (uint64_t)dtb);
+
+    if (g_hash_table_remove(vmi->export_cache, key)) {
+        vmi->cache_stats[VMI_CACHE_EXPORT].evictions++;
+        dbprint("--EXPORT cache del 0x%.16"PRIx64":0x%.16"PRIx64"\n", dtb, base_addr);
+    }
+}
+
+void
+export_cache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    vmi->cache_stats[VMI_CACHE_EXPORT].evictions +=
+        g_hash_table_foreach_remove(vmi->export_cache, key_128_high_equals, &dtb);
+}
+
+/* Sum the sizes of the parsed export directories */
+static void
+export_cache_bytes(
+    gpointer key,
+    gpointer value,
+    gpointer data)
+{
+    *(uint64_t *) data += sizeof(struct key_128) + peparse_exports_size(value);
+}
+
+static void
+address_cache_usage(
+    vmi_instance_t vmi,
+    cache_type_t cache,
+    uint64_t *entries,
+    uint64_t *bytes)
+{
+    int i = 0;
+
+    switch (cache) {
+    case VMI_CACHE_V2P:
+        v2p_cache_sync(vmi, cache_epoch(vmi));
+        *entries = vmi->v2p_cache->live;
+        *bytes = sizeof(struct v2p_cache) + (uint64_t) vmi->v2p_cache->buckets *
+            V2P_CACHE_WAYS * sizeof(struct v2p_cache_slot);
+        break;
+    case VMI_CACHE_TLB:
+        *entries = 0;
+        for (i = 0; i < V2P_TLB_ENTRIES; ++i) {
+            if (vmi->v2p_cache->tlb[i].page_shift &&
+                vmi->v2p_cache->tlb[i].epoch == cache_epoch(vmi)) {
+                ++*entries;
+            }
+        }
+        *bytes = sizeof(vmi->v2p_cache->tlb);
+        break;
+    case VMI_CACHE_PAGING:
+        *entries = pt_cache_live(vmi);
+        *bytes = PT_CACHE_ENTRIES * sizeof(struct pt_cache_entry);
+        break;
+    case VMI_CACHE_P2V:
+        *entries = vmi->p2v_entries;
+        *bytes = *entries * sizeof(struct p2v_entry) + (vmi->p2v_frames ?
+            g_hash_table_size(vmi->p2v_frames) * sizeof(struct p2v_frame) : 0);
+        break;
+    case VMI_CACHE_V2P_MISS:
+        *entries = g_hash_table_size(vmi->v2p_misses);
+        *bytes = *entries * sizeof(struct v2p_miss_entry);
+        break;
+    case VMI_CACHE_PID:
+        *entries = g_hash_table_size(vmi->pid_cache);
+        *bytes = *entries * (sizeof(gint) + sizeof(struct pid_cache_entry));
+        break;
+    case VMI_CACHE_SYM:
+        *entries = nested_cache_size(vmi->sym_cache);
+        *bytes = *entries * sizeof(struct sym_cache_entry);
+        break;
+    case VMI_CACHE_RVA:
+        *entries = nested_cache_size(vmi->rva_cache);
+        *bytes = *entries * sizeof(struct sym_cache_entry);
+        break;
+    case VMI_CACHE_EXPORT:
+        *entries = g_hash_table_size(vmi->export_cache);
+        *bytes = 0;
+        g_hash_table_foreach(vmi->export_cache, export_cache_bytes, bytes);
+        break;
+    default:
+        *entries = 0;
+        *bytes = 0;
+        break;
+    }
+}
+
+#else
+void
+pid_cache_init(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+void
+pid_cache_destroy(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+status_t
+pid_cache_get(
+    vmi_instance_t vmi,
+    int pid,
+    addr_t *dtb)
+{
+    return VMI_FAILURE;
+}
+
+void
+pid_cache_set(
+    vmi_instance_t vmi,
+    int pid,
+    addr_t dtb)
+{
+    return;
+}
+
+status_t
+pid_cache_del(
+    vmi_instance_t vmi,
+    int pid)
+{
+    return VMI_FAILURE;
+}
+
+int
+pid_cache_stale(
+    vmi_instance_t vmi,
+    int pid)
+{
+    return 0;
+}
+
+void
+pid_cache_flush(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+void
+sym_cache_init(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+void
+sym_cache_destroy(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+status_t
+sym_cache_get(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    char *sym,
+    addr_t *va)
+{
+    return VMI_FAILURE;
+}
+
+void
+sym_cache_set(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    char *sym,
+    addr_t va)
+{
+    return;
+}
+
+status_t
+sym_cache_del(
+    vmi_instance_t vmi,
+    addr_t bade_addr,
+    uint32_t pid,
+    char *sym)
+{
+    return VMI_FAILURE;
+}
+
+void
+sym_cache_flush(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+void
+rva_cache_init(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+void
+rva_cache_destroy(
+    vmi_instance_t vmi)
+{
     return;
 }
 
 status_t
-rva_cache_del(
+rva_cache_get(
     vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    addr_t rva,
+    char **sym)
+{
+    return VMI_FAILURE;
+}
+
+char *
+rva_cache_set(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    addr_t rva,
     char *sym)
+{
+    return NULL;
+}
+
+status_t
+rva_cache_del(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    addr_t rva)
 {
     return VMI_FAILURE;
 }
@@ -755,7 +2013,8 @@ v2p_cache_set(
     vmi_instance_t vmi,
     addr_t va,
     addr_t dtb,
-    addr_t pa)
+    addr_t pa,
+    uint32_t page_shift)
 {
     return;
 }
@@ -775,6 +2034,179 @@ v2p_cache_flush(
 {
     return;
 }
+
+void
+v2p_cache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    return;
+}
+
+status_t
+v2p_cache_set_capacity(
+    vmi_instance_t vmi,
+    uint32_t entries)
+{
+    return VMI_FAILURE;
+}
+
+void
+v2p_cache_note_table(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    addr_t dtb)
+{
+    return;
+}
+
+void
+v2p_cache_invalidate_tables(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length)
+{
+    return;
+}
+
+status_t
+pt_cache_get(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    int shift,
+    int levels,
+    uint64_t *value)
+{
+    return VMI_FAILURE;
+}
+
+void
+pt_cache_set(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    int shift,
+    uint64_t value)
+{
+    return;
+}
+
+status_t
+v2p_miss_get(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb)
+{
+    return VMI_FAILURE;
+}
+
+void
+p2v_index_set(
+    vmi_instance_t vmi,
+    int enable)
+{
+    return;
+}
+
+void
+p2v_index_add(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    addr_t pa,
+    uint32_t page_shift)
+{
+    return;
+}
+
+void
+p2v_index_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    return;
+}
+
+size_t
+p2v_index_lookup(
+    vmi_instance_t vmi,
+    addr_t pa,
+    vmi_p2v_t **mappings)
+{
+    *mappings = NULL;
+    return 0;
+}
+
+void
+v2p_miss_set(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb)
+{
+    return;
+}
+
+void
+export_cache_init(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+void
+export_cache_destroy(
+    vmi_instance_t vmi)
+{
+    return;
+}
+
+struct pe_exports *
+export_cache_get(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb)
+{
+    return NULL;
+}
+
+status_t
+export_cache_set(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb,
+    struct pe_exports *exports)
+{
+    return VMI_FAILURE;
+}
+
+void
+export_cache_del(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb)
+{
+    return;
+}
+
+void
+export_cache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    return;
+}
+
+static void
+address_cache_usage(
+    vmi_instance_t vmi,
+    cache_type_t cache,
+    uint64_t *entries,
+    uint64_t *bytes)
+{
+    *entries = 0;
+    *bytes = 0;
+}
 #endif
 
 // Below are wrapper functions for external API access to the cache
@@ -820,7 +2252,7 @@ vmi_rvacache_add(
     addr_t rva,
     char *sym)
 {
-    return rva_cache_set(vmi, base_addr, pid, rva, sym);
+    rva_cache_set(vmi, base_addr, pid, rva, sym);
 }
 
 void
@@ -837,7 +2269,7 @@ vmi_v2pcache_add(
     addr_t dtb,
     addr_t pa)
 {
-    return v2p_cache_set(vmi, va, dtb, pa);
+    return v2p_cache_set(vmi, va, dtb, pa, vmi->page_shift);
 }
 
 void
@@ -846,3 +2278,131 @@ vmi_v2pcache_flush(
 {
     return v2p_cache_flush(vmi);
 }
+
+void
+vmi_v2pcache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb)
+{
+    v2p_cache_flush_dtb(vmi, dtb);
+    p2v_index_flush_dtb(vmi, dtb);
+    export_cache_flush_dtb(vmi, dtb);
+}
+
+status_t
+vmi_set_v2p_cache_capacity(
+    vmi_instance_t vmi,
+    uint32_t entries)
+{
+    return v2p_cache_set_capacity(vmi, entries);
+}
+
+void
+vmi_set_v2p_cache_paranoid(
+    vmi_instance_t vmi,
+    int enable)
+{
+    vmi->v2p_paranoid = enable;
+}
+
+void
+vmi_set_p2v_index(
+    vmi_instance_t vmi,
+    int enable)
+{
+    p2v_index_set(vmi, enable);
+}
+
+status_t
+vmi_set_page_cache_limits(
+    vmi_instance_t vmi,
+    uint64_t max_bytes,
+    uint32_t max_age,
+    page_cache_policy_t policy)
+{
+    if (VMI_PAGE_CACHE_LRU != policy && VMI_PAGE_CACHE_FIFO != policy) {
+        errprint("Unknown page cache policy %d\n", policy);
+        return VMI_FAILURE;
+    }
+
+    memory_cache_set_limits(vmi, max_bytes, max_age, policy);
+    return VMI_SUCCESS;
+}
+
+void
+vmi_set_page_cache_prefetch(
+    vmi_instance_t vmi,
+    uint32_t window)
+{
+    memory_cache_set_prefetch(vmi, window);
+}
+
+void
+vmi_get_page_cache_prefetch_stats(
+    vmi_instance_t vmi,
+    uint64_t *prefetched,
+    uint64_t *used,
+    uint64_t *wasted)
+{
+    if (prefetched) {
+        *prefetched = vmi->memory_cache_prefetched;
+    }
+    if (used) {
+        *used = vmi->memory_cache_prefetch_used;
+    }
+    if (wasted) {
+        *wasted = vmi->memory_cache_prefetch_wasted;
+    }
+}
+
+uint64_t
+vmi_get_cache_epoch(
+    vmi_instance_t vmi)
+{
+    return cache_epoch(vmi);
+}
+
+void
+vmi_set_cache_epoch_clock(
+    vmi_instance_t vmi,
+    int enable)
+{
+    vmi->epoch_clock = enable;
+    vmi->epoch_clock_sec = 0;
+}
+
+void
+vmi_set_cache_recheck_age(
+    vmi_instance_t vmi,
+    uint32_t seconds)
+{
+    vmi->recheck_age = seconds;
+}
+
+status_t
+vmi_get_cache_stats(
+    vmi_instance_t vmi,
+    cache_type_t cache,
+    cache_stats_t *stats)
+{
+    if (!stats || cache < 0 || cache >= VMI_CACHE_COUNT) {
+        return VMI_FAILURE;
+    }
+
+    *stats = vmi->cache_stats[cache];
+    if (VMI_CACHE_PAGE == cache) {
+        stats->entries = vmi->memory_cache_size;
+        stats->bytes = vmi->memory_cache_bytes;
+    }
+    else {
+        address_cache_usage(vmi, cache, &stats->entries, &stats->bytes);
+    }
+    return VMI_SUCCESS;
+}
+
+void
+vmi_reset_cache_stats(
+    vmi_instance_t vmi)
+{
+    memset(vmi->cache_stats, 0, sizeof(vmi->cache_stats));
+}
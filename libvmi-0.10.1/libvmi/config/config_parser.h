@@ -32,6 +32,13 @@ typedef struct vmi_config_entry {
     char domain_name[CONFIG_STR_LENGTH];
     char sysmap[CONFIG_STR_LENGTH];
     char ostype[CONFIG_STR_LENGTH];
+    uint64_t page_cache_bytes;
+    int page_cache_age;
+    int page_cache_age_set;
+    char page_cache_policy[CONFIG_STR_LENGTH];
+    int page_cache_prefetch;
+    int page_cache_prefetch_set;
+    char profile_cache[CONFIG_STR_LENGTH];
     union {
         struct linux_offsets {
             int tasks;
@@ -283,6 +283,11 @@ int vmi_parse_config (char *td)
 %token         WIN_SYSPROC
 %token         SYSMAPTOK
 %token         OSTYPETOK
+%token         PAGE_CACHE_BYTES
+%token         PAGE_CACHE_AGE
+%token         PAGE_CACHE_POLICY
+%token         PAGE_CACHE_PREFETCH
+%token         PROFILE_CACHE
 %token<str>    WORD
 %token<str>    FILENAME
 %token         QUOTE
@@ -349,6 +354,16 @@ assignment:
         win_kdvb_assignment
         |
         win_sysproc_assignment
+        |
+        page_cache_bytes_assignment
+        |
+        page_cache_age_assignment
+        |
+        page_cache_policy_assignment
+        |
+        page_cache_prefetch_assignment
+        |
+        profile_cache_assignment
         ;
 
 linux_tasks_assignment:
@@ -494,6 +509,53 @@ win_sysproc_assignment:
         }
         ;
 
+page_cache_bytes_assignment:
+        PAGE_CACHE_BYTES EQUALS NUM
+        {
+            uint64_t tmp = strtoull($3, NULL, 0);
+            tmp_entry.page_cache_bytes = tmp;
+            free($3);
+        }
+        ;
+
+page_cache_age_assignment:
+        PAGE_CACHE_AGE EQUALS NUM
+        {
+            int tmp = strtol($3, NULL, 0);
+            tmp_entry.page_cache_age = tmp;
+            tmp_entry.page_cache_age_set = 1;
+            free($3);
+        }
+        ;
+
+page_cache_policy_assignment:
+        PAGE_CACHE_POLICY EQUALS QUOTE WORD QUOTE
+        {
+            snprintf(tmp_str, CONFIG_STR_LENGTH,"%s", $4);
+            memcpy(tmp_entry.page_cache_policy, tmp_str, CONFIG_STR_LENGTH);
+            free($4);
+        }
+        ;
+
+page_cache_prefetch_assignment:
+        PAGE_CACHE_PREFETCH EQUALS NUM
+        {
+            int tmp = strtol($3, NULL, 0);
+            tmp_entry.page_cache_prefetch = tmp;
+            tmp_entry.page_cache_prefetch_set = 1;
+            free($3);
+        }
+        ;
+
+profile_cache_assignment:
+        PROFILE_CACHE EQUALS QUOTE FILENAME QUOTE
+        {
+            snprintf(tmp_str, CONFIG_STR_LENGTH,"%s", $4);
+            memcpy(tmp_entry.profile_cache, tmp_str, CONFIG_STR_LENGTH);
+            free($4);
+        }
+        ;
+
 sysmap_assignment:
         SYSMAPTOK EQUALS QUOTE FILENAME QUOTE 
         {
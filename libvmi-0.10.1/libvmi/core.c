@@ -81,6 +81,24 @@ success:
     return f;
 }
 
+static status_t
+page_cache_policy_from_str(
+    const char *str,
+    page_cache_policy_t *policy)
+{
+    if (strncmp(str, "lru", CONFIG_STR_LENGTH) == 0) {
+        *policy = VMI_PAGE_CACHE_LRU;
+    }
+    else if (strncmp(str, "fifo", CONFIG_STR_LENGTH) == 0) {
+        *policy = VMI_PAGE_CACHE_FIFO;
+    }
+    else {
+        errprint("Unknown page cache policy (%s).\n", str);
+        return VMI_FAILURE;
+    }
+    return VMI_SUCCESS;
+}
+
 status_t
 read_config_file(
     vmi_instance_t vmi)
@@ -116,6 +134,40 @@ read_config_file(
     vmi->sysmap = strdup(entry->sysmap);
     dbprint("--got sysmap from config (%s).\n", vmi->sysmap);
 
+    /* page cache limits, anything not in the config keeps the default */
+    if (entry->page_cache_bytes || entry->page_cache_age_set ||
+        entry->page_cache_policy[0]) {
+        uint64_t bytes = vmi->memory_cache_bytes_max;
+        uint32_t age = vmi->memory_cache_age;
+        page_cache_policy_t policy = vmi->memory_cache_policy;
+
+        if (entry->page_cache_bytes) {
+            bytes = entry->page_cache_bytes;
+        }
+        if (entry->page_cache_age_set) {
+            age = entry->page_cache_age;
+        }
+        if (entry->page_cache_policy[0] &&
+            VMI_FAILURE == page_cache_policy_from_str(
+                entry->page_cache_policy, &policy)) {
+            ret = VMI_FAILURE;
+            goto error_exit;
+        }
+        vmi_set_page_cache_limits(vmi, bytes, age, policy);
+        dbprint("--got page cache limits from config (%"PRIu64" bytes).\n",
+                bytes);
+    }
+
+    if (entry->page_cache_prefetch_set) {
+        vmi_set_page_cache_prefetch(vmi, entry->page_cache_prefetch);
+    }
+
+    if (entry->profile_cache[0]) {
+        vmi->profile_cache = strdup(entry->profile_cache);
+        dbprint("--got profile cache from config (%s).\n",
+                vmi->profile_cache);
+    }
+
     if (strncmp(entry->ostype, "Linux", CONFIG_STR_LENGTH) == 0) {
         vmi->os_type = VMI_OS_LINUX;
     }
@@ -235,6 +287,11 @@ read_config_ghashtable_entries(
         goto _done;
     }
 
+    if (strncmp(key, "profile_cache", CONFIG_STR_LENGTH) == 0) {
+        vmi->profile_cache = strdup((char *)value);
+        goto _done;
+    }
+
     if (strncmp(key, "linux_tasks", CONFIG_STR_LENGTH) == 0) {
         vmi->os.linux_instance.tasks_offset =
             *(int *)value;
@@ -307,6 +364,36 @@ read_config_ghashtable_entries(
         goto _done;
     }
 
+    if (strncmp(key, "page_cache_bytes", CONFIG_STR_LENGTH) == 0) {
+        vmi_set_page_cache_limits(vmi, *(uint64_t *)value,
+                                  vmi->memory_cache_age,
+                                  vmi->memory_cache_policy);
+        goto _done;
+    }
+
+    if (strncmp(key, "page_cache_age", CONFIG_STR_LENGTH) == 0) {
+        vmi_set_page_cache_limits(vmi, vmi->memory_cache_bytes_max,
+                                  *(int *)value,
+                                  vmi->memory_cache_policy);
+        goto _done;
+    }
+
+    if (strncmp(key, "page_cache_prefetch", CONFIG_STR_LENGTH) == 0) {
+        vmi_set_page_cache_prefetch(vmi, *(int *)value);
+        goto _done;
+    }
+
+    if (strncmp(key, "page_cache_policy", CONFIG_STR_LENGTH) == 0) {
+        page_cache_policy_t policy = vmi->memory_cache_policy;
+
+        if (VMI_SUCCESS ==
+            page_cache_policy_from_str((char *)value, &policy)) {
+            vmi_set_page_cache_limits(vmi, vmi->memory_cache_bytes_max,
+                                      vmi->memory_cache_age, policy);
+        }
+        goto _done;
+    }
+
 _done:
     return;
 }
@@ -646,7 +733,9 @@ vmi_init_private(
     pid_cache_init(*vmi);
     sym_cache_init(*vmi);
     rva_cache_init(*vmi);
+    export_cache_init(*vmi);
     v2p_cache_init(*vmi);
+    v2p_select(*vmi);
 
     /* connecting to xen, kvm, file, etc */
     if (VMI_FAILURE == set_driver_type(*vmi, access_mode, id, name)) {
@@ -718,6 +807,13 @@ vmi_init_private(
                 ("**Failed to get memory layout for VM. Trying heuristic method.\n");
             // fall-through
         }   // if
+        v2p_select(*vmi);
+
+        /* start from what an earlier init saved for this kernel, which
+           spares the heuristics below their memory scans */
+        if (VMI_OS_WINDOWS == (*vmi)->os_type && (*vmi)->profile_cache) {
+            windows_profile_load(*vmi);
+        }
 
         // Heuristic method
         if (!(*vmi)->cr3) {
@@ -873,6 +969,7 @@ vmi_init_complete(
     if (((*vmi)->flags) & VMI_INIT_EVENTS) {
         flags |= VMI_INIT_EVENTS;
     }
+    flags |= ((*vmi)->flags) & (VMI_INIT_WRITE | VMI_INIT_NOMMAP);
 
     vmi_destroy(*vmi);
     return vmi_init_private(vmi,
@@ -889,6 +986,7 @@ vmi_init_complete_custom(
     vmi_config_t config)
 {
     flags |= VMI_INIT_COMPLETE | (*vmi)->mode;
+    flags |= ((*vmi)->flags) & (VMI_INIT_WRITE | VMI_INIT_NOMMAP);
     vmi_destroy(*vmi);
     return vmi_init_custom(vmi, flags, config);
 }
@@ -901,14 +999,21 @@ vmi_destroy(
     if(vmi->init_mode & VMI_INIT_EVENTS){
         events_destroy(vmi);
     }
+    page_maps_destroy(vmi);
     driver_destroy(vmi);
     pid_cache_destroy(vmi);
     sym_cache_destroy(vmi);
     rva_cache_destroy(vmi);
+    export_cache_destroy(vmi);
     v2p_cache_destroy(vmi);
     memory_cache_destroy(vmi);
+    if (VMI_OS_LINUX == vmi->os_type) {
+        linux_destroy(vmi);
+    }
     if (vmi->sysmap)
         free(vmi->sysmap);
+    if (vmi->profile_cache)
+        free(vmi->profile_cache);
     if (vmi->image_type)
         free(vmi->image_type);
     if (vmi)
@@ -37,12 +37,15 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <limits.h>
 
-// Use mmap() if this evaluates to true; otherwise, use a file pointer with
-// seek/read
+// Use mmap() if this evaluates to true and VMI_INIT_NOMMAP is not given;
+// otherwise, use a file pointer with seek/read through the page cache
+#ifndef USE_MMAP
 #define USE_MMAP 1
+#endif
 
 // Avoid errors on systems that don't have MAP_POPULATE defined
 #ifndef MAP_POPULATE
@@ -66,28 +69,26 @@ file_get_memory(
     uint32_t length)
 {
     void *memory = 0;
+    ssize_t nread = 0;
 
-    if (paddr + length >= vmi->size) {
+    if (paddr + length > vmi->size) {
         dbprint
             ("--%s: request for PA range [0x%.16"PRIx64"-0x%.16"PRIx64"] reads past end of file\n",
              __FUNCTION__, paddr, paddr + length);
         goto error_noprint;
     }   // if
 
+    /* when the whole image is mapped, hand out a pointer into the mapping
+     * instead of copying the page */
+    if (file_get_instance(vmi)->map) {
+        return ((uint8_t *) file_get_instance(vmi)->map) + paddr;
+    }
     memory = safe_malloc(length);
 
-#if USE_MMAP
-    (void) memcpy(memory,
-                  ((uint8_t *) file_get_instance(vmi)->map) + paddr,
-                  length);
-#else
-    if (paddr != lseek(file_get_instance(vmi)->fd, paddr, SEEK_SET)) {
+    nread = pread(file_get_instance(vmi)->fd, memory, length, paddr);
+    if (nread < 0 || (size_t) nread != length) {
         goto error_print;
     }
-    if (length != read(file_get_instance(vmi)->fd, memory, length)) {
-        goto error_print;
-    }
-#endif // USE_MMAP
 
     return memory;
 
@@ -101,6 +102,59 @@ error_noprint:
     return NULL;
 }
 
+/* read a run of pages for the page cache read-ahead straight into their
+ * own buffers, with one preadv() for up to IOV_MAX pages */
+static uint32_t
+file_get_memory_batch(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t count,
+    void **pages)
+{
+    uint32_t length = vmi->page_size;
+    uint32_t done = 0;
+    uint32_t i = 0;
+    uint32_t n = count < IOV_MAX ? count : IOV_MAX;
+    struct iovec *iov = NULL;
+    ssize_t nread = 0;
+
+    if (paddr + (uint64_t) count * length > vmi->size) {
+        return 0;
+    }
+
+    iov = safe_malloc(n * sizeof(struct iovec));
+    for (i = 0; i < count; ++i) {
+        pages[i] = safe_malloc(length);
+    }
+
+    /* a short read keeps the whole pages it got */
+    while (done < count) {
+        n = count - done < IOV_MAX ? count - done : IOV_MAX;
+        for (i = 0; i < n; ++i) {
+            iov[i].iov_base = pages[done + i];
+            iov[i].iov_len = length;
+        }
+        nread = preadv(file_get_instance(vmi)->fd, iov, n,
+                       paddr + (addr_t) done * length);
+        if (nread < 0 || (size_t) nread < length) {
+            dbprint("%s: failed to read %u pages at PA (offset) 0x%.16"PRIx64"\n",
+                    __FUNCTION__, count - done,
+                    paddr + (addr_t) done * length);
+            break;
+        }
+        done += nread / length;
+    }
+
+    for (i = done; i < count; ++i) {
+        free(pages[i]);
+        pages[i] = NULL;
+    }
+    free(iov);
+    return done;
+}
+
+/* only copies made for the page cache are released, pointers into the
+ * mapping never reach it */
 void
 file_release_memory(
     void *memory,
@@ -121,8 +175,15 @@ file_init(
     int fd = -1;
     file_instance_t *fi = file_get_instance(vmi);
 
-    /* open handle to memory file */
-    if ((fhandle = fopen(fi->filename, "rb")) == NULL) {
+    /* open handle to memory file, images are only written when asked to */
+    if (vmi->init_mode & VMI_INIT_WRITE) {
+        if ((fhandle = fopen(fi->filename, "r+b")) == NULL) {
+            errprint("Failed to open file for writing.\n");
+            goto fail;
+        }
+        fi->writable = 1;
+    }
+    else if ((fhandle = fopen(fi->filename, "rb")) == NULL) {
         errprint("Failed to open file for reading.\n");
         goto fail;
     }
@@ -135,6 +196,10 @@ file_init(
     //    memory_cache_init(vmi, file_get_memory, file_release_memory, 0);
 
 #if USE_MMAP
+    if (vmi->init_mode & VMI_INIT_NOMMAP) {
+        goto no_mmap;
+    }
+
     /* try memory mapped file I/O */
     unsigned long size;
 
@@ -142,7 +207,17 @@ file_init(
         goto fail;
     }   // if
 
-    int mmap_flags = (MAP_PRIVATE | MAP_NORESERVE | MAP_POPULATE);
+    /* a shared mapping lets writes reach the file */
+    int mmap_flags = (MAP_NORESERVE | MAP_POPULATE);
+    int mmap_prot = PROT_READ;
+
+    if (fi->writable) {
+        mmap_flags |= MAP_SHARED;
+        mmap_prot |= PROT_WRITE;
+    }
+    else {
+        mmap_flags |= MAP_PRIVATE;
+    }
 
 #ifdef MMAP_HUGETLB // since kernel 2.6.32
     mmap_flags |= MMAP_HUGETLB;
@@ -150,7 +225,7 @@ file_init(
 
     void *map = mmap(NULL,  // addr
                      size,  // len
-                     PROT_READ, // prot
+                     mmap_prot, // prot
                      mmap_flags,    // flags
                      fd,    // file descriptor
                      (off_t) 0);    // offset
@@ -164,8 +239,14 @@ file_init(
     // Note: madvise(.., MADV_SEQUENTIAL | MADV_WILLNEED) does not seem to
     // improve performance
 
+    vmi->hvm = 0;
+    return VMI_SUCCESS;
+
+no_mmap:
 #endif // USE_MMAP
 
+    /* pages are read into the page cache, which can also read ahead */
+    memory_cache_init_prefetch(vmi, file_get_memory_batch);
     vmi->hvm = 0;
     return VMI_SUCCESS;
 
@@ -180,12 +261,10 @@ file_destroy(
 {
     file_instance_t *fi = file_get_instance(vmi);
 
-#if USE_MMAP
     if (fi->map) {
         (void) munmap(fi->map, vmi->size);
         fi->map = 0;
     }
-#endif // USE_MMAP
     // fi->fhandle refers to fi->fd; closing both would be an error
     if (fi->fhandle) {
         fclose(fi->fhandle);
@@ -266,10 +345,46 @@ file_read_page(
 {
     addr_t paddr = page << vmi->page_shift;
 
+    /* pages point straight into the mapping, there is nothing to cache */
+    if (file_get_instance(vmi)->map) {
+        return file_get_memory(vmi, paddr, vmi->page_size);
+    }
     return memory_cache_insert(vmi, paddr);
 }
 
-//TODO decide if this functionality makes sense for files
+uint32_t
+file_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    uint32_t i = 0;
+
+    if (file_get_instance(vmi)->map) {
+        for (i = 0; i < count; ++i) {
+            data[i] = file_get_memory(vmi, paddrs[i], vmi->page_size);
+        }
+        return count;
+    }
+    return memory_cache_insert_batch(vmi, paddrs, count, data);
+}
+
+void *
+file_map_span(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length)
+{
+    /* the mapping covers the whole image for the life of the instance */
+    if (!file_get_instance(vmi)->map || paddr + length > vmi->size) {
+        return NULL;
+    }
+    return ((uint8_t *) file_get_instance(vmi)->map) + paddr;
+}
+
+/* writes go to the image file itself, so they are only possible when it
+ * was opened with VMI_INIT_WRITE */
 status_t
 file_write(
     vmi_instance_t vmi,
@@ -277,7 +392,27 @@ file_write(
     void *buf,
     uint32_t length)
 {
-    return VMI_FAILURE;
+    file_instance_t *fi = file_get_instance(vmi);
+
+    if (!fi->writable) {
+        dbprint("--%s: %s is read-only\n", __FUNCTION__, fi->filename);
+        return VMI_FAILURE;
+    }
+    if (paddr + length > vmi->size) {
+        dbprint("--%s: write to PA 0x%.16"PRIx64" past end of file\n",
+                __FUNCTION__, paddr);
+        return VMI_FAILURE;
+    }
+
+    if (fi->map) {
+        memcpy(((uint8_t *) fi->map) + paddr, buf, length);
+    }
+    else if (length != pwrite(fi->fd, buf, length, paddr)) {
+        dbprint("--%s: failed to write %u bytes at PA 0x%.16"PRIx64"\n",
+                __FUNCTION__, length, paddr);
+        return VMI_FAILURE;
+    }
+    return VMI_SUCCESS;
 }
 
 int
@@ -389,6 +524,25 @@ file_read_page(
     return NULL;
 }
 
+uint32_t
+file_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    return 0;
+}
+
+void *
+file_map_span(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length)
+{
+    return NULL;
+}
+
 status_t
 file_write(
     vmi_instance_t vmi,
@@ -33,6 +33,8 @@ typedef struct file_instance {
     char *filename;      /**< name of the file being accessed */
 
     void *map;           /**< memory mapped file */
+
+    int writable;        /**< nonzero if the file was opened for writing */
 } file_instance_t;
 
 status_t file_init(
@@ -56,6 +58,15 @@ status_t file_get_vcpureg(
 void *file_read_page(
     vmi_instance_t vmi,
     addr_t page);
+uint32_t file_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data);
+void *file_map_span(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length);
 status_t file_write(
     vmi_instance_t vmi,
     addr_t paddr,
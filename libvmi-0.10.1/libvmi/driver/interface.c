@@ -91,6 +91,17 @@ struct driver_instance {
     *read_page_ptr) (
     vmi_instance_t,
     addr_t);
+    uint32_t (
+    *read_pages_ptr) (
+    vmi_instance_t,
+    const addr_t *,
+    uint32_t,
+    void **);
+    void *(
+    *map_span_ptr) (
+    vmi_instance_t,
+    addr_t,
+    size_t);
     status_t (
     *write_ptr) (
     vmi_instance_t,
@@ -133,12 +144,12 @@ struct driver_instance {
 };
 typedef struct driver_instance *driver_instance_t;
 
-static driver_instance_t instance = NULL;
-
 static void
 driver_xen_setup(
     vmi_instance_t vmi)
 {
+    driver_instance_t instance = vmi->driver_table;
+
     vmi->driver = safe_malloc(sizeof(xen_instance_t));
     memset(vmi->driver, 0, sizeof(xen_instance_t));
     instance->init_ptr = &xen_init;
@@ -155,6 +166,8 @@ driver_xen_setup(
     instance->set_vcpureg_ptr = &xen_set_vcpureg;
     instance->get_address_width_ptr = &xen_get_address_width;
     instance->read_page_ptr = &xen_read_page;
+    instance->read_pages_ptr = &xen_read_pages;
+    instance->map_span_ptr = NULL;
     instance->write_ptr = &xen_write;
     instance->is_pv_ptr = &xen_is_pv;
     instance->pause_vm_ptr = &xen_pause_vm;
@@ -173,6 +186,8 @@ static void
 driver_kvm_setup(
     vmi_instance_t vmi)
 {
+    driver_instance_t instance = vmi->driver_table;
+
     vmi->driver = safe_malloc(sizeof(kvm_instance_t));
     memset(vmi->driver, 0, sizeof(kvm_instance_t));
     instance->init_ptr = &kvm_init;
@@ -189,6 +204,8 @@ driver_kvm_setup(
     instance->set_vcpureg_ptr = NULL;
     instance->get_address_width_ptr = NULL;
     instance->read_page_ptr = &kvm_read_page;
+    instance->read_pages_ptr = &kvm_read_pages;
+    instance->map_span_ptr = NULL;
     instance->write_ptr = &kvm_write;
     instance->is_pv_ptr = &kvm_is_pv;
     instance->pause_vm_ptr = &kvm_pause_vm;
@@ -205,6 +222,8 @@ static void
 driver_file_setup(
     vmi_instance_t vmi)
 {
+    driver_instance_t instance = vmi->driver_table;
+
     vmi->driver = safe_malloc(sizeof(file_instance_t));
     memset(vmi->driver, 0, sizeof(file_instance_t));
     instance->init_ptr = &file_init;
@@ -221,6 +240,8 @@ driver_file_setup(
     instance->get_vcpureg_ptr = &file_get_vcpureg;
     instance->set_vcpureg_ptr = NULL;
     instance->read_page_ptr = &file_read_page;
+    instance->read_pages_ptr = &file_read_pages;
+    instance->map_span_ptr = &file_map_span;
     instance->write_ptr = &file_write;
     instance->is_pv_ptr = &file_is_pv;
     instance->pause_vm_ptr = &file_pause_vm;
@@ -237,6 +258,8 @@ static void
 driver_null_setup(
     vmi_instance_t vmi)
 {
+    driver_instance_t instance = vmi->driver_table;
+
     vmi->driver = NULL;
     instance->init_ptr = NULL;
     instance->destroy_ptr = NULL;
@@ -252,6 +275,8 @@ driver_null_setup(
     instance->get_vcpureg_ptr = NULL;
     instance->set_vcpureg_ptr = NULL;
     instance->read_page_ptr = NULL;
+    instance->read_pages_ptr = NULL;
+    instance->map_span_ptr = NULL;
     instance->is_pv_ptr = NULL;
     instance->pause_vm_ptr = NULL;
     instance->resume_vm_ptr = NULL;
@@ -267,13 +292,13 @@ static driver_instance_t
 driver_get_instance(
     vmi_instance_t vmi)
 {
-    if (NULL == vmi->driver || NULL == instance) {
-        /* allocate memory for the function pointers, if needed */
-        if (NULL == instance) {
-            instance =
-                (driver_instance_t)
-                safe_malloc(sizeof(struct driver_instance));
-        }
+    if (NULL == vmi->driver_table) {
+        /* each instance gets its own function pointers, so instances
+         * using different drivers can coexist in one process */
+        vmi->driver_table =
+            (driver_instance_t)
+            safe_malloc(sizeof(struct driver_instance));
+        memset(vmi->driver_table, 0, sizeof(struct driver_instance));
 
         /* assign the function pointers */
         if (VMI_XEN == vmi->mode) {
@@ -288,9 +313,8 @@ driver_get_instance(
         else {
             driver_null_setup(vmi);
         }
-
     }
-    return instance;
+    return vmi->driver_table;
 }
 
 status_t
@@ -358,12 +382,14 @@ driver_destroy(
     if (NULL != ptrs && NULL != ptrs->destroy_ptr) {
         ptrs->destroy_ptr(vmi);
         free(vmi->driver);
-        return;
+        vmi->driver = NULL;
     }
     else {
         dbprint("WARNING: driver_destroy function not implemented.\n");
-        return;
     }
+
+    free(vmi->driver_table);
+    vmi->driver_table = NULL;
 }
 
 unsigned long
@@ -568,6 +594,45 @@ driver_read_page(
     }
 }
 
+/* paddrs are sorted, distinct and page aligned; returns how many of them
+ * were handled, which may be fewer than count */
+uint32_t
+driver_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    driver_instance_t ptrs = driver_get_instance(vmi);
+
+    if (NULL != ptrs && NULL != ptrs->read_pages_ptr) {
+        return ptrs->read_pages_ptr(vmi, paddrs, count, data);
+    }
+    else if (count) {
+        /* the data is only valid until the next read, so hand out one
+         * page at a time */
+        data[0] = driver_read_page(vmi, paddrs[0] >> vmi->page_shift);
+        return 1;
+    }
+    return 0;
+}
+
+/* a pointer to length bytes at paddr that the driver keeps valid without
+ * the page cache, or NULL if the driver cannot provide one */
+void *
+driver_map_span(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length)
+{
+    driver_instance_t ptrs = driver_get_instance(vmi);
+
+    if (NULL != ptrs && NULL != ptrs->map_span_ptr) {
+        return ptrs->map_span_ptr(vmi, paddr, length);
+    }
+    return NULL;
+}
+
 status_t
 driver_write(
     vmi_instance_t vmi,
@@ -75,6 +75,15 @@ status_t xen_get_address_width(
 void *driver_read_page(
     vmi_instance_t vmi,
     addr_t page);
+uint32_t driver_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data);
+void *driver_map_span(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length);
 status_t driver_write(
     vmi_instance_t vmi,
     addr_t paddr,
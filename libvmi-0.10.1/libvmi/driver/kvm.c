@@ -279,6 +279,60 @@ error_exit:
     return NULL;
 }
 
+/*
+ * Pipeline read requests for a run of consecutive pages: all requests
+ * are written to the socket before any reply is read, so the whole run
+ * costs one round trip instead of one per page.
+ */
+uint32_t
+kvm_get_memory_patch_batch(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t count,
+    void **pages)
+{
+    int socket_fd = kvm_get_instance(vmi)->socket_fd;
+    uint32_t length = vmi->page_size;
+    struct request *reqs = safe_malloc(count * sizeof(struct request));
+    uint32_t i = 0;
+
+    for (i = 0; i < count; ++i) {
+        reqs[i].type = 1;   // read request
+        reqs[i].address = (uint64_t) paddr + (uint64_t) i * length;
+        reqs[i].length = (uint64_t) length;
+    }
+
+    int nbytes = write(socket_fd, reqs, count * sizeof(struct request));
+
+    free(reqs);
+    if (nbytes != count * sizeof(struct request)) {
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i) {
+        char *buf = safe_malloc(length + 1);
+
+        // replies arrive in order, each followed by a status byte
+        nbytes = read(socket_fd, buf, length + 1);
+        if (nbytes != (length + 1) || !buf[length]) {
+            free(buf);
+            pages[i] = NULL;
+            continue;
+        }
+        pages[i] = buf;
+    }
+
+    // the requested page itself is required
+    if (NULL == pages[0]) {
+        for (i = 1; i < count; ++i) {
+            if (pages[i])
+                free(pages[i]);
+        }
+        return 0;
+    }
+    return count;
+}
+
 void *
 kvm_get_memory_native(
     vmi_instance_t vmi,
@@ -406,12 +460,16 @@ kvm_init(
     }
     vmi->num_vcpus = info.nrVirtCpu;
 
+    /* guest memory changes underneath us, so let cached pages age */
+    vmi_set_cache_epoch_clock(vmi, 1);
+
     char *status = exec_memory_access(kvm_get_instance(vmi));
 
     if (VMI_SUCCESS == exec_memory_access_success(status)) {
         dbprint("--kvm: using custom patch for fast memory access\n");
         memory_cache_init(vmi, kvm_get_memory_patch, kvm_release_memory,
                           1);
+        memory_cache_init_prefetch(vmi, kvm_get_memory_patch_batch);
         if (status)
             free(status);
         return init_domain_socket(kvm_get_instance(vmi));
@@ -786,6 +844,16 @@ kvm_read_page(
     return memory_cache_insert(vmi, paddr);
 }
 
+uint32_t
+kvm_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    return memory_cache_insert_batch(vmi, paddrs, count, data);
+}
+
 status_t
 kvm_write(
     vmi_instance_t vmi,
@@ -943,6 +1011,16 @@ kvm_read_page(
     return NULL;
 }
 
+uint32_t
+kvm_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    return 0;
+}
+
 status_t
 kvm_write(
     vmi_instance_t vmi,
@@ -83,6 +83,11 @@ addr_t kvm_pfn_to_mfn(
 void *kvm_read_page(
     vmi_instance_t vmi,
     addr_t page);
+uint32_t kvm_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data);
 status_t kvm_write(
     vmi_instance_t vmi,
     addr_t paddr,
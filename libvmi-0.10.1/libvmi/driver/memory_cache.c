@@ -29,39 +29,94 @@
 
 #define _GNU_SOURCE
 #include <glib.h>
-#include <time.h>
 
 #include "glib_compat.h"
 
 struct memory_cache_entry {
     addr_t paddr;
     uint32_t length;
-    time_t last_updated;
-    time_t last_used;
+    uint64_t last_updated;  /* epoch the data was fetched in */
+    uint64_t last_used;     /* epoch of the last hit */
     void *data;
+    int prefetched;         /* read ahead and not yet used */
+    uint32_t pins;          /* mappings handed out by memory_cache_pin */
+    int detached;           /* dropped from the cache while still pinned */
+    struct memory_cache_entry *lru_prev;    /* towards most recently used */
+    struct memory_cache_entry *lru_next;    /* towards least recently used */
 };
 typedef struct memory_cache_entry *memory_cache_entry_t;
-static void *(
-    *get_data_callback) (
-    vmi_instance_t,
-    addr_t,
-    uint32_t) = NULL;
-static void (
-    *release_data_callback) (
-    void *,
-    size_t) = NULL;
+
+/* consecutive pages that must be read before read-ahead starts */
+#define PREFETCH_TRIGGER 4
 
 //---------------------------------------------------------
 // Internal implementation functions
 
+/*
+ * The LRU list is threaded through the cache entries themselves, so
+ * hits, promotions and evictions never have to search for an entry.
+ * The head is the most recently used page and the tail is the next
+ * candidate for eviction.
+ */
 static void
-memory_cache_entry_free(
-    gpointer data)
+lru_unlink(
+    vmi_instance_t vmi,
+    memory_cache_entry_t entry)
+{
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else {
+        vmi->memory_cache_lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else {
+        vmi->memory_cache_lru_tail = entry->lru_prev;
+    }
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void
+lru_push_front(
+    vmi_instance_t vmi,
+    memory_cache_entry_t entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = vmi->memory_cache_lru_head;
+
+    if (vmi->memory_cache_lru_head) {
+        vmi->memory_cache_lru_head->lru_prev = entry;
+    }
+    else {
+        vmi->memory_cache_lru_tail = entry;
+    }
+    vmi->memory_cache_lru_head = entry;
+}
+
+static void
+lru_promote(
+    vmi_instance_t vmi,
+    memory_cache_entry_t entry)
 {
-    memory_cache_entry_t entry = (memory_cache_entry_t) data;
+    if (vmi->memory_cache_lru_head == entry) {
+        return;
+    }
+    lru_unlink(vmi, entry);
+    lru_push_front(vmi, entry);
+}
 
+static void
+memory_cache_entry_free(
+    vmi_instance_t vmi,
+    memory_cache_entry_t entry)
+{
     if (entry) {
-        release_data_callback(entry->data, entry->length);
+        vmi->memory_cache_release_data(entry->data, entry->length);
         free(entry);
     }
 }
@@ -72,38 +127,63 @@ get_memory_data(
     addr_t paddr,
     uint32_t length)
 {
-    return get_data_callback(vmi, paddr, length);
+    return vmi->memory_cache_get_data(vmi, paddr, length);
 }
 
+/* a page dropped because it was written is invalidated rather than
+ * evicted, and does not count as wasted read-ahead */
 static void
 remove_entry(
-    gpointer key,
-    gpointer cache)
+    vmi_instance_t vmi,
+    memory_cache_entry_t entry,
+    int invalidated)
 {
-    GHashTable *memory_cache = cache;
+    lru_unlink(vmi, entry);
+    vmi->memory_cache_size--;
+    vmi->memory_cache_bytes -= entry->length;
+    if (invalidated) {
+        vmi->cache_stats[VMI_CACHE_PAGE].invalidations++;
+    }
+    else {
+        vmi->cache_stats[VMI_CACHE_PAGE].evictions++;
+        if (entry->prefetched) {
+            vmi->memory_cache_prefetch_wasted++;
+        }
+    }
 
-    g_hash_table_remove(memory_cache, key);
-    free(key);
+    /* the key lives inside the entry, so remove it before freeing */
+    g_hash_table_remove(vmi->memory_cache, &entry->paddr);
+
+    /* a pinned page is freed by the last memory_cache_unpin */
+    if (entry->pins) {
+        entry->detached = 1;
+    }
+    else {
+        memory_cache_entry_free(vmi, entry);
+    }
 }
 
+/*
+ * Evict pages from the tail of the list until the cache holds no more
+ * than target bytes.  Only as many pages as needed are dropped, so the
+ * cache stays full instead of being cut in half at a time.
+ */
 static void
 clean_cache(
-    vmi_instance_t vmi)
+    vmi_instance_t vmi,
+    uint64_t target)
 {
-    GList *list = NULL;
+    memory_cache_entry_t entry = vmi->memory_cache_lru_tail;
 
-    while (vmi->memory_cache_size > vmi->memory_cache_size_max / 2) {
-        gpointer key = NULL;
-        GList *last = g_list_last(vmi->memory_cache_lru);
+    /* pinned pages stay, even if that keeps the cache over budget */
+    while (vmi->memory_cache_bytes > target && entry) {
+        memory_cache_entry_t prev = entry->lru_prev;
 
-        key = last->data;
-        list = g_list_prepend(list, key);
-        vmi->memory_cache_lru =
-            g_list_remove_link(vmi->memory_cache_lru, last);
-        vmi->memory_cache_size--;
+        if (!entry->pins) {
+            remove_entry(vmi, entry, 0);
+        }
+        entry = prev;
     }
-    g_list_foreach(list, remove_entry, vmi->memory_cache);
-    g_list_free(list);
     dbprint("--MEMORY cache cleanup round complete (cache size = %u)\n",
             g_hash_table_size(vmi->memory_cache));
 }
@@ -113,39 +193,89 @@ validate_and_return_data(
     vmi_instance_t vmi,
     memory_cache_entry_t entry)
 {
-    time_t now = time(NULL);
+    uint64_t now = cache_epoch(vmi);
 
-    if (vmi->memory_cache_age &&
-        (now - entry->last_updated > vmi->memory_cache_age)) {
+    /* the data of a pinned page must not move under its users */
+    if (vmi->memory_cache_age && !entry->pins &&
+        (now - entry->last_updated >= vmi->memory_cache_age)) {
         dbprint("--MEMORY cache refresh 0x%"PRIx64"\n", entry->paddr);
-        release_data_callback(entry->data, entry->length);
+        vmi->cache_stats[VMI_CACHE_PAGE].refreshes++;
+        vmi->memory_cache_release_data(entry->data, entry->length);
         entry->data = get_memory_data(vmi, entry->paddr, entry->length);
         entry->last_updated = now;
-
-        GList* lru_entry = g_list_find_custom(vmi->memory_cache_lru,
-                &entry->paddr, g_int64_equal);
-        gint64* key = lru_entry->data;
-        vmi->memory_cache_lru = g_list_remove(vmi->memory_cache_lru, key);
-        vmi->memory_cache_lru = g_list_prepend(vmi->memory_cache_lru, key);
     }
     entry->last_used = now;
+    if (entry->prefetched) {
+        entry->prefetched = 0;
+        vmi->memory_cache_prefetch_used++;
+    }
+    if (VMI_PAGE_CACHE_LRU == vmi->memory_cache_policy) {
+        lru_promote(vmi, entry);
+    }
     return entry->data;
 }
 
-static memory_cache_entry_t create_new_entry (vmi_instance_t vmi, addr_t paddr,
-        uint32_t length)
+/*
+ * sanity check - are we getting memory outside of the physical memory range?
+ *
+ * This does not work with a Xen PV VM during page table lookups, because
+ * cr3 > [physical memory size]. It *might* not work when examining a PV
+ * snapshot, since we're not sure where the page tables end up. So, we
+ * just do it for a HVM guest.
+ *
+ * TODO: perform other reasonable checks
+ */
+static int
+beyond_memsize(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t length)
 {
+    return vmi->hvm && (paddr + length - 1 > vmi->size);
+}
 
-    // sanity check - are we getting memory outside of the physical memory range?
-    // 
-    // This does not work with a Xen PV VM during page table lookups, because
-    // cr3 > [physical memory size]. It *might* not work when examining a PV
-    // snapshot, since we're not sure where the page tables end up. So, we
-    // just do it for a HVM guest.
-    //
-    // TODO: perform other reasonable checks
+static memory_cache_entry_t
+new_entry(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t length,
+    void *data)
+{
+    memory_cache_entry_t entry =
+        (memory_cache_entry_t)
+        safe_malloc(sizeof(struct memory_cache_entry));
+
+    entry->paddr = paddr;
+    entry->length = length;
+    entry->last_updated = cache_epoch(vmi);
+    entry->last_used = entry->last_updated;
+    entry->data = data;
+    entry->prefetched = 0;
+    entry->pins = 0;
+    entry->detached = 0;
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+
+    /* make room for the new page within the byte budget */
+    if (vmi->memory_cache_bytes + length > vmi->memory_cache_bytes_max) {
+        clean_cache(vmi,
+                    vmi->memory_cache_bytes_max > length ?
+                    vmi->memory_cache_bytes_max - length : 0);
+    }
 
-    if (vmi->hvm && (paddr + length - 1 > vmi->size)) {
+    g_hash_table_insert(vmi->memory_cache, &entry->paddr, entry);
+    lru_push_front(vmi, entry);
+    vmi->memory_cache_size++;
+    vmi->memory_cache_bytes += entry->length;
+    vmi->cache_stats[VMI_CACHE_PAGE].inserts++;
+
+    return entry;
+}
+
+static memory_cache_entry_t create_new_entry (vmi_instance_t vmi, addr_t paddr,
+        uint32_t length)
+{
+    if (beyond_memsize(vmi, paddr, length)) {
         errprint("--requesting PA [0x%"PRIx64"] beyond memsize [0x%"PRIx64"]\n",
                 paddr + length, vmi->size);
         errprint("\tpaddr: %"PRIx64", length %"PRIx32", vmi->size %"PRIx64"\n", paddr, length,
@@ -153,20 +283,74 @@ static memory_cache_entry_t create_new_entry (vmi_instance_t vmi, addr_t paddr,
         return 0;
     }
 
-    memory_cache_entry_t entry =
-        (memory_cache_entry_t)
-        safe_malloc(sizeof(struct memory_cache_entry));
+    return new_entry(vmi, paddr, length,
+                     get_memory_data(vmi, paddr, length));
+}
 
-    entry->paddr = paddr;
-    entry->length = length;
-    entry->last_updated = time(NULL);
-    entry->last_used = entry->last_updated;
-    entry->data = get_memory_data(vmi, paddr, length);
+/*
+ * Track runs of consecutive page reads.  Once a run is long enough, a
+ * miss fetches the requested page together with the rest of the
+ * read-ahead window in a single driver call.  Returns the entry for
+ * paddr, or NULL if read-ahead does not apply and the caller should
+ * fetch the page on its own.
+ */
+static memory_cache_entry_t
+prefetch_window(
+    vmi_instance_t vmi,
+    addr_t paddr)
+{
+    uint32_t page_size = vmi->page_size;
+    uint32_t count = vmi->memory_cache_prefetch_window;
+    uint32_t fetched = 0;
+    uint32_t i = 0;
+    void **pages = NULL;
+    memory_cache_entry_t entry = NULL;
+
+    if (vmi->memory_cache_run < PREFETCH_TRIGGER ||
+        NULL == vmi->memory_cache_get_data_batch || count < 2) {
+        return NULL;
+    }
+
+    /* never read ahead more than half of the cache */
+    if (count > vmi->memory_cache_bytes_max / page_size / 2) {
+        count = vmi->memory_cache_bytes_max / page_size / 2;
+    }
+    if (vmi->size && paddr + (uint64_t) count * page_size > vmi->size) {
+        count = paddr < vmi->size ? (vmi->size - paddr) / page_size : 0;
+    }
+    if (count < 2 || beyond_memsize(vmi, paddr, count * page_size)) {
+        return NULL;
+    }
 
-    if (vmi->memory_cache_size >= vmi->memory_cache_size_max) {
-        clean_cache(vmi);
+    pages = safe_malloc(count * sizeof(void *));
+    fetched = vmi->memory_cache_get_data_batch(vmi, paddr, count, pages);
+    if (!fetched) {
+        free(pages);
+        return NULL;
     }
+    dbprint("--MEMORY cache read-ahead 0x%"PRIx64" (%u pages)\n", paddr,
+            fetched);
+
+    entry = new_entry(vmi, paddr, page_size, pages[0]);
+    for (i = 1; i < fetched; ++i) {
+        addr_t next = paddr + (addr_t) i * page_size;
+        memory_cache_entry_t ahead = NULL;
 
+        if (NULL == pages[i]) {
+            continue;
+        }
+        if (g_hash_table_lookup(vmi->memory_cache, &next)) {
+            vmi->memory_cache_release_data(pages[i], page_size);
+            continue;
+        }
+        ahead = new_entry(vmi, next, page_size, pages[i]);
+        ahead->prefetched = 1;
+        vmi->memory_cache_prefetched++;
+    }
+
+    /* the requested page must stay the most recently used one */
+    lru_promote(vmi, entry);
+    free(pages);
     return entry;
 }
 
@@ -184,14 +368,59 @@ memory_cache_init(
 {
     vmi->memory_cache =
         g_hash_table_new_full(g_int64_hash, g_int64_equal,
-                              g_free,
-                              memory_cache_entry_free);
-    vmi->memory_cache_lru = NULL;
+                              NULL,
+                              NULL);
+    vmi->memory_cache_lru_head = NULL;
+    vmi->memory_cache_lru_tail = NULL;
     vmi->memory_cache_age = age_limit;
     vmi->memory_cache_size = 0;
-    vmi->memory_cache_size_max = MAX_PAGE_CACHE_SIZE;
-    get_data_callback = get_data;
-    release_data_callback = release_data;
+    vmi->memory_cache_bytes = 0;
+    vmi->memory_cache_bytes_max = MAX_PAGE_CACHE_BYTES;
+    vmi->memory_cache_policy = VMI_PAGE_CACHE_LRU;
+    vmi->memory_cache_get_data = get_data;
+    vmi->memory_cache_release_data = release_data;
+    vmi->memory_cache_get_data_batch = NULL;
+    vmi->memory_cache_prefetch_window = PAGE_CACHE_PREFETCH_WINDOW;
+    vmi->memory_cache_last_paddr = 0;
+    vmi->memory_cache_run = 0;
+    vmi->memory_cache_prefetched = 0;
+    vmi->memory_cache_prefetch_used = 0;
+    vmi->memory_cache_prefetch_wasted = 0;
+}
+
+void
+memory_cache_init_prefetch(
+    vmi_instance_t vmi,
+    uint32_t (*get_data_batch) (vmi_instance_t,
+                                addr_t,
+                                uint32_t,
+                                void **))
+{
+    vmi->memory_cache_get_data_batch = get_data_batch;
+}
+
+void
+memory_cache_set_prefetch(
+    vmi_instance_t vmi,
+    uint32_t window)
+{
+    vmi->memory_cache_prefetch_window = window;
+}
+
+void
+memory_cache_set_limits(
+    vmi_instance_t vmi,
+    uint64_t max_bytes,
+    uint32_t max_age,
+    page_cache_policy_t policy)
+{
+    vmi->memory_cache_bytes_max = max_bytes;
+    vmi->memory_cache_age = max_age;
+    vmi->memory_cache_policy = policy;
+
+    if (vmi->memory_cache) {
+        clean_cache(vmi, max_bytes);
+    }
 }
 
 #if ENABLE_PAGE_CACHE == 1
@@ -208,13 +437,29 @@ memory_cache_insert(
         return NULL;
     }
 
+    /* detect sequential access for read-ahead */
+    if (paddr == vmi->memory_cache_last_paddr + vmi->page_size) {
+        vmi->memory_cache_run++;
+    }
+    else if (paddr != vmi->memory_cache_last_paddr) {
+        vmi->memory_cache_run = 0;
+    }
+    vmi->memory_cache_last_paddr = paddr;
+
     gint64 *key = &paddr;
+    vmi->cache_stats[VMI_CACHE_PAGE].lookups++;
     if ((entry = g_hash_table_lookup(vmi->memory_cache, key)) != NULL) {
         dbprint("--MEMORY cache hit 0x%"PRIx64"\n", paddr);
+        vmi->cache_stats[VMI_CACHE_PAGE].hits++;
         return validate_and_return_data(vmi, entry);
     }
     else {
         dbprint("--MEMORY cache set 0x%"PRIx64"\n", paddr);
+        vmi->cache_stats[VMI_CACHE_PAGE].misses++;
+
+        if ((entry = prefetch_window(vmi, paddr)) != NULL) {
+            return entry->data;
+        }
 
         entry = create_new_entry(vmi, paddr, vmi->page_size);
         if (!entry) {
@@ -222,19 +467,118 @@ memory_cache_insert(
             return 0;
         }
 
-        key = safe_malloc(sizeof(gint64));
-        *key = paddr;
-        g_hash_table_insert(vmi->memory_cache, key, entry);
+        return entry->data;
+    }
+}
 
-        gint64 *key2 = safe_malloc(sizeof(gint64));
+/*
+ * Look up a sorted list of distinct pages at once.  Missing pages that are
+ * adjacent are fetched with one batch driver call where available.  At
+ * most half of the cache is brought in per call and the data pointers are
+ * only collected once nothing more will be inserted, so none of the
+ * returned pages can be evicted before the call returns.  The number of
+ * pages handled is returned and the caller continues with the rest.
+ */
+uint32_t
+memory_cache_insert_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **pages)
+{
+    uint32_t page_size = vmi->page_size;
+    uint32_t limit = vmi->memory_cache_bytes_max / page_size / 2;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t fetched = 0;
+    uint8_t *missing = NULL;
+    memory_cache_entry_t entry = NULL;
 
-        *key2 = paddr;
-        vmi->memory_cache_lru =
-            g_list_prepend(vmi->memory_cache_lru, key2);
-        vmi->memory_cache_size++;
+    if (count > limit) {
+        count = limit ? limit : 1;
+    }
+    missing = safe_malloc(count);
+
+    for (i = 0; i < count; ++i) {
+        pages[i] = NULL;
+        missing[i] = !g_hash_table_lookup(vmi->memory_cache, &paddrs[i]);
+        vmi->cache_stats[VMI_CACHE_PAGE].lookups++;
+        if (missing[i]) {
+            vmi->cache_stats[VMI_CACHE_PAGE].misses++;
+        }
+        else {
+            vmi->cache_stats[VMI_CACHE_PAGE].hits++;
+        }
+    }
 
-        return entry->data;
+    /* fetch runs of adjacent misses */
+    for (i = 0; i < count; i = j) {
+        for (j = i + 1; missing[i] && j < count && missing[j] &&
+             paddrs[j] == paddrs[j - 1] + page_size; ++j);
+        if (!missing[i]) {
+            continue;
+        }
+
+        fetched = 0;
+        if (j - i > 1 && vmi->memory_cache_get_data_batch &&
+            !beyond_memsize(vmi, paddrs[i], (j - i) * page_size)) {
+            fetched = vmi->memory_cache_get_data_batch(vmi, paddrs[i],
+                                                       j - i, &pages[i]);
+        }
+        for (; fetched < j - i; ++fetched) {
+            if (!beyond_memsize(vmi, paddrs[i + fetched], page_size)) {
+                pages[i + fetched] =
+                    get_memory_data(vmi, paddrs[i + fetched], page_size);
+            }
+        }
+        for (fetched = i; fetched < j; ++fetched) {
+            if (pages[fetched]) {
+                new_entry(vmi, paddrs[fetched], page_size, pages[fetched]);
+            }
+        }
+    }
+
+    /* a hit may have been evicted by the inserts above under FIFO */
+    for (i = 0; i < count; ++i) {
+        if (!missing[i] && !g_hash_table_lookup(vmi->memory_cache, &paddrs[i])) {
+            create_new_entry(vmi, paddrs[i], page_size);
+        }
     }
+
+    for (i = 0; i < count; ++i) {
+        if ((entry = g_hash_table_lookup(vmi->memory_cache,
+                                         &paddrs[i])) != NULL) {
+            pages[i] = validate_and_return_data(vmi, entry);
+        }
+        else {
+            pages[i] = NULL;
+        }
+    }
+
+    free(missing);
+    return count;
+}
+
+/*
+ * Return the cached data of a page and keep it from being evicted or
+ * refreshed until the matching memory_cache_unpin.
+ */
+void *
+memory_cache_pin(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    struct memory_cache_entry **pinned)
+{
+    memory_cache_entry_t entry = NULL;
+
+    if (NULL == memory_cache_insert(vmi, paddr) ||
+        (entry = g_hash_table_lookup(vmi->memory_cache, &paddr)) == NULL) {
+        return NULL;
+    }
+
+    entry->pins++;
+    *pinned = entry;
+    return entry->data;
 }
 #else
 void *
@@ -244,15 +588,79 @@ memory_cache_insert(
 {
     return get_memory_data(vmi, paddr, vmi->page_size);
 }
+
+uint32_t
+memory_cache_insert_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **pages)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < count; ++i) {
+        pages[i] = get_memory_data(vmi, paddrs[i], vmi->page_size);
+    }
+    return count;
+}
+
+void *
+memory_cache_pin(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    struct memory_cache_entry **pinned)
+{
+    /* nothing would keep the page alive */
+    return NULL;
+}
 #endif
 
+void
+memory_cache_unpin(
+    vmi_instance_t vmi,
+    struct memory_cache_entry *entry)
+{
+    if (entry->pins && !--entry->pins && entry->detached) {
+        memory_cache_entry_free(vmi, entry);
+    }
+}
+
+/*
+ * Drop the cached copies of all pages overlapping [paddr, paddr + length)
+ * so the next read fetches what was just written.  The data may be a
+ * read-only mapping of guest memory, so it is never patched in place.
+ */
+void
+memory_cache_invalidate(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length)
+{
+    memory_cache_entry_t entry = NULL;
+    addr_t page = paddr & ~(((addr_t) vmi->page_size) - 1);
+
+    if (!vmi->memory_cache || !length) {
+        return;
+    }
+
+    for (; page < paddr + length; page += vmi->page_size) {
+        if ((entry = g_hash_table_lookup(vmi->memory_cache, &page)) != NULL) {
+            dbprint("--MEMORY cache invalidate 0x%"PRIx64"\n", page);
+            remove_entry(vmi, entry, 1);
+        }
+    }
+}
+
 void
 memory_cache_destroy(
     vmi_instance_t vmi)
 {
-    uint32_t tmp = vmi->memory_cache_size_max;
+    if (!vmi->memory_cache) {
+        return;
+    }
+
+    clean_cache(vmi, 0);
 
-    vmi->memory_cache_size_max = 0;
-    clean_cache(vmi);
-    vmi->memory_cache_size_max = tmp;
+    g_hash_table_destroy(vmi->memory_cache);
+    vmi->memory_cache = NULL;
 }
@@ -36,9 +36,46 @@ void memory_cache_init(
                           size_t),
     unsigned long age_limit);
 
+void memory_cache_init_prefetch(
+    vmi_instance_t vmi,
+    uint32_t (*get_data_batch) (vmi_instance_t,
+                                addr_t,
+                                uint32_t,
+                                void **));
+
+void memory_cache_set_prefetch(
+    vmi_instance_t vmi,
+    uint32_t window);
+
+void memory_cache_set_limits(
+    vmi_instance_t vmi,
+    uint64_t max_bytes,
+    uint32_t max_age,
+    page_cache_policy_t policy);
+
 void *memory_cache_insert(
     vmi_instance_t vmi,
     addr_t paddr);
 
+uint32_t memory_cache_insert_batch(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **pages);
+
+void *memory_cache_pin(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    struct memory_cache_entry **pinned);
+
+void memory_cache_unpin(
+    vmi_instance_t vmi,
+    struct memory_cache_entry *entry);
+
+void memory_cache_invalidate(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length);
+
 void memory_cache_destroy(
     vmi_instance_t vmi);
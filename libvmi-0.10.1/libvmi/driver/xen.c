@@ -106,12 +106,106 @@ xen_get_memory(
     return xen_get_memory_pfn(vmi, pfn, PROT_READ);
 }
 
+/*
+ * A run of consecutive pages is mapped with one xc_map_foreign_bulk call.
+ * The pages leave the cache one at a time, but a foreign mapping must be
+ * unmapped whole, so every page handed out is entered in xen_windows and
+ * the last of them to be released unmaps the window.
+ */
+struct xen_window {
+    void *base;
+    size_t length;
+    uint32_t refs;      /* pages of the window not yet released */
+};
+
+G_LOCK_DEFINE_STATIC(xen_windows);
+static GHashTable *xen_windows = NULL;  /* page --> struct xen_window */
+
+uint32_t
+xen_get_memory_batch(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    uint32_t count,
+    void **pages)
+{
+    addr_t pfn = paddr >> vmi->page_shift;
+    xen_pfn_t *pfns = safe_malloc(count * sizeof(xen_pfn_t));
+    int *err = safe_malloc(count * sizeof(int));
+    struct xen_window *window = NULL;
+    uint8_t *memory = NULL;
+    uint32_t i = 0;
+
+    for (i = 0; i < count; ++i) {
+        pfns[i] = pfn + i;
+    }
+
+    memory = xc_map_foreign_bulk(xen_get_xchandle(vmi),
+                                 xen_get_domainid(vmi),
+                                 PROT_READ,
+                                 pfns,
+                                 err,
+                                 count);
+    free(pfns);
+
+    if (MAP_FAILED == memory || NULL == memory) {
+        dbprint("--xen_get_memory_batch failed on pfn=0x%"PRIx64" (%u pages)\n",
+                pfn, count);
+        free(err);
+        return 0;
+    }
+
+    window = safe_malloc(sizeof(struct xen_window));
+    window->base = memory;
+    window->length = (size_t) count * XC_PAGE_SIZE;
+    window->refs = 0;
+
+    G_LOCK(xen_windows);
+    if (!xen_windows) {
+        xen_windows = g_hash_table_new(g_direct_hash, g_direct_equal);
+    }
+    for (i = 0; i < count; ++i) {
+        /* pages that failed are left for the caller to fetch alone */
+        if (err[i]) {
+            pages[i] = NULL;
+            continue;
+        }
+        pages[i] = memory + i * XC_PAGE_SIZE;
+        g_hash_table_insert(xen_windows, pages[i], window);
+        window->refs++;
+    }
+    G_UNLOCK(xen_windows);
+    free(err);
+
+    if (!window->refs) {
+        munmap(window->base, window->length);
+        free(window);
+        return 0;
+    }
+    return count;
+}
+
 void
 xen_release_memory(
     void *memory,
     size_t length)
 {
+    struct xen_window *window = NULL;
+
+    G_LOCK(xen_windows);
+    if (xen_windows &&
+        (window = g_hash_table_lookup(xen_windows, memory)) != NULL) {
+        g_hash_table_remove(xen_windows, memory);
+        if (--window->refs) {
+            G_UNLOCK(xen_windows);
+            return;
+        }
+        memory = window->base;
+        length = window->length;
+    }
+    G_UNLOCK(xen_windows);
+
     munmap(memory, length);
+    free(window);
 }
 
 status_t
@@ -452,6 +546,11 @@ xen_init(
 #endif
 
     memory_cache_init(vmi, xen_get_memory, xen_release_memory, 0);
+    memory_cache_init_prefetch(vmi, xen_get_memory_batch);
+
+    /* the guest runs unless paused, so unmapped pages and pids found
+     * earlier must be checked again as time passes */
+    vmi_set_cache_recheck_age(vmi, 1);
 
     // Determine the guest address width
     ret = xen_discover_guest_addr_width(vmi);
@@ -1659,6 +1758,16 @@ xen_read_page(
     return memory_cache_insert(vmi, paddr);
 }
 
+uint32_t
+xen_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    return memory_cache_insert_batch(vmi, paddrs, count, data);
+}
+
 status_t
 xen_write(
     vmi_instance_t vmi,
@@ -1846,6 +1955,16 @@ xen_read_page(
     return NULL;
 }
 
+uint32_t
+xen_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data)
+{
+    return 0;
+}
+
 status_t
 xen_write(
     vmi_instance_t vmi,
@@ -140,6 +140,11 @@ status_t xen_get_address_width(
 void *xen_read_page(
     vmi_instance_t vmi,
     addr_t page);
+uint32_t xen_read_pages(
+    vmi_instance_t vmi,
+    const addr_t *paddrs,
+    uint32_t count,
+    void **data);
 status_t xen_write(
     vmi_instance_t vmi,
     addr_t paddr,
@@ -197,6 +197,20 @@ static int put_mem_response(xen_mem_event_t *mem_event, mem_event_response_t *rs
     return 0;
 }
 
+/* the page-directory base that translations are cached under, without
+ * the PCID, PWT and PCD bits that a CR3 value may carry */
+static inline addr_t cr3_to_dtb(vmi_instance_t vmi, reg_t cr3)
+{
+    switch (vmi->page_mode) {
+    case VMI_PM_LEGACY:
+        return cr3 & 0xFFFFF000ULL;
+    case VMI_PM_PAE:
+        return cr3 & 0xFFFFFFE0ULL;
+    default:
+        return cr3 & 0x000FFFFFFFFFF000ULL;
+    }
+}
+
 static int resume_domain(vmi_instance_t vmi, mem_event_response_t *rsp)
 {
     xc_interface * xch;
@@ -949,6 +963,12 @@ status_t xen_events_listen(vmi_instance_t vmi, uint32_t timeout)
                     vrc = process_mem(vmi, req);
                 }
 
+                /* the write may change cached translations */
+                if(req.access_w) {
+                    v2p_cache_invalidate_tables(vmi,
+                        (req.gfn << vmi->page_shift) + req.offset, 1);
+                }
+
                 /*MARESCA do we need logic here to reset flags on a page? see xen-access.c
                  *    specifically regarding write/exec/int3 inspection and the code surrounding
                  *    the variables default_access and after_first_access
@@ -963,6 +983,8 @@ status_t xen_events_listen(vmi_instance_t vmi, uint32_t timeout)
                 break;
             case MEM_EVENT_REASON_CR3:
                 dbprint("--Caught CR3 event!\n");
+                /* loading CR3 flushes the TLB of the new address space */
+                v2p_cache_flush_dtb(vmi, cr3_to_dtb(vmi, req.gfn));
                 if(!vmi->shutting_down) {
                     vrc = process_register(vmi, CR3, req);
                 }
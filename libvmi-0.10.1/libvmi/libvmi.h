@@ -61,8 +61,19 @@ extern "C" {
 /* enable or disable the page cache */
 #define ENABLE_PAGE_CACHE 1
 
-/* max number of pages held in page cache */
+/* default number of pages held in page cache, the limit can be changed
+   at runtime using vmi_set_page_cache_limits */
+#ifndef MAX_PAGE_CACHE_SIZE
 #define MAX_PAGE_CACHE_SIZE 512
+#endif
+
+/* default page cache budget in bytes */
+#define MAX_PAGE_CACHE_BYTES ((uint64_t) MAX_PAGE_CACHE_SIZE << 12)
+
+/* default number of pages read ahead on sequential access, 0 disables */
+#ifndef PAGE_CACHE_PREFETCH_WINDOW
+#define PAGE_CACHE_PREFETCH_WINDOW 16
+#endif
 
 typedef uint32_t vmi_mode_t;
 
@@ -82,6 +93,10 @@ typedef uint32_t vmi_mode_t;
 
 #define VMI_INIT_EVENTS (1 << 18) /**< init support for memory events */
 
+#define VMI_INIT_WRITE (1 << 19) /**< open file images for writing */
+
+#define VMI_INIT_NOMMAP (1 << 20) /**< read file images through the page cache instead of mapping them */
+
 #define VMI_CONFIG_NONE (1 << 24) /**< no config provided */
 
 #define VMI_CONFIG_GLOBAL_FILE_ENTRY (1 << 25) /**< config in file provided */
@@ -133,6 +148,61 @@ typedef enum page_mode {
     VMI_PM_IA32E    /**< IA-32e paging */
 } page_mode_t;
 
+/* Eviction policies for the page cache */
+typedef enum page_cache_policy {
+
+    VMI_PAGE_CACHE_LRU,  /**< evict the least recently used page */
+
+    VMI_PAGE_CACHE_FIFO  /**< evict the oldest page, hits do not reorder */
+} page_cache_policy_t;
+
+/* Internal caches that keep statistics */
+typedef enum cache_type {
+
+    VMI_CACHE_PAGE,  /**< physical page cache */
+
+    VMI_CACHE_V2P,   /**< virtual to physical address cache */
+
+    VMI_CACHE_PID,   /**< pid to directory table base cache */
+
+    VMI_CACHE_SYM,   /**< symbol to virtual address cache */
+
+    VMI_CACHE_RVA,   /**< RVA to symbol cache */
+
+    VMI_CACHE_PAGING, /**< upper-level paging entries, counted in guest reads */
+
+    VMI_CACHE_TLB,   /**< last translations, checked before the v2p cache */
+
+    VMI_CACHE_V2P_MISS, /**< pages found unmapped by a page table walk */
+
+    VMI_CACHE_P2V,   /**< physical to virtual index, see vmi_set_p2v_index */
+
+    VMI_CACHE_EXPORT, /**< parsed PE export directories, one per module */
+
+    VMI_CACHE_COUNT  /**< number of cache types, not a cache */
+} cache_type_t;
+
+typedef struct cache_stats {
+
+    uint64_t lookups;   /**< number of lookups */
+
+    uint64_t hits;      /**< lookups answered from the cache */
+
+    uint64_t misses;    /**< lookups not found in the cache */
+
+    uint64_t inserts;   /**< entries added */
+
+    uint64_t evictions; /**< entries evicted, deleted or flushed */
+
+    uint64_t invalidations; /**< entries dropped by writes through LibVMI (page cache) */
+
+    uint64_t refreshes; /**< hits that had to refetch stale data */
+
+    uint64_t entries;   /**< entries currently held */
+
+    uint64_t bytes;     /**< approximate memory currently held */
+} cache_stats_t;
+
 typedef uint64_t reg_t;
 typedef enum registers {
     RAX,
@@ -244,6 +314,63 @@ typedef struct _ustring {
     const char *encoding;  /**< holds iconv-compatible encoding of contents; do not free */
 } unicode_string_t;
 
+/**
+ * One request of a batched physical memory read
+ */
+typedef struct vmi_iov {
+
+    addr_t paddr;          /**< physical address to read from */
+
+    void *buf;             /**< buffer receiving the data */
+
+    size_t count;          /**< number of bytes to read */
+} vmi_iov_t;
+
+/**
+ * A virtually and physically contiguous run of memory
+ */
+typedef struct vmi_extent {
+
+    addr_t vaddr;          /**< virtual address the run starts at */
+
+    addr_t paddr;          /**< physical address the run starts at */
+
+    size_t length;         /**< length of the run in bytes */
+} vmi_extent_t;
+
+/**
+ * A virtual address that maps a physical address, and its address space
+ */
+typedef struct vmi_p2v {
+
+    addr_t dtb;            /**< page directory base of the address space */
+
+    addr_t vaddr;          /**< virtual address */
+} vmi_p2v_t;
+
+#define VMI_PAGE_WRITE (1 << 0) /**< writable through every level */
+
+#define VMI_PAGE_USER  (1 << 1) /**< user accessible through every level */
+
+#define VMI_PAGE_EXEC  (1 << 2) /**< not execute-disabled at any level */
+
+/**
+ * A run of pages of one size and with the same permissions, mapped
+ * virtually and physically contiguous
+ */
+typedef struct vmi_page_extent {
+
+    addr_t vaddr;          /**< virtual address the run starts at */
+
+    addr_t paddr;          /**< physical address the run starts at */
+
+    uint64_t length;       /**< length of the run in bytes */
+
+    uint64_t page_size;    /**< size of each page of the run in bytes */
+
+    uint32_t permissions;  /**< VMI_PAGE_* flags of the pages */
+} vmi_page_extent_t;
+
 /* custom config input source */
 typedef void* vmi_config_t;
 
@@ -257,6 +384,11 @@ typedef void* vmi_config_t;
  */
 typedef struct vmi_instance *vmi_instance_t;
 
+/* Address space walk callback, taking the extent found and the data given
+ * to vmi_walk_address_space.  Returning VMI_FAILURE stops the walk. */
+typedef status_t (*vmi_walk_callback_t)(vmi_instance_t vmi,
+    vmi_page_extent_t *extent, void *data);
+
 /*---------------------------------------------------------
  * Initialization and Destruction functions from core.c
  */
@@ -269,9 +401,15 @@ typedef struct vmi_instance *vmi_instance_t;
  * You should call this function only once per VM or file, and then use the
  * resulting instance when calling any of the other library functions.
  *
+ * File images are opened read-only and writes to them fail, unless
+ * VMI_INIT_WRITE is given, in which case writes change the file itself.
+ * They are mapped into memory whole, so the page cache and its limits do
+ * not apply to them, unless VMI_INIT_NOMMAP is given.
+ *
  * @param[out] vmi Struct that holds instance information
  * @param[in] flags VMI_AUTO, VMI_XEN, VMI_KVM, or VMI_FILE plus
- *  VMI_INIT_PARTIAL or VMI_INIT_COMPLETE
+ *  VMI_INIT_PARTIAL or VMI_INIT_COMPLETE, optionally VMI_INIT_WRITE
+ *  and VMI_INIT_NOMMAP
  * @param[in] name Unique name specifying the VM or file to view
  * @return VMI_SUCCESS or VMI_FAILURE
  */
@@ -409,8 +547,10 @@ addr_t vmi_translate_sym2v(
 
 /**
  * Performs the translation from an RVA to a symbol
- * On Windows this function walks the PE export table.
- * Linux is unimplemented at this time.
+ * On Windows this finds the closest named PE export at or below rva.
+ * On Linux it finds the closest System.map symbol at or below
+ * base_vaddr + rva.  Either returns "symbol" or "symbol+0xoffset".
+ * The returned string is owned by LibVMI's RVA cache.
  *
  * @param[in] vmi LibVMI instance
  * @param[in] base_vaddr Base virtual address (beginning of PE header in Windows)
@@ -465,6 +605,64 @@ addr_t vmi_pagetable_lookup (
     addr_t dtb,
     addr_t vaddr);
 
+/**
+ * Translates a virtual address range to the physically contiguous runs
+ * backing it.  Pages found in the v2p cache are taken from it; the rest
+ * are translated walking the page tables once per page table (or once per
+ * large page) rather than once per page, and added to the cache.
+ * Translation stops at the first page that is not mapped, so the runs may
+ * cover less than \a length.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] dtb address of the relevant page directory base
+ * @param[in] vaddr virtual address the range starts at
+ * @param[in] length length of the range in bytes
+ * @param[out] extents The runs, in virtual address order; free with free()
+ * @return The number of runs in \a extents
+ */
+size_t vmi_translate_range(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t vaddr,
+    size_t length,
+    vmi_extent_t **extents);
+
+/**
+ * Reports every mapped page of an address space, walking the page tables
+ * of \a dtb depth first and reading each table once.  Pages are reported
+ * in virtual address order, merged into runs of one page size and one set
+ * of permissions that are virtually and physically contiguous.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] dtb address of the relevant page directory base
+ * @param[in] callback Function called for each run
+ * @param[in] data Passed to \a callback
+ * @return VMI_SUCCESS if the whole address space was walked, or
+ *   VMI_FAILURE if \a callback stopped the walk or the paging mode is unknown
+ */
+status_t vmi_walk_address_space(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    vmi_walk_callback_t callback,
+    void *data);
+
+/**
+ * Finds the virtual addresses that map a physical address, from the
+ * translations that page table walks have found since the physical to
+ * virtual index was enabled (see vmi_set_p2v_index).  Translations found
+ * before the guest last ran are checked against the page tables first.
+ * Use vmi_dtb_to_pid to find the process owning each address space.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] paddr physical address to translate
+ * @param[out] mappings The virtual addresses; free with free()
+ * @return The number of entries in \a mappings
+ */
+size_t vmi_translate_p2v(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    vmi_p2v_t **mappings);
+
 /*---------------------------------------------------------
  * Memory access functions from util.c
  */
@@ -505,7 +703,8 @@ size_t vmi_read_va(
 
 /**
  * Reads \a count bytes from memory located at the physical address \a paddr
- * and stores the output in \a buf.
+ * and stores the output in \a buf.  Physical frame 0 is never read, so a
+ * read that starts in the first page of memory returns nothing.
  *
  * @param[in] vmi LibVMI instance
  * @param[in] paddr Physical address to read from
@@ -519,6 +718,74 @@ size_t vmi_read_pa(
     void *buf,
     size_t count);
 
+/**
+ * Reads a batch of physical memory ranges.  The requests are sorted by
+ * page and every page is fetched only once, however many requests touch
+ * it, so this is much cheaper than many small calls to vmi_read_pa.
+ * As with vmi_read_pa, requests that start in frame 0 fail.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] iov The ranges to read and where to store them
+ * @param[in] n The number of entries in \a iov
+ * @param[out] status Optional array of \a n entries, set to VMI_SUCCESS
+ *  for each request that was read in full and VMI_FAILURE otherwise
+ * @return The number of requests read in full
+ */
+size_t vmi_read_pa_batch(
+    vmi_instance_t vmi,
+    const vmi_iov_t *iov,
+    size_t n,
+    status_t *status);
+
+/**
+ * Maps \a length bytes at the physical address \a paddr for reading in
+ * place, without copying them out.  The data stays valid, and its page is
+ * kept in the page cache, until the pointer is passed to vmi_unmap.
+ * Mapping the same address again returns the same pointer and needs one
+ * more vmi_unmap.  A write through LibVMI to a mapped page drops the page
+ * from the cache but not from under the mapping: depending on the driver
+ * the mapping may keep showing the bytes from before the write, and
+ * mapping the address again returns a new pointer to the new bytes, which
+ * needs its own vmi_unmap.  Only the file driver can map ranges that cross a page
+ * boundary; with other drivers such requests fail.  As with vmi_read_pa,
+ * frame 0 cannot be mapped.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] paddr Physical address to map
+ * @param[in] length The number of bytes to map
+ * @return Read-only pointer to the data, or NULL on failure
+ */
+const void *vmi_map_pa(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length);
+
+/**
+ * Maps \a length bytes at the virtual address \a vaddr for reading in
+ * place.  The range must be physically contiguous.  See vmi_map_pa.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] vaddr Virtual address to map
+ * @param[in] pid Pid of the virtual address space (0 for kernel)
+ * @param[in] length The number of bytes to map
+ * @return Read-only pointer to the data, or NULL on failure
+ */
+const void *vmi_map_va(
+    vmi_instance_t vmi,
+    addr_t vaddr,
+    int pid,
+    size_t length);
+
+/**
+ * Releases a pointer returned by vmi_map_pa or vmi_map_va.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] data Pointer returned by vmi_map_pa or vmi_map_va
+ */
+void vmi_unmap(
+    vmi_instance_t vmi,
+    const void *data);
+
 /**
  * Reads 8 bits from memory, given a kernel symbol.
  *
@@ -844,7 +1111,8 @@ size_t vmi_write_va(
 
 /**
  * Writes \a count bytes to memory located at the physical address \a paddr
- * from \a buf.
+ * from \a buf.  Pages mapped with vmi_map_pa are not updated in place;
+ * see vmi_map_pa.
  *
  * @param[in] vmi LibVMI instance
  * @param[in] paddr Physical address to write to
@@ -1130,6 +1398,19 @@ uint32_t vmi_get_access_mode(
 page_mode_t vmi_get_page_mode(
     vmi_instance_t vmi);
 
+/**
+ * Sets the page mode used for address translation.  This is meant for
+ * instances whose layout could not be detected, such as memory images
+ * opened with VMI_INIT_PARTIAL.  Cached translations are flushed.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] page_mode VMI_PM_LEGACY, VMI_PM_PAE or VMI_PM_IA32E
+ * @return VMI_SUCCESS or VMI_FAILURE for an unknown page mode
+ */
+status_t vmi_set_page_mode(
+    vmi_instance_t vmi,
+    page_mode_t page_mode);
+
 /**
  * Gets the current address width for the given vmi_instance_t
  *
@@ -1297,6 +1578,61 @@ status_t vmi_resume_vm(
 void vmi_v2pcache_flush(
     vmi_instance_t vmi);
 
+/**
+ * Removes the entries for one address space from LibVMI's internal
+ * virtual to physical address cache, e.g. after the page tables of a
+ * process were changed behind LibVMI's back.  Its entries in the physical
+ * to virtual index and its cached PE export directories are dropped too.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] dtb Directory table base of the address space
+ */
+void vmi_v2pcache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb);
+
+/**
+ * Sets the number of entries that LibVMI's internal virtual to physical
+ * address cache can hold.  The number is rounded up to a power of two and
+ * the cache evicts old translations instead of growing beyond it.  The
+ * default is 65536 entries, or 2MB.  All cached translations are dropped.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] entries Number of translations to hold
+ * @return VMI_SUCCESS or VMI_FAILURE if the memory could not be allocated
+ */
+status_t vmi_set_v2p_cache_capacity(
+    vmi_instance_t vmi,
+    uint32_t entries);
+
+/**
+ * Enables or disables paranoid mode for the virtual to physical address
+ * cache.  Cache hits are normally trusted until the cache epoch advances
+ * or a page-table write or CR3 event drops them.  In paranoid mode each
+ * hit is also checked by reading the translated physical address, and
+ * dropped if that read fails.  This costs a memory read per translation.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] enable Nonzero to enable paranoid mode, zero to disable it
+ */
+void vmi_set_v2p_cache_paranoid(
+    vmi_instance_t vmi,
+    int enable);
+
+/**
+ * Enables or disables the physical to virtual index used by
+ * vmi_translate_p2v.  While enabled, every translation found by a page
+ * table walk, including vmi_walk_address_space, is added to the index,
+ * which takes memory in proportion to the pages translated.  Flushing the
+ * v2p cache of a dtb drops its entries.  Disabling the index frees it.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] enable Nonzero to enable the index, zero to disable it
+ */
+void vmi_set_p2v_index(
+    vmi_instance_t vmi,
+    int enable);
+
 /**
  * Adds one entry to LibVMI's internal virtual to physical address
  * cache.
@@ -1389,6 +1725,118 @@ void vmi_pidcache_add(
     int pid,
     addr_t dtb);
 
+/**
+ * Sets the limits for LibVMI's internal page cache.  The cache holds
+ * pages until their total size reaches \a max_bytes, at which point
+ * pages are evicted one at a time according to \a policy.  Shrinking
+ * the budget evicts pages immediately.  A budget smaller than one page
+ * still keeps the most recently read page.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] max_bytes Maximum number of bytes held in the cache
+ * @param[in] max_age Cache epochs before a cached page is fetched again,
+ *  or 0 to keep pages until they are evicted (see vmi_get_cache_epoch)
+ * @param[in] policy Eviction policy
+ * @return VMI_SUCCESS or VMI_FAILURE
+ */
+status_t vmi_set_page_cache_limits(
+    vmi_instance_t vmi,
+    uint64_t max_bytes,
+    uint32_t max_age,
+    page_cache_policy_t policy);
+
+/**
+ * Gets the statistics for one of LibVMI's internal caches.  The counters
+ * accumulate from vmi_init or the last call to vmi_reset_cache_stats.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] cache Cache to report on
+ * @param[out] stats Statistics for \a cache
+ * @return VMI_SUCCESS or VMI_FAILURE for an unknown cache
+ */
+status_t vmi_get_cache_stats(
+    vmi_instance_t vmi,
+    cache_type_t cache,
+    cache_stats_t *stats);
+
+/**
+ * Resets the counters of all of LibVMI's internal caches.  The current
+ * number of entries and bytes are not affected.
+ *
+ * @param[in] vmi LibVMI instance
+ */
+void vmi_reset_cache_stats(
+    vmi_instance_t vmi);
+
+/**
+ * Gets the current cache epoch.  LibVMI's caches judge the age of their
+ * entries in epochs instead of wall clock time.  The epoch advances when
+ * the VM is paused or resumed through LibVMI, when the v2p cache is
+ * flushed and, if the epoch clock is enabled, once per second.
+ *
+ * @param[in] vmi LibVMI instance
+ * @return Current epoch
+ */
+uint64_t vmi_get_cache_epoch(
+    vmi_instance_t vmi);
+
+/**
+ * Enables or disables the epoch clock, which advances the cache epoch
+ * once per second using a coarse monotonic clock.  This is useful for
+ * live targets whose memory changes without LibVMI pausing them, and is
+ * enabled by default for KVM guests.  Every v2p translation expires along
+ * with the epoch, so on a busy guest the clock costs a page table walk
+ * per page each second; see vmi_set_cache_recheck_age for a bound that
+ * applies to unmapped pages and pids only.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] enable Nonzero to enable the clock, zero to disable it
+ */
+void vmi_set_cache_epoch_clock(
+    vmi_instance_t vmi,
+    int enable);
+
+/**
+ * Sets how long a page found unmapped, and the dtb found for a pid, are
+ * trusted before they are looked up again.  Unlike the epoch clock this
+ * leaves cached translations alone, so that a live guest can fault pages
+ * in and start processes without every translation expiring.  It is set
+ * to one second by default for Xen guests.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] seconds Age in seconds, or 0 to only expire them with the epoch
+ */
+void vmi_set_cache_recheck_age(
+    vmi_instance_t vmi,
+    uint32_t seconds);
+
+/**
+ * Sets the read-ahead window for LibVMI's internal page cache.  After
+ * several consecutive pages have been read, a miss fetches the next
+ * \a window pages with a single driver request.  Read-ahead is only
+ * used by drivers that support batched page access.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[in] window Number of pages to fetch at once, or 0 to disable
+ */
+void vmi_set_page_cache_prefetch(
+    vmi_instance_t vmi,
+    uint32_t window);
+
+/**
+ * Gets read-ahead counters for LibVMI's internal page cache.
+ *
+ * @param[in] vmi LibVMI instance
+ * @param[out] prefetched Pages brought into the cache by read-ahead
+ * @param[out] used Read-ahead pages that were requested later
+ * @param[out] wasted Read-ahead pages evicted without being requested
+ */
+void vmi_get_page_cache_prefetch_stats(
+    vmi_instance_t vmi,
+    uint64_t *prefetched,
+    uint64_t *used,
+    uint64_t *wasted);
+
 /*---------------------------------------------------------
  * Event management
  */
@@ -27,6 +27,7 @@
 #include "libvmi.h"
 #include "private.h"
 #include "driver/interface.h"
+#include "driver/memory_cache.h"
 #include <stdlib.h>
 #include <sys/mman.h>
 
@@ -56,6 +57,32 @@ uint64_t get_bits_51to12 (uint64_t value)
     return value & 0x000FFFFFFFFFF000ULL;
 }
 
+/*
+ * Page-table entries are read in place from the page that holds them, as
+ * the page cache or the driver has it, instead of being copied out through
+ * vmi_read_pa.  Entries never cross a page and are used before the next
+ * page is read, so the page does not need to stay pinned.
+ */
+static inline uint64_t read_pt_64 (vmi_instance_t vmi, addr_t paddr)
+{
+    const uint8_t *page = NULL;
+
+    if ((page = vmi_read_page(vmi, paddr >> 12)) == NULL) {
+        return 0;
+    }
+    return *(const uint64_t *) (page + (paddr & 0xFFF));
+}
+
+static inline uint32_t read_pt_32 (vmi_instance_t vmi, addr_t paddr)
+{
+    const uint8_t *page = NULL;
+
+    if ((page = vmi_read_page(vmi, paddr >> 12)) == NULL) {
+        return 0;
+    }
+    return *(const uint32_t *) (page + (paddr & 0xFFF));
+}
+
 /* PML4 Table  */
 addr_t get_pml4_index (addr_t vaddr)
 {
@@ -64,12 +91,10 @@ addr_t get_pml4_index (addr_t vaddr)
 
 uint64_t get_pml4e (vmi_instance_t vmi, addr_t vaddr, reg_t cr3)
 {
-    uint64_t value = 0;
     addr_t pml4e_address = get_bits_51to12(cr3) | get_pml4_index(vaddr);
 
     dbprint("--PTLookup pml4e_address = 0x%.16"PRIx64"\n", pml4e_address);
-    vmi_read_64_pa(vmi, pml4e_address, &value);
-    return value;
+    return read_pt_64(vmi, pml4e_address);
 }
 
 /* page directory pointer table */
@@ -85,12 +110,10 @@ uint32_t pdpi_index (uint32_t pdpi)
 
 uint64_t get_pdpi (vmi_instance_t instance, uint32_t vaddr, uint32_t cr3)
 {
-    uint64_t value;
     uint32_t pdpi_entry = get_pdptb(cr3) + pdpi_index(vaddr);
 
     dbprint("--PTLookup: pdpi_entry = 0x%.8x\n", pdpi_entry);
-    vmi_read_64_pa(instance, pdpi_entry, &value);
-    return value;
+    return read_pt_64(instance, pdpi_entry);
 }
 
 addr_t get_pdpt_index_ia32e (addr_t vaddr)
@@ -100,11 +123,9 @@ addr_t get_pdpt_index_ia32e (addr_t vaddr)
 
 uint64_t get_pdpte_ia32e (vmi_instance_t vmi, addr_t vaddr, uint64_t pml4e)
 {
-    uint64_t value = 0;
     addr_t pdpte_address = get_bits_51to12(pml4e) | get_pdpt_index_ia32e(vaddr);
     dbprint("--PTLookup: pdpte_address = 0x%.16"PRIx64"\n", pdpte_address);
-    vmi_read_64_pa(vmi, pdpte_address, &value);
-    return value;
+    return read_pt_64(vmi, pdpte_address);
 }
 
 /* page directory */
@@ -130,20 +151,16 @@ uint64_t pdba_base_pae (uint64_t pdpe)
 
 uint32_t get_pgd_nopae (vmi_instance_t instance, uint32_t vaddr, uint32_t pdpe)
 {
-    uint32_t value;
-    uint32_t pgd_entry = pdba_base_nopae(pdpe) + pgd_index(instance, vaddr);
+    uint32_t pgd_entry = pdba_base_nopae(pdpe) + ((vaddr >> 22) & 0x3FF) * 4;
     dbprint("--PTLookup: pgd_entry = 0x%.8x\n", pgd_entry);
-    vmi_read_32_pa(instance, pgd_entry, &value);
-    return value;
+    return read_pt_32(instance, pgd_entry);
 }
 
 uint64_t get_pgd_pae (vmi_instance_t instance, uint32_t vaddr, uint64_t pdpe)
 {
-    uint64_t value;
-    uint32_t pgd_entry = pdba_base_pae(pdpe) + pgd_index(instance, vaddr);
-    dbprint("--PTLookup: pgd_entry = 0x%.8x\n", pgd_entry);
-    vmi_read_64_pa(instance, pgd_entry, &value);
-    return value;
+    addr_t pgd_entry = pdba_base_pae(pdpe) + ((vaddr >> 21) & 0x1FF) * 8;
+    dbprint("--PTLookup: pgd_entry = 0x%.16"PRIx64"\n", pgd_entry);
+    return read_pt_64(instance, pgd_entry);
 }
 
 uint64_t get_pd_index_ia32e (addr_t vaddr)
@@ -153,11 +170,9 @@ uint64_t get_pd_index_ia32e (addr_t vaddr)
 
 uint64_t get_pde_ia32e (vmi_instance_t vmi, addr_t vaddr, uint64_t pdpte)
 {
-    uint64_t value = 0;
     addr_t pde_address = get_bits_51to12(pdpte) | get_pd_index_ia32e(vaddr);
     dbprint("--PTLookup: pde_address = 0x%.16"PRIx64"\n", pde_address);
-    vmi_read_64_pa(vmi, pde_address, &value);
-    return value;
+    return read_pt_64(vmi, pde_address);
 }
 
 /* page table */
@@ -183,20 +198,16 @@ uint64_t ptba_base_pae (uint64_t pde)
 
 uint32_t get_pte_nopae (vmi_instance_t instance, uint32_t vaddr, uint32_t pgd)
 {
-    uint32_t value;
-    uint32_t pte_entry = ptba_base_nopae(pgd) + pte_index(instance, vaddr);
+    uint32_t pte_entry = ptba_base_nopae(pgd) + ((vaddr >> 12) & 0x3FF) * 4;
     dbprint("--PTLookup: pte_entry = 0x%.8x\n", pte_entry);
-    vmi_read_32_pa(instance, pte_entry, &value);
-    return value;
+    return read_pt_32(instance, pte_entry);
 }
 
 uint64_t get_pte_pae (vmi_instance_t instance, uint32_t vaddr, uint64_t pgd)
 {
-    uint64_t value;
-    uint32_t pte_entry = ptba_base_pae(pgd) + pte_index(instance, vaddr);
-    dbprint("--PTLookup: pte_entry = 0x%.8x\n", pte_entry);
-    vmi_read_64_pa(instance, pte_entry, &value);
-    return value;
+    addr_t pte_entry = ptba_base_pae(pgd) + ((vaddr >> 12) & 0x1FF) * 8;
+    dbprint("--PTLookup: pte_entry = 0x%.16"PRIx64"\n", pte_entry);
+    return read_pt_64(instance, pte_entry);
 }
 
 uint64_t get_pt_index_ia32e (addr_t vaddr)
@@ -206,11 +217,9 @@ uint64_t get_pt_index_ia32e (addr_t vaddr)
 
 uint64_t get_pte_ia32e (vmi_instance_t vmi, addr_t vaddr, uint64_t pde)
 {
-    uint64_t value = 0;
     addr_t pte_address = get_bits_51to12(pde) | get_pt_index_ia32e(vaddr);
     dbprint("--PTLookup: pte_address = 0x%.16"PRIx64"\n", pte_address);
-    vmi_read_64_pa(vmi, pte_address, &value);
-    return value;
+    return read_pt_64(vmi, pte_address);
 }
 
 /* page */
@@ -319,22 +328,48 @@ void buffalo_nopae (vmi_instance_t instance, uint32_t entry, int pde)
 }
 
 /* translation */
-addr_t v2p_nopae (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
+
+/*
+ * Upper-level entries go to the paging-structure cache when they point to
+ * the next table, the same entries that the processor itself would cache.
+ * Every table these walks read is noted, so that writing to it drops the
+ * translations they return.
+ */
+static int pt_cacheable (uint64_t entry)
+{
+    return vmi_get_bit(entry, 0) && !page_size_flag(entry);
+}
+
+addr_t v2p_nopae (vmi_instance_t vmi, addr_t dtb, addr_t vaddr,
+        uint32_t *page_shift)
 {
     addr_t paddr = 0;
     uint32_t pgd, pte;
+    uint64_t entry = 0;
 
     dbprint("--PTLookup: lookup vaddr = 0x%.16"PRIx64"\n", vaddr);
     dbprint("--PTLookup: dtb = 0x%.16"PRIx64"\n", dtb);
-    pgd = get_pgd_nopae(vmi, vaddr, dtb);
+    if (VMI_SUCCESS ==
+        pt_cache_get(vmi, dtb, vaddr, PT_SHIFT_PDE_NOPAE, 1, &entry)) {
+        pgd = (uint32_t) entry;
+    }
+    else {
+        v2p_cache_note_table(vmi, pdba_base_nopae(dtb), dtb);
+        pgd = get_pgd_nopae(vmi, vaddr, dtb);
+        if (pt_cacheable(pgd)) {
+            pt_cache_set(vmi, dtb, vaddr, PT_SHIFT_PDE_NOPAE, pgd);
+        }
+    }
     dbprint("--PTLookup: pgd = 0x%.8"PRIx32"\n", pgd);
 
     if (entry_present(vmi->os_type, pgd)) {
         if (page_size_flag(pgd)) {
             paddr = get_large_paddr(vmi, vaddr, pgd);
+            *page_shift = PT_SHIFT_PDE_NOPAE;
             dbprint("--PTLookup: 4MB page 0x%"PRIx32"\n", pgd);
         }
         else {
+            v2p_cache_note_table(vmi, ptba_base_nopae(pgd), dtb);
             pte = get_pte_nopae(vmi, vaddr, pgd);
             dbprint("--PTLookup: pte = 0x%.8"PRIx32"\n", pte);
             if (entry_present(vmi->os_type, pte)) {
@@ -352,27 +387,44 @@ addr_t v2p_nopae (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
     return paddr;
 }
 
-addr_t v2p_pae (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
+addr_t v2p_pae (vmi_instance_t vmi, addr_t dtb, addr_t vaddr,
+        uint32_t *page_shift)
 {
     addr_t paddr = 0;
     uint64_t pdpe, pgd, pte;
 
     dbprint("--PTLookup: lookup vaddr = 0x%.16"PRIx64"\n", vaddr);
     dbprint("--PTLookup: dtb = 0x%.16"PRIx64"\n", dtb);
-    pdpe = get_pdpi(vmi, vaddr, dtb);
-    dbprint("--PTLookup: pdpe = 0x%.16"PRIx64"\n", pdpe);
-    if (!entry_present(vmi->os_type, pdpe)) {
-        return paddr;
+    if (VMI_SUCCESS !=
+        pt_cache_get(vmi, dtb, vaddr, PT_SHIFT_PDE, 2, &pgd)) {
+        if (VMI_SUCCESS !=
+            pt_cache_get(vmi, dtb, vaddr, PT_SHIFT_PDPTE, 1, &pdpe)) {
+            v2p_cache_note_table(vmi, get_pdptb(dtb), dtb);
+            pdpe = get_pdpi(vmi, vaddr, dtb);
+            dbprint("--PTLookup: pdpe = 0x%.16"PRIx64"\n", pdpe);
+            if (!entry_present(vmi->os_type, pdpe)) {
+                return paddr;
+            }
+            if (pt_cacheable(pdpe)) {
+                pt_cache_set(vmi, dtb, vaddr, PT_SHIFT_PDPTE, pdpe);
+            }
+        }
+        v2p_cache_note_table(vmi, pdba_base_pae(pdpe), dtb);
+        pgd = get_pgd_pae(vmi, vaddr, pdpe);
+        if (pt_cacheable(pgd)) {
+            pt_cache_set(vmi, dtb, vaddr, PT_SHIFT_PDE, pgd);
+        }
     }
-    pgd = get_pgd_pae(vmi, vaddr, pdpe);
     dbprint("--PTLookup: pgd = 0x%.16"PRIx64"\n", pgd);
 
     if (entry_present(vmi->os_type, pgd)) {
         if (page_size_flag(pgd)) {
             paddr = get_large_paddr(vmi, vaddr, pgd);
+            *page_shift = PT_SHIFT_PDE;
             dbprint("--PTLookup: 2MB page\n");
         }
         else {
+            v2p_cache_note_table(vmi, ptba_base_pae(pgd), dtb);
             pte = get_pte_pae(vmi, vaddr, pgd);
             dbprint("--PTLookup: pte = 0x%.16"PRIx64"\n", pte);
             if (entry_present(vmi->os_type, pte)) {
@@ -384,7 +436,8 @@ addr_t v2p_pae (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
     return paddr;
 }
 
-addr_t v2p_ia32e (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
+addr_t v2p_ia32e (vmi_instance_t vmi, addr_t dtb, addr_t vaddr,
+        uint32_t *page_shift)
 {
     addr_t paddr = 0;
     uint64_t pml4e = 0, pdpte = 0, pde = 0, pte = 0;
@@ -397,50 +450,113 @@ addr_t v2p_ia32e (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
 
     dbprint("--PTLookup: lookup vaddr = 0x%.16"PRIx64"\n", vaddr);
     dbprint("--PTLookup: dtb = 0x%.16"PRIx64"\n", dtb);
+
+    /* start below the deepest upper-level entry that is cached */
+    if (VMI_SUCCESS == pt_cache_get(vmi, dtb, vaddr, PT_SHIFT_PDE, 3, &pde)) {
+        goto pte_lookup;
+    }
+    if (VMI_SUCCESS ==
+        pt_cache_get(vmi, dtb, vaddr, PT_SHIFT_PDPTE, 2, &pdpte)) {
+        goto pde_lookup;
+    }
+    if (VMI_SUCCESS ==
+        pt_cache_get(vmi, dtb, vaddr, PT_SHIFT_PML4E, 1, &pml4e)) {
+        goto pdpte_lookup;
+    }
+
+    v2p_cache_note_table(vmi, get_bits_51to12(dtb), dtb);
     pml4e = get_pml4e(vmi, vaddr, dtb);
     dbprint("--PTLookup: pml4e = 0x%.16"PRIx64"\n", pml4e);
+    if (!entry_present(vmi->os_type, pml4e)) {
+        goto done;
+    }
+    if (pt_cacheable(pml4e)) {
+        pt_cache_set(vmi, dtb, vaddr, PT_SHIFT_PML4E, pml4e);
+    }
 
-    if (entry_present(vmi->os_type, pml4e)) {
-        pdpte = get_pdpte_ia32e(vmi, vaddr, pml4e);
-        dbprint("--PTLookup: pdpte = 0x%.16"PRIx64"\n", pdpte);
+pdpte_lookup:
+    v2p_cache_note_table(vmi, get_bits_51to12(pml4e), dtb);
+    pdpte = get_pdpte_ia32e(vmi, vaddr, pml4e);
+    dbprint("--PTLookup: pdpte = 0x%.16"PRIx64"\n", pdpte);
+    if (!entry_present(vmi->os_type, pdpte)) {
+        goto done;
+    }
+    if (page_size_flag(pdpte)) { // pdpte maps a 1GB page
+        paddr = get_gigpage_ia32e(vaddr, pdpte);
+        *page_shift = PT_SHIFT_PDPTE;
+        dbprint("--PTLookup: 1GB page\n");
+        goto done;
+    }
+    if (pt_cacheable(pdpte)) {
+        pt_cache_set(vmi, dtb, vaddr, PT_SHIFT_PDPTE, pdpte);
+    }
 
-        if (entry_present(vmi->os_type, pdpte)) {
-            if (page_size_flag(pdpte)) { // pdpte maps a 1GB page
-                paddr = get_gigpage_ia32e(vaddr, pdpte);
-                dbprint("--PTLookup: 1GB page\n");
-            }
-            else {
-                pde = get_pde_ia32e(vmi, vaddr, pdpte);
-                dbprint("--PTLookup: pde = 0x%.16"PRIx64"\n", pde);
-            }
+pde_lookup:
+    v2p_cache_note_table(vmi, get_bits_51to12(pdpte), dtb);
+    pde = get_pde_ia32e(vmi, vaddr, pdpte);
+    dbprint("--PTLookup: pde = 0x%.16"PRIx64"\n", pde);
+    if (!entry_present(vmi->os_type, pde)) {
+        goto done;
+    }
+    if (page_size_flag(pde)) { // pde maps a 2MB page
+        paddr = get_2megpage_ia32e(vaddr, pde);
+        *page_shift = PT_SHIFT_PDE;
+        dbprint("--PTLookup: 2MB page\n");
+        goto done;
+    }
+    if (pt_cacheable(pde)) {
+        pt_cache_set(vmi, dtb, vaddr, PT_SHIFT_PDE, pde);
+    }
 
-            if (entry_present(vmi->os_type, pde)) {
-                if (page_size_flag(pde)) { // pde maps a 2MB page
-                    paddr = get_2megpage_ia32e(vaddr, pde);
-                    dbprint("--PTLookup: 2MB page\n");
-                }
-                else {
-                    pte = get_pte_ia32e(vmi, vaddr, pde);
-                    dbprint("--PTLookup: pte = 0x%.16"PRIx64"\n", pte);
-                }
-
-                if (entry_present(vmi->os_type, pte)) {
-                    paddr = get_paddr_ia32e(vaddr, pte);
-                }
-            }
-        }
+pte_lookup:
+    v2p_cache_note_table(vmi, get_bits_51to12(pde), dtb);
+    pte = get_pte_ia32e(vmi, vaddr, pde);
+    dbprint("--PTLookup: pte = 0x%.16"PRIx64"\n", pte);
+    if (entry_present(vmi->os_type, pte)) {
+        paddr = get_paddr_ia32e(vaddr, pte);
     }
 
+done:
     dbprint("--PTLookup: paddr = 0x%.16"PRIx64"\n", paddr);
     return paddr;
 }
 
+static addr_t v2p_unknown (vmi_instance_t vmi, addr_t dtb, addr_t vaddr,
+        uint32_t *page_shift)
+{
+    errprint("Invalid paging mode during vmi_pagetable_lookup\n");
+    return 0;
+}
+
+/* pick the page table walker once, whenever the paging mode is set */
+void v2p_select (vmi_instance_t vmi)
+{
+    switch (vmi->page_mode) {
+    case VMI_PM_LEGACY:
+        vmi->v2p = v2p_nopae;
+        break;
+    case VMI_PM_PAE:
+        vmi->v2p = v2p_pae;
+        break;
+    case VMI_PM_IA32E:
+        vmi->v2p = v2p_ia32e;
+        break;
+    default:
+        vmi->v2p = v2p_unknown;
+        break;
+    }
+}
+
 addr_t vmi_pagetable_lookup (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
 {
     addr_t paddr = 0;
+    uint32_t page_shift = vmi->page_shift;
 
     /* check if entry exists in the cachec */
     if (VMI_SUCCESS == v2p_cache_get(vmi, vaddr, dtb, &paddr)) {
+        if (!vmi->v2p_paranoid) {
+            return paddr;
+        }
 
         /* verify that address is still valid */
         uint8_t value = 0;
@@ -453,27 +569,406 @@ addr_t vmi_pagetable_lookup (vmi_instance_t vmi, addr_t dtb, addr_t vaddr)
         }
     }
 
+    /* unmapped when last walked */
+    if (!vmi->v2p_paranoid && VMI_SUCCESS == v2p_miss_get(vmi, vaddr, dtb)) {
+        return 0;
+    }
+
     /* do the actual page walk in guest memory */
-    if (vmi->page_mode == VMI_PM_LEGACY) {
-        paddr = v2p_nopae(vmi, dtb, vaddr);
+    paddr = vmi->v2p(vmi, dtb, vaddr, &page_shift);
+
+    /* add this to the cache */
+    if (paddr) {
+        v2p_cache_set(vmi, vaddr, dtb, paddr, page_shift);
+        p2v_index_add(vmi, dtb, vaddr, paddr, page_shift);
     }
-    else if (vmi->page_mode == VMI_PM_PAE) {
-        paddr = v2p_pae(vmi, dtb, vaddr);
+    else {
+        v2p_miss_set(vmi, vaddr, dtb);
     }
-    else if (vmi->page_mode == VMI_PM_IA32E) {
-        paddr = v2p_ia32e(vmi, dtb, vaddr);
+    return paddr;
+}
+
+/*
+ * State of a range walk: the last page table reached, so that the pages
+ * it maps are translated without walking the upper levels again.
+ */
+struct range_walk {
+    addr_t region;              /* va mapped by table, valid if table */
+    const uint8_t *table;
+    int mapped;                 /* table came from vmi_map_pa */
+    uint8_t buf[4096];
+};
+
+static void
+range_walk_release (vmi_instance_t vmi, struct range_walk *walk)
+{
+    if (walk->table && walk->mapped) {
+        vmi_unmap(vmi, walk->table);
+    }
+    walk->table = NULL;
+}
+
+/* walk the page tables for vaddr, noting each table read as the cached
+ * walk does, and report how many bytes from vaddr on are mapped
+ * contiguously by the same entry */
+static addr_t
+range_walk_translate (vmi_instance_t vmi, struct range_walk *walk,
+        addr_t dtb, addr_t vaddr, addr_t *span, uint32_t *page_shift)
+{
+    int legacy = (VMI_PM_LEGACY == vmi->page_mode);
+    addr_t region_size = legacy ? 0x400000ULL : 0x200000ULL;
+    addr_t region = vaddr & ~(region_size - 1);
+    addr_t pt = 0;
+    uint64_t entry = 0;
+
+    *span = 0x1000 - (vaddr & 0xFFF);
+    *page_shift = 12;
+
+    if (!walk->table || walk->region != region) {
+        range_walk_release(vmi, walk);
+
+        if (legacy) {
+            v2p_cache_note_table(vmi, pdba_base_nopae(dtb), dtb);
+            entry = get_pgd_nopae(vmi, vaddr, dtb);
+            if (!entry_present(vmi->os_type, entry)) {
+                return 0;
+            }
+            if (page_size_flag(entry)) {
+                *span = region + region_size - vaddr;
+                *page_shift = PT_SHIFT_PDE_NOPAE;
+                return get_large_paddr(vmi, vaddr, entry);
+            }
+            pt = ptba_base_nopae(entry);
+        }
+        else if (VMI_PM_PAE == vmi->page_mode) {
+            v2p_cache_note_table(vmi, get_pdptb(dtb), dtb);
+            entry = get_pdpi(vmi, vaddr, dtb);
+            if (!entry_present(vmi->os_type, entry)) {
+                return 0;
+            }
+            v2p_cache_note_table(vmi, pdba_base_pae(entry), dtb);
+            entry = get_pgd_pae(vmi, vaddr, entry);
+            if (!entry_present(vmi->os_type, entry)) {
+                return 0;
+            }
+            if (page_size_flag(entry)) {
+                *span = region + region_size - vaddr;
+                *page_shift = PT_SHIFT_PDE;
+                return get_large_paddr(vmi, vaddr, entry);
+            }
+            pt = ptba_base_pae(entry);
+        }
+        else if (VMI_PM_IA32E == vmi->page_mode) {
+            v2p_cache_note_table(vmi, get_bits_51to12(dtb), dtb);
+            entry = get_pml4e(vmi, vaddr, dtb);
+            if (!entry_present(vmi->os_type, entry)) {
+                return 0;
+            }
+            v2p_cache_note_table(vmi, get_bits_51to12(entry), dtb);
+            entry = get_pdpte_ia32e(vmi, vaddr, entry);
+            if (!entry_present(vmi->os_type, entry)) {
+                return 0;
+            }
+            if (page_size_flag(entry)) {
+                *span = (vaddr | 0x3FFFFFFFULL) + 1 - vaddr;
+                *page_shift = PT_SHIFT_PDPTE;
+                return get_gigpage_ia32e(vaddr, entry);
+            }
+            v2p_cache_note_table(vmi, get_bits_51to12(entry), dtb);
+            entry = get_pde_ia32e(vmi, vaddr, entry);
+            if (!entry_present(vmi->os_type, entry)) {
+                return 0;
+            }
+            if (page_size_flag(entry)) {
+                *span = region + region_size - vaddr;
+                *page_shift = PT_SHIFT_PDE;
+                return get_2megpage_ia32e(vaddr, entry);
+            }
+            pt = get_bits_51to12(entry);
+        }
+        else {
+            errprint("Invalid paging mode during vmi_translate_range\n");
+            return 0;
+        }
+
+        /* keep the whole page table at hand, in place if possible */
+        v2p_cache_note_table(vmi, pt, dtb);
+        if ((walk->table = vmi_map_pa(vmi, pt, sizeof(walk->buf))) != NULL) {
+            walk->mapped = 1;
+        }
+        else if (sizeof(walk->buf) ==
+                 vmi_read_pa(vmi, pt, walk->buf, sizeof(walk->buf))) {
+            walk->table = walk->buf;
+            walk->mapped = 0;
+        }
+        else {
+            return 0;
+        }
+        walk->region = region;
+    }
+
+    if (legacy) {
+        entry = ((const uint32_t *) walk->table)[(vaddr >> 12) & 0x3FF];
     }
     else {
-        errprint("Invalid paging mode during vmi_pagetable_lookup\n");
+        entry = ((const uint64_t *) walk->table)[(vaddr >> 12) & 0x1FF];
+    }
+    if (!entry_present(vmi->os_type, entry)) {
+        return 0;
     }
 
-    /* add this to the cache */
+    if (legacy) {
+        return get_paddr_nopae(vaddr, entry);
+    }
+    else if (VMI_PM_PAE == vmi->page_mode) {
+        return get_paddr_pae(vaddr, entry);
+    }
+    return get_paddr_ia32e(vaddr, entry);
+}
+
+/* translate vaddr from the v2p cache, else by the range walk, whose result
+ * is cached like any other, and report how many bytes from vaddr on are
+ * mapped contiguously */
+static addr_t
+range_walk_step (vmi_instance_t vmi, struct range_walk *walk, addr_t dtb,
+        addr_t vaddr, addr_t *span)
+{
+    addr_t paddr = 0;
+    uint32_t page_shift = 12;
+
+    if (!vmi->v2p_paranoid &&
+        VMI_SUCCESS == v2p_cache_get(vmi, vaddr, dtb, &paddr)) {
+        *span = 0x1000 - (vaddr & 0xFFF);
+        return paddr;
+    }
+
+    paddr = range_walk_translate(vmi, walk, dtb, vaddr, span, &page_shift);
     if (paddr) {
-        v2p_cache_set(vmi, vaddr, dtb, paddr);
+        v2p_cache_set(vmi, vaddr, dtb, paddr, page_shift);
+        p2v_index_add(vmi, dtb, vaddr, paddr, page_shift);
     }
     return paddr;
 }
 
+size_t
+vmi_translate_range (vmi_instance_t vmi, addr_t dtb, addr_t vaddr,
+        size_t length, vmi_extent_t **extents)
+{
+    struct range_walk *walk = safe_malloc(sizeof(struct range_walk));
+    vmi_extent_t *out = NULL;
+    size_t count = 0;
+    size_t size = 0;
+    addr_t done = 0;
+
+    walk->table = NULL;
+    while (done < length) {
+        addr_t span = 0;
+        addr_t paddr = range_walk_step(vmi, walk, dtb, vaddr + done, &span);
+
+        if (!paddr) {
+            break;
+        }
+        if (span > length - done) {
+            span = length - done;
+        }
+
+        if (count && out[count - 1].paddr + out[count - 1].length == paddr) {
+            out[count - 1].length += span;
+        }
+        else {
+            if (count == size) {
+                size = size ? size * 2 : 8;
+                out = realloc(out, size * sizeof(vmi_extent_t));
+            }
+            out[count].vaddr = vaddr + done;
+            out[count].paddr = paddr;
+            out[count].length = span;
+            count++;
+        }
+        done += span;
+    }
+
+    range_walk_release(vmi, walk);
+    free(walk);
+    *extents = out;
+    return count;
+}
+
+/*
+ * State of an address space walk: one buffer per paging level, so that
+ * each table is read once while the tables below it are walked, and the
+ * run of pages not yet reported.
+ */
+#define SPACE_WALK_LEVELS 4
+
+struct space_walk {
+    addr_t dtb;
+    vmi_walk_callback_t callback;
+    void *data;
+    const int *shifts;          /* va bits below each level's entries */
+    int levels;
+    vmi_page_extent_t run;      /* valid if run.length */
+    status_t status;            /* VMI_FAILURE once the callback stops */
+    uint8_t tables[SPACE_WALK_LEVELS][4096];
+};
+
+static const int space_walk_shifts_nopae[] = { 22, 12 };
+static const int space_walk_shifts_pae[] = { 30, 21, 12 };
+static const int space_walk_shifts_ia32e[] = { 39, 30, 21, 12 };
+
+static void
+space_walk_report (vmi_instance_t vmi, struct space_walk *walk, addr_t vaddr,
+        addr_t paddr, int shift, uint32_t permissions)
+{
+    vmi_page_extent_t *run = &walk->run;
+    uint64_t page_size = 1ULL << shift;
+
+    p2v_index_add(vmi, walk->dtb, vaddr, paddr, shift);
+    if (run->length && run->vaddr + run->length == vaddr &&
+        run->paddr + run->length == paddr && run->page_size == page_size &&
+        run->permissions == permissions) {
+        run->length += page_size;
+        return;
+    }
+
+    if (run->length && VMI_FAILURE == walk->callback(vmi, run, walk->data)) {
+        walk->status = VMI_FAILURE;
+    }
+    run->vaddr = vaddr;
+    run->paddr = paddr;
+    run->length = page_size;
+    run->page_size = page_size;
+    run->permissions = permissions;
+}
+
+static void
+space_walk_table (vmi_instance_t vmi, struct space_walk *walk, int level,
+        addr_t table, size_t count, addr_t vaddr, uint32_t permissions)
+{
+    int legacy = (VMI_PM_LEGACY == vmi->page_mode);
+    int shift = walk->shifts[level];
+    size_t entry_size = legacy ? sizeof(uint32_t) : sizeof(uint64_t);
+    uint8_t *buf = walk->tables[level];
+    size_t i = 0;
+
+    if (count * entry_size != vmi_read_pa(vmi, table, buf, count * entry_size)) {
+        dbprint("--Walk: failed to read page table 0x%.16"PRIx64"\n", table);
+        return;
+    }
+
+    for (i = 0; i < count && VMI_SUCCESS == walk->status; ++i) {
+        uint64_t entry = legacy ? ((uint32_t *) buf)[i] : ((uint64_t *) buf)[i];
+        uint64_t page_size = 1ULL << shift;
+        addr_t va = vaddr + i * page_size;
+        addr_t base = legacy ? ptba_base_nopae(entry) : get_bits_51to12(entry);
+        uint32_t perms = permissions;
+
+        if (!entry_present(vmi->os_type, entry)) {
+            continue;
+        }
+
+        /* the pdptes of PAE paging carry no permissions */
+        if (VMI_PM_PAE != vmi->page_mode || level) {
+            if (!vmi_get_bit(entry, 1)) {
+                perms &= ~VMI_PAGE_WRITE;
+            }
+            if (!vmi_get_bit(entry, 2)) {
+                perms &= ~VMI_PAGE_USER;
+            }
+            if (!legacy && vmi_get_bit(entry, 63)) {
+                perms &= ~VMI_PAGE_EXEC;
+            }
+        }
+
+        /* canonical form of the upper half of a 48-bit address space */
+        if (VMI_PM_IA32E == vmi->page_mode && (va & (1ULL << 47))) {
+            va |= 0xFFFF000000000000ULL;
+        }
+
+        if (level == walk->levels - 1) {
+            space_walk_report(vmi, walk, va, base, shift, perms);
+        }
+        else if (page_size_flag(entry) &&
+                 (shift == PT_SHIFT_PDE || shift == PT_SHIFT_PDE_NOPAE ||
+                  (shift == PT_SHIFT_PDPTE && VMI_PM_IA32E == vmi->page_mode))) {
+            base = legacy ? (entry & 0xFFC00000) : (base & ~(page_size - 1));
+            space_walk_report(vmi, walk, va, base, shift, perms);
+        }
+        else {
+            space_walk_table(vmi, walk, level + 1, base,
+                             legacy ? 1024 : 512, va, perms);
+        }
+    }
+}
+
+status_t
+vmi_walk_address_space (vmi_instance_t vmi, addr_t dtb,
+        vmi_walk_callback_t callback, void *data)
+{
+    struct space_walk *walk = NULL;
+    status_t ret = VMI_FAILURE;
+
+    walk = safe_malloc(sizeof(struct space_walk));
+    memset(walk, 0, sizeof(struct space_walk));
+    walk->dtb = dtb;
+    walk->callback = callback;
+    walk->data = data;
+    walk->status = VMI_SUCCESS;
+
+    if (VMI_PM_LEGACY == vmi->page_mode) {
+        walk->shifts = space_walk_shifts_nopae;
+        walk->levels = 2;
+        space_walk_table(vmi, walk, 0, pdba_base_nopae(dtb), 1024, 0,
+                         VMI_PAGE_WRITE | VMI_PAGE_USER | VMI_PAGE_EXEC);
+    }
+    else if (VMI_PM_PAE == vmi->page_mode) {
+        walk->shifts = space_walk_shifts_pae;
+        walk->levels = 3;
+        space_walk_table(vmi, walk, 0, get_pdptb(dtb), 4, 0,
+                         VMI_PAGE_WRITE | VMI_PAGE_USER | VMI_PAGE_EXEC);
+    }
+    else if (VMI_PM_IA32E == vmi->page_mode) {
+        walk->shifts = space_walk_shifts_ia32e;
+        walk->levels = 4;
+        space_walk_table(vmi, walk, 0, get_bits_51to12(dtb), 512, 0,
+                         VMI_PAGE_WRITE | VMI_PAGE_USER | VMI_PAGE_EXEC);
+    }
+    else {
+        errprint("Invalid paging mode during vmi_walk_address_space\n");
+        free(walk);
+        return VMI_FAILURE;
+    }
+
+    if (walk->run.length && VMI_SUCCESS == walk->status) {
+        walk->status = walk->callback(vmi, &walk->run, walk->data);
+    }
+    ret = walk->status;
+    free(walk);
+    return ret;
+}
+
+size_t
+vmi_translate_p2v (vmi_instance_t vmi, addr_t paddr, vmi_p2v_t **mappings)
+{
+    return p2v_index_lookup(vmi, paddr, mappings);
+}
+
+/* the dtb vmi_translate_kv2p (pid 0) or vmi_translate_uv2p walks */
+addr_t
+translate_dtb (vmi_instance_t vmi, int pid)
+{
+    reg_t cr3 = 0;
+
+    if (pid) {
+        return vmi_pid_to_dtb(vmi, pid);
+    }
+    if (vmi->kpgd) {
+        return vmi->kpgd;
+    }
+    driver_get_vcpureg(vmi, &cr3, CR3, 0);
+    return cr3;
+}
+
 /* expose virtual to physical mapping for kernel space via api call */
 addr_t vmi_translate_kv2p (vmi_instance_t vmi, addr_t virt_address)
 {
@@ -505,12 +1000,7 @@ addr_t vmi_translate_uv2p_nocache (vmi_instance_t vmi, addr_t virt_address,
         return 0;
     }
     else {
-        addr_t rtnval = vmi_pagetable_lookup(vmi, dtb, virt_address);
-
-        if (!rtnval) {
-            pid_cache_del(vmi, pid);
-        }
-        return rtnval;
+        return vmi_pagetable_lookup(vmi, dtb, virt_address);
     }
 }
 
@@ -525,7 +1015,9 @@ addr_t vmi_translate_uv2p (vmi_instance_t vmi, addr_t virt_address, int pid)
     else {
         addr_t rtnval = vmi_pagetable_lookup(vmi, dtb, virt_address);
 
-        if (!rtnval) {
+        /* an unmapped page says nothing about the dtb, unless the guest has
+         * run since it was found and the process may have exited */
+        if (!rtnval && pid_cache_stale(vmi, pid)) {
             if (VMI_SUCCESS == pid_cache_del(vmi, pid)) {
                 return vmi_translate_uv2p_nocache(vmi, virt_address, pid);
             }
@@ -599,15 +1091,20 @@ const char* vmi_translate_v2sym(vmi_instance_t vmi, addr_t base_vaddr, uint32_t
     if (VMI_FAILURE == rva_cache_get(vmi, base_vaddr, pid, rva, &ret)) {
 
         if (VMI_OS_LINUX == vmi->os_type) {
-            // TODO
-            return ret;
+            linux_system_map_address_to_symbol(vmi, base_vaddr + rva, &ret);
         }
         else if (VMI_OS_WINDOWS == vmi->os_type) {
             windows_rva_to_export(vmi, rva, base_vaddr, pid, &ret);
         }
 
         if (ret) {
-            rva_cache_set(vmi, base_vaddr, pid, rva, ret);
+            /* hand out the cached copy so repeated lookups share it */
+            char *cached = rva_cache_set(vmi, base_vaddr, pid, rva, ret);
+
+            if (cached) {
+                free(ret);
+                ret = cached;
+            }
         }
     }
 
@@ -661,3 +1158,133 @@ vmi_read_page (vmi_instance_t vmi, addr_t frame_num)
         return driver_read_page(vmi, frame_num);
     }
 }
+
+/* a pointer handed out by vmi_map_pa, keyed by that pointer */
+struct page_map {
+    struct memory_cache_entry *entry;   /* NULL for driver spans */
+    uint32_t refs;
+};
+
+const void *
+vmi_map_pa (vmi_instance_t vmi, addr_t paddr, size_t length)
+{
+    addr_t offset = (vmi->page_size - 1) & paddr;
+    struct memory_cache_entry *entry = NULL;
+    struct page_map *map = NULL;
+    uint8_t *data = NULL;
+
+    if (!length || !(paddr >> vmi->page_shift)) {
+        return NULL;
+    }
+
+    /* drivers that hold the whole image can map any span, everything
+     * else maps a single page pinned in the page cache */
+    if ((data = driver_map_span(vmi, paddr, length)) == NULL) {
+        if (offset + length > vmi->page_size) {
+            dbprint("--%s: 0x%.16"PRIx64" + %zu crosses a page\n",
+                    __FUNCTION__, paddr, length);
+            return NULL;
+        }
+        if ((data = memory_cache_pin(vmi, paddr - offset, &entry)) == NULL) {
+            return NULL;
+        }
+        data += offset;
+    }
+
+    if (NULL == vmi->page_maps) {
+        vmi->page_maps = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                               NULL, free);
+    }
+
+    if ((map = g_hash_table_lookup(vmi->page_maps, data)) != NULL) {
+        /* the existing mapping already holds a pin */
+        if (entry) {
+            memory_cache_unpin(vmi, entry);
+        }
+    }
+    else {
+        map = safe_malloc(sizeof(struct page_map));
+        map->entry = entry;
+        map->refs = 0;
+        g_hash_table_insert(vmi->page_maps, data, map);
+    }
+    map->refs++;
+    return data;
+}
+
+const void *
+vmi_map_va (vmi_instance_t vmi, addr_t vaddr, int pid, size_t length)
+{
+    addr_t paddr = 0;
+    addr_t next = 0;
+
+    if (pid) {
+        paddr = vmi_translate_uv2p(vmi, vaddr, pid);
+    }
+    else {
+        paddr = vmi_translate_kv2p(vmi, vaddr);
+    }
+    if (!paddr) {
+        return NULL;
+    }
+
+    /* a span is only mappable if it is physically contiguous */
+    next = (vaddr | (vmi->page_size - 1)) + 1;
+    for (; next < vaddr + length; next += vmi->page_size) {
+        addr_t expected = paddr + (next - vaddr);
+
+        if ((pid ? vmi_translate_uv2p(vmi, next, pid) :
+             vmi_translate_kv2p(vmi, next)) != expected) {
+            dbprint("--%s: 0x%.16"PRIx64" is not physically contiguous\n",
+                    __FUNCTION__, vaddr);
+            return NULL;
+        }
+    }
+
+    return vmi_map_pa(vmi, paddr, length);
+}
+
+void
+vmi_unmap (vmi_instance_t vmi, const void *data)
+{
+    struct page_map *map = NULL;
+
+    if (NULL == vmi->page_maps ||
+        (map = g_hash_table_lookup(vmi->page_maps, data)) == NULL) {
+        errprint("vmi_unmap: %p is not mapped\n", data);
+        return;
+    }
+
+    if (--map->refs) {
+        return;
+    }
+    if (map->entry) {
+        memory_cache_unpin(vmi, map->entry);
+    }
+    g_hash_table_remove(vmi->page_maps, data);
+}
+
+static void
+page_map_release(
+    gpointer key,
+    gpointer value,
+    gpointer data)
+{
+    struct page_map *map = value;
+
+    if (map->entry) {
+        memory_cache_unpin((vmi_instance_t) data, map->entry);
+    }
+}
+
+/* drop the mappings the caller never released */
+void
+page_maps_destroy (vmi_instance_t vmi)
+{
+    if (NULL == vmi->page_maps) {
+        return;
+    }
+    g_hash_table_foreach(vmi->page_maps, page_map_release, vmi);
+    g_hash_table_destroy(vmi->page_maps);
+    vmi->page_maps = NULL;
+}
@@ -69,3 +69,10 @@ linux_init(
 _exit:
     return ret;
 }
+
+void
+linux_destroy(
+    vmi_instance_t vmi)
+{
+    linux_system_map_release(vmi);
+}
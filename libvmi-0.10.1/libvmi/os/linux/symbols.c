@@ -29,99 +29,321 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #define MAX_ROW_LENGTH 500
 
+/*
+ * A System.map is parsed once into a name index and an address sorted
+ * array.  Instances opening the same, unchanged file share one table.
+ */
+struct linux_symbol {
+    addr_t address;
+    uint32_t name;  /* offset of the name in linux_symbol_table.names */
+    char type;
+};
+
+struct linux_symbol_table {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    uint32_t refs;
+    char *names;                    /* every name, NUL terminated */
+    struct linux_symbol *symbols;   /* sorted by address, then file order */
+    size_t count;
+    GHashTable *by_name;            /* name --> first symbol with that name */
+    addr_t end;                     /* _end, else the last location */
+};
+
+G_LOCK_DEFINE_STATIC(symbol_tables);
+static GSList *symbol_tables = NULL;
+
+/* absolute symbols are constants, not locations in the kernel image */
+static inline int
+symbol_is_location(
+    struct linux_symbol *sym)
+{
+    return sym->type != 'a' && sym->type != 'A';
+}
+
 static int
-get_symbol_row(
-    FILE * f,
-    char *row,
-    char *symbol,
-    int position)
+symbol_compare(
+    const void *a,
+    const void *b)
 {
-    int ret = VMI_FAILURE;
+    const struct linux_symbol *sa = a;
+    const struct linux_symbol *sb = b;
+
+    if (sa->address != sb->address) {
+        return sa->address < sb->address ? -1 : 1;
+    }
+    return sa->name < sb->name ? -1 : (sa->name > sb->name);
+}
 
+static void
+symbol_table_free(
+    struct linux_symbol_table *table)
+{
+    if (table->by_name) {
+        g_hash_table_destroy(table->by_name);
+    }
+    free(table->symbols);
+    free(table->names);
+    free(table->path);
+    free(table);
+}
+
+static struct linux_symbol_table *
+symbol_table_load(
+    const char *path,
+    struct stat *st)
+{
+    struct linux_symbol_table *table = NULL;
+    struct linux_symbol *end = NULL;
+    FILE *f = NULL;
+    char row[MAX_ROW_LENGTH];
+    size_t names_len = 0, names_size = 0, size = 0, i = 0;
+
+    if ((f = fopen(path, "r")) == NULL) {
+        return NULL;
+    }
+
+    table = safe_malloc(sizeof(struct linux_symbol_table));
+    memset(table, 0, sizeof(struct linux_symbol_table));
+    table->path = strdup(path);
+    table->dev = st->st_dev;
+    table->ino = st->st_ino;
+    table->size = st->st_size;
+    table->mtime = st->st_mtime;
+
+    /* each row is "<address> <type> <name>" */
     while (fgets(row, MAX_ROW_LENGTH, f) != NULL) {
-        char *token = NULL;
-
-        /* find the correct token to check */
-        int curpos = 0;
-        int position_copy = position;
-
-        while (position_copy > 0 && curpos < MAX_ROW_LENGTH) {
-            if (isspace(row[curpos])) {
-                while (isspace(row[curpos])) {
-                    row[curpos] = '\0';
-                    ++curpos;
-                }
-                --position_copy;
-                continue;
-            }
-            ++curpos;
-        }
-        if (position_copy == 0) {
-            token = row + curpos;
-            while (curpos < MAX_ROW_LENGTH) {
-                if (isspace(row[curpos])) {
-                    row[curpos] = '\0';
-                    break;
-                }
-                ++curpos;
-            }
+        char *name = row;
+        char type = 0;
+        size_t len = 0;
+        addr_t address = (addr_t) strtoull(row, &name, 16);
+
+        if (name == row) {
+            continue;
         }
-        else {  /* some went wrong in the loop above */
-            goto error_exit;
+        while (isspace(*name)) ++name;
+        type = *name;
+        while (*name && !isspace(*name)) ++name;
+        while (isspace(*name)) ++name;
+        if ((len = strcspn(name, " \t\r\n")) == 0) {
+            continue;
         }
 
-        /* check the token */
-        if (strncmp(token, symbol, MAX_ROW_LENGTH) == 0) {
-            ret = VMI_SUCCESS;
+        if (names_len + len + 1 > UINT32_MAX) {
             break;
         }
+        if (names_len + len + 1 > names_size) {
+            names_size = names_size ? names_size * 2 : 64 * 1024;
+            table->names = realloc(table->names, names_size);
+        }
+        if (table->count == size) {
+            size = size ? size * 2 : 4096;
+            table->symbols = realloc(table->symbols,
+                                     size * sizeof(struct linux_symbol));
+        }
+        if (!table->names || !table->symbols) {
+            errprint("Out of memory parsing %s.\n", path);
+            fclose(f);
+            symbol_table_free(table);
+            return NULL;
+        }
+
+        memcpy(table->names + names_len, name, len);
+        table->names[names_len + len] = '\0';
+        table->symbols[table->count].address = address;
+        table->symbols[table->count].name = names_len;
+        table->symbols[table->count].type = type;
+        table->count++;
+        names_len += len + 1;
+    }
+    fclose(f);
+
+    qsort(table->symbols, table->count, sizeof(struct linux_symbol),
+          symbol_compare);
+
+    /* keep the first row of a duplicated name, as the old linear scan did */
+    table->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    for (i = 0; i < table->count; ++i) {
+        struct linux_symbol *sym = &table->symbols[i];
+        char *name = table->names + sym->name;
+        struct linux_symbol *seen = g_hash_table_lookup(table->by_name, name);
+
+        if (!seen || sym->name < seen->name) {
+            g_hash_table_insert(table->by_name, name, sym);
+        }
     }
 
-error_exit:
-    if (ret == VMI_FAILURE) {
-        memset(row, 0, MAX_ROW_LENGTH);
+    /* nothing is known to lie past the end of the kernel image */
+    if ((end = g_hash_table_lookup(table->by_name, "_end")) != NULL) {
+        table->end = end->address;
     }
-    return ret;
+    else {
+        for (i = table->count; i > 0; --i) {
+            if (symbol_is_location(&table->symbols[i - 1])) {
+                table->end = table->symbols[i - 1].address;
+                break;
+            }
+        }
+    }
+
+    dbprint("--parsed %zu symbols from %s.\n", table->count, path);
+    return table;
 }
 
-status_t
-linux_system_map_symbol_to_address(
-    vmi_instance_t vmi,
-    char *symbol,
-    addr_t *address)
+static struct linux_symbol_table *
+symbol_table_get(
+    const char *path)
 {
-    FILE *f = NULL;
-    char *row = NULL;
-    int ret = VMI_SUCCESS;
+    struct linux_symbol_table *table = NULL;
+    struct stat st;
+    GSList *item = NULL;
+
+    if (stat(path, &st) != 0) {
+        return NULL;
+    }
+
+    G_LOCK(symbol_tables);
+    for (item = symbol_tables; item; item = item->next) {
+        table = item->data;
+        if (strcmp(table->path, path) == 0 &&
+            table->dev == st.st_dev && table->ino == st.st_ino &&
+            table->size == st.st_size && table->mtime == st.st_mtime) {
+            table->refs++;
+            G_UNLOCK(symbol_tables);
+            return table;
+        }
+    }
+    G_UNLOCK(symbol_tables);
+
+    /* parse outside the lock; a racing parse of the same file is harmless */
+    if ((table = symbol_table_load(path, &st)) != NULL) {
+        G_LOCK(symbol_tables);
+        table->refs = 1;
+        symbol_tables = g_slist_prepend(symbol_tables, table);
+        G_UNLOCK(symbol_tables);
+    }
+    return table;
+}
+
+static struct linux_symbol_table *
+linux_symbol_table(
+    vmi_instance_t vmi)
+{
+    struct linux_instance *linux_instance = &vmi->os.linux_instance;
+
+    if (linux_instance->symbol_table) {
+        return linux_instance->symbol_table;
+    }
 
     if ((NULL == vmi->sysmap) || (strlen(vmi->sysmap) == 0)) {
         vmi->sysmap = strndup("unknown", 10);
     }
 
-    row = safe_malloc(MAX_ROW_LENGTH);
-    if ((f = fopen(vmi->sysmap, "r")) == NULL) {
+    if ((linux_instance->symbol_table = symbol_table_get(vmi->sysmap)) == NULL) {
         fprintf(stderr,
                 "ERROR: could not find System.map file after checking:\n");
         fprintf(stderr, "\t%s\n", vmi->sysmap);
         fprintf(stderr,
                 "To fix this problem, add the correct sysmap entry to /etc/libvmi.conf\n");
-        ret = VMI_FAILURE;
-        goto error_exit;
     }
-    if (get_symbol_row(f, row, symbol, 2) == VMI_FAILURE) {
-        ret = VMI_FAILURE;
-        goto error_exit;
+    return linux_instance->symbol_table;
+}
+
+void
+linux_system_map_release(
+    vmi_instance_t vmi)
+{
+    struct linux_symbol_table *table = vmi->os.linux_instance.symbol_table;
+
+    if (!table) {
+        return;
+    }
+    vmi->os.linux_instance.symbol_table = NULL;
+
+    G_LOCK(symbol_tables);
+    if (--table->refs == 0) {
+        symbol_tables = g_slist_remove(symbol_tables, table);
+        symbol_table_free(table);
     }
+    G_UNLOCK(symbol_tables);
+}
 
-    *address = (addr_t) strtoull(row, NULL, 16);
+status_t
+linux_system_map_symbol_to_address(
+    vmi_instance_t vmi,
+    char *symbol,
+    addr_t *address)
+{
+    struct linux_symbol_table *table = linux_symbol_table(vmi);
+    struct linux_symbol *sym = NULL;
 
-error_exit:
-    if (row)
-        free(row);
-    if (f)
-        fclose(f);
-    return ret;
+    if (!table) {
+        return VMI_FAILURE;
+    }
+    if ((sym = g_hash_table_lookup(table->by_name, symbol)) == NULL) {
+        return VMI_FAILURE;
+    }
+
+    *address = sym->address;
+    return VMI_SUCCESS;
+}
+
+status_t
+linux_system_map_address_to_symbol(
+    vmi_instance_t vmi,
+    addr_t address,
+    char **symbol)
+{
+    struct linux_symbol_table *table = linux_symbol_table(vmi);
+    struct linux_symbol *sym = NULL;
+    char *name = NULL;
+    size_t low = 0, high = 0, length = 0;
+
+    if (!table || !table->count || address > table->end) {
+        return VMI_FAILURE;
+    }
+
+    /* find the first symbol above the address */
+    high = table->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (table->symbols[mid].address <= address) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    /* the closest location at or below it, first in file order on ties */
+    while (low > 0 && !symbol_is_location(&table->symbols[low - 1])) {
+        --low;
+    }
+    if (low == 0) {
+        return VMI_FAILURE;
+    }
+    sym = &table->symbols[low - 1];
+    while (sym > table->symbols && (sym - 1)->address == sym->address &&
+           symbol_is_location(sym - 1)) {
+        --sym;
+    }
+
+    name = table->names + sym->name;
+    length = strlen(name) + sizeof("+0x") + 16;
+    *symbol = safe_malloc(length);
+    if (address == sym->address) {
+        snprintf(*symbol, length, "%s", name);
+    }
+    else {
+        snprintf(*symbol, length, "%s+0x%"PRIx64, name, address - sym->address);
+    }
+    return VMI_SUCCESS;
 }
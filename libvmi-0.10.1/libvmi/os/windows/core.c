@@ -69,6 +69,7 @@ find_page_mode(
 
     dbprint("--trying VMI_PM_LEGACY\n");
     vmi->page_mode = VMI_PM_LEGACY;
+    v2p_select(vmi);
     if (VMI_SUCCESS == vmi_read_addr_ksym(vmi, "KernBase", &proc)) {
         goto found_pm;
     }
@@ -76,6 +77,7 @@ find_page_mode(
 
     dbprint("--trying VMI_PM_PAE\n");
     vmi->page_mode = VMI_PM_PAE;
+    v2p_select(vmi);
     if (VMI_SUCCESS == vmi_read_addr_ksym(vmi, "KernBase", &proc)) {
         goto found_pm;
     }
@@ -83,6 +85,7 @@ find_page_mode(
 
     dbprint("--trying VMI_PM_IA32E\n");
     vmi->page_mode = VMI_PM_IA32E;
+    v2p_select(vmi);
     if (VMI_SUCCESS == vmi_read_addr_ksym(vmi, "KernBase", &proc)) {
         goto found_pm;
     }
@@ -143,6 +146,7 @@ get_kpgd_method2(
     }
     vmi->init_task -= vmi->os.windows_instance.tasks_offset;
     dbprint("**set init_task (0x%.16"PRIx64").\n", vmi->init_task);
+    vmi->os.windows_instance.sysproc = sysproc;
 
     return VMI_SUCCESS;
 
@@ -202,6 +206,7 @@ get_kpgd_method1(
     }
     vmi->init_task -= vmi->os.windows_instance.tasks_offset;
     dbprint("**set init_task (0x%.16"PRIx64").\n", vmi->init_task);
+    vmi->os.windows_instance.sysproc = sysproc;
 
     return VMI_SUCCESS;
 
@@ -255,6 +260,7 @@ get_kpgd_method0(
     }
     vmi->init_task -= vmi->os.windows_instance.tasks_offset;
     dbprint("**set init_task (0x%.16"PRIx64").\n", vmi->init_task);
+    vmi->os.windows_instance.sysproc = sysproc;
 
     return VMI_SUCCESS;
 
@@ -308,6 +314,9 @@ windows_init(
     goto error_exit;
 
 found_kpgd:
+    if (vmi->profile_cache) {
+        windows_profile_save(vmi);
+    }
     return VMI_SUCCESS;
 error_exit:
     return VMI_FAILURE;
@@ -77,165 +77,6 @@ dump_exports(
     }
 }
 
-status_t
-get_export_rva(
-    vmi_instance_t vmi,
-    addr_t *rva,
-    int aof_index,
-    struct export_table *et,
-    addr_t base_addr,
-    uint32_t pid)
-{
-    addr_t rva_loc =
-        base_addr + et->address_of_functions +
-        aof_index * sizeof(uint32_t);
-
-    uint32_t tmp = 0;
-    status_t ret = vmi_read_32_va(vmi, rva_loc, pid, &tmp);
-
-    *rva = (addr_t) tmp;
-    return ret;
-}
-
-int
-get_aof_index(
-    vmi_instance_t vmi,
-    int aon_index,
-    struct export_table *et,
-    addr_t base_addr,
-    uint32_t pid)
-{
-    addr_t aof_index_loc =
-        base_addr + et->address_of_name_ordinals +
-        aon_index * sizeof(uint16_t);
-
-    uint16_t aof_index = 0;
-
-    if (vmi_read_16_va(vmi, aof_index_loc, pid, &aof_index) ==
-        VMI_SUCCESS) {
-        return (int) aof_index;
-    }
-    else {
-        return -1;
-    }
-}
-
-// Finds the index of the exported symbol specified - linear search
-int
-get_aon_index_linear(
-    vmi_instance_t vmi,
-    char *symbol,
-    struct export_table *et,
-    addr_t base_addr,
-    uint32_t pid)
-{
-    uint32_t i = 0;
-
-    for (; i < et->number_of_names; ++i) {
-        addr_t str_rva_loc =
-            base_addr + et->address_of_names + i * sizeof(uint32_t);
-        uint32_t str_rva = 0;
-
-        vmi_read_32_va(vmi, str_rva_loc, pid, &str_rva);
-        if (str_rva) {
-            char *rva = rva_to_string(vmi, (addr_t) str_rva, base_addr, pid);
-
-            if (NULL != rva) {
-                if (strncmp(rva, symbol, strlen(rva)) == 0) {
-                    free(rva);
-                    return (int) i;
-                }
-            }
-            free(rva);
-        }
-    }
-
-    /* didn't find anything that matched */
-    return -1;
-}
-
-// binary search function for get_aon_index_binary()
-static int
-find_aon_idx_bin(
-    vmi_instance_t vmi,
-    char *symbol,
-    addr_t aon_base_va,
-    int low,
-    int high,
-    addr_t base_addr,
-    uint32_t pid)
-{
-    int mid, cmp;
-    addr_t str_rva_loc; // location of curr name's RVA
-    uint32_t str_rva;   // RVA of curr name
-    char *name = 0; // curr name
-
-    if (high < low)
-        goto not_found;
-
-    // calc the current index ("mid")
-    mid = (low + high) / 2;
-    str_rva_loc = aon_base_va + mid * sizeof(uint32_t);
-
-    vmi_read_32_va(vmi, str_rva_loc, pid, &str_rva);
-
-    if (!str_rva)
-        goto not_found;
-
-    // get the curr string & compare to symbol
-    name = rva_to_string(vmi, (addr_t) str_rva, base_addr, pid);
-    cmp = strcmp(symbol, name);
-    free(name);
-
-    if (cmp < 0) {  // symbol < name ==> try lower region
-        return find_aon_idx_bin(vmi, symbol, aon_base_va, low, mid - 1, base_addr, pid);
-    }
-    else if (cmp > 0) { // symbol > name ==> try higher region
-        return find_aon_idx_bin(vmi, symbol, aon_base_va, mid + 1, high, base_addr, pid);
-    }
-    else {  // symbol == name
-        return mid; // found
-    }
-
-not_found:
-    return -1;
-}
-
-// Finds the index of the exported symbol specified - binary search
-int
-get_aon_index_binary(
-    vmi_instance_t vmi,
-    char *symbol,
-    struct export_table *et,
-    addr_t base_addr,
-    uint32_t pid)
-{
-    addr_t aon_base_addr = base_addr + et->address_of_names;
-    int name_ct = et->number_of_names;
-
-    return find_aon_idx_bin(vmi, symbol, aon_base_addr, 0, name_ct - 1, base_addr, pid);
-}
-
-int
-get_aon_index(
-    vmi_instance_t vmi,
-    char *symbol,
-    struct export_table *et,
-    addr_t base_addr,
-    uint32_t pid)
-{
-    int index = get_aon_index_binary(vmi, symbol, et, base_addr, pid);
-
-    if (-1 == index) {
-        dbprint
-            ("--PEParse: Falling back to linear search for aon index\n");
-        // This could be useful for malformed PE headers where the list isn't
-        // in alpha order (e.g., malware)
-        index = get_aon_index_linear(vmi, symbol, et, base_addr, pid);
-    }
-    return index;
-}
-
 status_t
 peparse_validate_pe_image(
     const uint8_t * const image,
@@ -462,14 +303,17 @@ done:
     return size;
 }
 
-status_t
-peparse_get_export_table(
+/* peparse_get_export_table, also returning SizeOfImage if size_of_image is
+ * not NULL */
+static status_t
+peparse_read_export_table(
     vmi_instance_t vmi,
     addr_t base_vaddr,
     uint32_t pid,
     struct export_table *et,
     addr_t *export_table_rva,
-    size_t *export_table_size)
+    size_t *export_table_size,
+    uint32_t *size_of_image)
 {
     // Note: this function assumes a "normal" PE where all the headers are in
     // the first page of the PE and the field DosHeader.OffsetToPE points to
@@ -488,9 +332,11 @@ peparse_get_export_table(
     }
 
     void *optional_header = NULL;
+    struct optional_header_pe32 *oh32 = NULL;
+    struct optional_header_pe32plus *oh32plus = NULL;
     uint16_t magic = 0;
 
-    peparse_assign_headers(image, NULL, NULL, &magic, &optional_header, NULL, NULL);
+    peparse_assign_headers(image, NULL, NULL, &magic, &optional_header, &oh32, &oh32plus);
     export_header_rva = peparse_get_idd_rva(IMAGE_DIRECTORY_ENTRY_EXPORT, &magic, optional_header, NULL, NULL);
     export_header_size = peparse_get_idd_size(IMAGE_DIRECTORY_ENTRY_EXPORT, &magic, optional_header, NULL, NULL);
 
@@ -502,6 +348,11 @@ peparse_get_export_table(
         *export_table_size=export_header_size;
     }
 
+    if(size_of_image) {
+        *size_of_image = oh32 ? oh32->size_of_image :
+            oh32plus ? oh32plus->size_of_image : 0;
+    }
+
     /* Find & read the export header; assume a different page than the headers */
     export_header_va = base_vaddr + export_header_rva;
 
@@ -525,111 +376,391 @@ peparse_get_export_table(
     return VMI_SUCCESS;
 }
 
-/* returns the rva value for a windows PE export */
 status_t
-windows_export_to_rva(
+peparse_get_export_table(
     vmi_instance_t vmi,
-    char *symbol,
     addr_t base_vaddr,
     uint32_t pid,
-    addr_t *rva)
+    struct export_table *et,
+    addr_t *export_table_rva,
+    size_t *export_table_size)
 {
-    struct export_table et;
-    addr_t et_rva;
+    return peparse_read_export_table(vmi, base_vaddr, pid, et,
+                                     export_table_rva, export_table_size,
+                                     NULL);
+}
+
+/*
+ * A module's export directory parsed once: the AddressOfFunctions array, a
+ * hash table from each exported name to its index in that array and the
+ * named exports sorted by RVA.  The export section is read in one go and
+ * the arrays and names are taken from it, falling back to separate reads
+ * for anything that lies outside it.
+ */
+#define PE_MAX_EXPORTS          (1 << 20)
+#define PE_MAX_EXPORT_SECTION   (16 << 20)
+
+struct pe_exports {
+    struct export_table et;     /* directory the rest was parsed from */
+    addr_t et_rva;              /* export section, from the data directory */
     size_t et_size;
-    int aon_index = -1;
-    int aof_index = -1;
+    uint32_t size_of_image;     /* SizeOfImage, bounds the rvas looked up */
+    uint64_t epoch;             /* epoch the directory was last checked in */
+    int cached;                 /* nonzero once owned by the export cache */
+    size_t bytes;
+    uint32_t *functions;        /* AddressOfFunctions */
+    char *names;                /* every exported name, NUL terminated */
+    GHashTable *by_name;        /* name --> AddressOfFunctions index */
+    struct pe_export *by_rva;   /* named, not forwarded, sorted by rva */
+    uint32_t count;             /* entries in by_rva */
+};
+
+struct pe_export {
+    uint32_t rva;
+    uint32_t name;              /* offset of the name in pe_exports.names */
+};
 
-    // get export table structure
-    if (peparse_get_export_table(vmi, base_vaddr, pid, &et, &et_rva, &et_size) != VMI_SUCCESS) {
-        dbprint("--PEParse: failed to get export table\n");
-        return VMI_FAILURE;
+static int
+pe_export_compare(
+    const void *a,
+    const void *b)
+{
+    const struct pe_export *ea = a;
+    const struct pe_export *eb = b;
+
+    if (ea->rva != eb->rva) {
+        return ea->rva < eb->rva ? -1 : 1;
     }
+    return ea->name < eb->name ? -1 : (ea->name > eb->name);
+}
 
-    // find AddressOfNames index for export symbol
-    if ((aon_index = get_aon_index(vmi, symbol, &et, base_vaddr, pid)) == -1) {
-        dbprint("--PEParse: failed to get aon index\n");
-        return VMI_FAILURE;
+void
+peparse_exports_free(
+    struct pe_exports *exports)
+{
+    if (exports->by_name) {
+        g_hash_table_destroy(exports->by_name);
     }
+    free(exports->by_rva);
+    free(exports->functions);
+    free(exports->names);
+    free(exports);
+}
 
-    // find AddressOfFunctions index for export symbol
-    if ((aof_index = get_aof_index(vmi, aon_index, &et, base_vaddr, pid)) == -1) {
-        dbprint("--PEParse: failed to get aof index\n");
-        return VMI_FAILURE;
+size_t
+peparse_exports_size(
+    struct pe_exports *exports)
+{
+    return exports->bytes;
+}
+
+/* copies len bytes at rva out of the export section when they lie inside
+ * it, otherwise reads them from the guest */
+static void *
+export_bytes(
+    vmi_instance_t vmi,
+    struct pe_exports *exports,
+    uint8_t *section,
+    size_t section_len,
+    addr_t rva,
+    size_t len,
+    addr_t base_vaddr,
+    uint32_t pid)
+{
+    void *buf = safe_malloc(len ? len : 1);
+
+    if (section && rva >= exports->et_rva && len <= section_len &&
+        rva - exports->et_rva <= section_len - len) {
+        memcpy(buf, section + (rva - exports->et_rva), len);
+    }
+    else if (len && vmi_read_va(vmi, base_vaddr + rva, pid, buf, len) != len) {
+        free(buf);
+        return NULL;
     }
+    return buf;
+}
 
-    // find RVA value for export symbol
-    if(VMI_SUCCESS==get_export_rva(vmi, rva, aof_index, &et, base_vaddr, pid)) {
+static struct pe_exports *
+peparse_parse_exports(
+    vmi_instance_t vmi,
+    addr_t base_vaddr,
+    uint32_t pid)
+{
+    struct pe_exports *exports = NULL;
+    uint8_t *section = NULL;
+    size_t section_len = 0;
+    uint32_t *name_rvas = NULL;
+    uint16_t *ordinals = NULL;
+    size_t *name_offsets = NULL;
+    size_t names_len = 0, names_size = 0;
+    uint32_t i = 0;
 
-        // handle forwarded functions
-        // If the function's RVA is inside the exports section (as given by the
-        // VirtualAddress and Size fields in the idd), the symbol is forwarded.
-        if(*rva>=et_rva && *rva < et_rva+et_size) {
-            dbprint("--PEParse: %s @ %u:0x%"PRIx64" is forwarded\n", symbol, pid, base_vaddr);
-            return VMI_FAILURE;
-        } else {
-            return VMI_SUCCESS;
+    exports = safe_malloc(sizeof(struct pe_exports));
+    memset(exports, 0, sizeof(struct pe_exports));
+    if (peparse_read_export_table(vmi, base_vaddr, pid, &exports->et,
+                                  &exports->et_rva, &exports->et_size,
+                                  &exports->size_of_image) != VMI_SUCCESS) {
+        dbprint("--PEParse: failed to get export table\n");
+        goto error_exit;
+    }
+    if (exports->et.number_of_functions > PE_MAX_EXPORTS ||
+        exports->et.number_of_names > PE_MAX_EXPORTS) {
+        dbprint("--PEParse: implausible export counts\n");
+        goto error_exit;
+    }
+
+    if (exports->et_size <= PE_MAX_EXPORT_SECTION) {
+        section = safe_malloc(exports->et_size ? exports->et_size : 1);
+        section_len = vmi_read_va(vmi, base_vaddr + exports->et_rva, pid,
+                                  section, exports->et_size);
+    }
+
+    exports->functions = export_bytes(vmi, exports, section, section_len,
+                                      exports->et.address_of_functions,
+                                      exports->et.number_of_functions * sizeof(uint32_t),
+                                      base_vaddr, pid);
+    name_rvas = export_bytes(vmi, exports, section, section_len,
+                             exports->et.address_of_names,
+                             exports->et.number_of_names * sizeof(uint32_t),
+                             base_vaddr, pid);
+    ordinals = export_bytes(vmi, exports, section, section_len,
+                            exports->et.address_of_name_ordinals,
+                            exports->et.number_of_names * sizeof(uint16_t),
+                            base_vaddr, pid);
+    if (!exports->functions || !name_rvas || !ordinals) {
+        dbprint("--PEParse: failed to read the export arrays\n");
+        goto error_exit;
+    }
+
+    name_offsets = safe_malloc((exports->et.number_of_names + 1) * sizeof(size_t));
+    for (i = 0; i < exports->et.number_of_names; ++i) {
+        char *name = NULL;
+        char *copy = NULL;
+        size_t len = 0;
+        addr_t rva = name_rvas[i];
+
+        name_offsets[i] = ~0UL;
+        if (!rva || ordinals[i] >= exports->et.number_of_functions) {
+            continue;
         }
-    } else {
-        return VMI_FAILURE;
+        if (rva >= exports->et_rva && rva - exports->et_rva < section_len &&
+            (len = strnlen((char *) section + (rva - exports->et_rva),
+                           section_len - (rva - exports->et_rva))) <
+            section_len - (rva - exports->et_rva)) {
+            name = (char *) section + (rva - exports->et_rva);
+        }
+        else if ((name = copy = rva_to_string(vmi, rva, base_vaddr, pid)) != NULL) {
+            len = strlen(name);
+        }
+        else {
+            continue;
+        }
+
+        if (names_len + len + 1 > names_size) {
+            names_size = names_size ? names_size * 2 : 16 * 1024;
+            while (names_len + len + 1 > names_size) {
+                names_size *= 2;
+            }
+            exports->names = realloc(exports->names, names_size);
+        }
+        memcpy(exports->names + names_len, name, len + 1);
+        name_offsets[i] = names_len;
+        names_len += len + 1;
+        free(copy);
+    }
+
+    /* keys point into names, so only index them once it stops moving;
+     * names come in AddressOfNames order, which breaks ties on an rva */
+    exports->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    exports->by_rva = safe_malloc((exports->et.number_of_names + 1) *
+                                  sizeof(struct pe_export));
+    for (i = 0; i < exports->et.number_of_names; ++i) {
+        uint32_t rva = 0;
+
+        if (name_offsets[i] == ~0UL) {
+            continue;
+        }
+        g_hash_table_insert(exports->by_name, exports->names + name_offsets[i],
+                            GUINT_TO_POINTER(ordinals[i]));
+
+        rva = exports->functions[ordinals[i]];
+        if (rva && !(rva >= exports->et_rva &&
+                     rva < exports->et_rva + exports->et_size)) {
+            exports->by_rva[exports->count].rva = rva;
+            exports->by_rva[exports->count].name = name_offsets[i];
+            exports->count++;
+        }
+    }
+    qsort(exports->by_rva, exports->count, sizeof(struct pe_export),
+          pe_export_compare);
+
+    exports->bytes = sizeof(struct pe_exports) + names_size +
+        exports->et.number_of_functions * sizeof(uint32_t) +
+        (exports->et.number_of_names + 1) * sizeof(struct pe_export) +
+        g_hash_table_size(exports->by_name) * 3 * sizeof(gpointer);
+    exports->epoch = cache_epoch(vmi);
+    dbprint("--PEParse: parsed %u exports of 0x%.16"PRIx64"\n",
+            g_hash_table_size(exports->by_name), base_vaddr);
+
+    free(name_offsets);
+    free(name_rvas);
+    free(ordinals);
+    free(section);
+    return exports;
+
+error_exit:
+    free(name_rvas);
+    free(ordinals);
+    free(section);
+    peparse_exports_free(exports);
+    return NULL;
+}
+
+/* the parsed export directory of the module at base_vaddr, to be handed
+ * back with peparse_put_exports */
+static struct pe_exports *
+peparse_get_exports(
+    vmi_instance_t vmi,
+    addr_t base_vaddr,
+    uint32_t pid)
+{
+    addr_t dtb = translate_dtb(vmi, pid);
+    struct pe_exports *exports = export_cache_get(vmi, base_vaddr, dtb);
+
+    /* a module unloaded or replaced since shows a different directory */
+    if (exports && exports->epoch != cache_epoch(vmi)) {
+        struct export_table et;
+
+        if (vmi_read_va(vmi, base_vaddr + exports->et_rva, pid, &et,
+                        sizeof(et)) == sizeof(et) &&
+            !memcmp(&et, &exports->et, sizeof(et))) {
+            exports->epoch = cache_epoch(vmi);
+        }
+        else {
+            export_cache_del(vmi, base_vaddr, dtb);
+            exports = NULL;
+        }
+    }
+
+    if (!exports &&
+        (exports = peparse_parse_exports(vmi, base_vaddr, pid)) != NULL &&
+        VMI_SUCCESS == export_cache_set(vmi, base_vaddr, dtb, exports)) {
+        exports->cached = 1;
     }
+    return exports;
 }
 
-/* returns a windows PE export from an RVA*/
+static void
+peparse_put_exports(
+    struct pe_exports *exports)
+{
+    if (!exports->cached) {
+        peparse_exports_free(exports);
+    }
+}
+
+/* returns the rva value for a windows PE export */
 status_t
-windows_rva_to_export(
+windows_export_to_rva(
     vmi_instance_t vmi,
-    addr_t rva,
+    char *symbol,
     addr_t base_vaddr,
     uint32_t pid,
-    char **sym)
+    addr_t *rva)
 {
-    struct export_table et;
-    addr_t et_rva;
-    size_t et_size;
-    int aon_index = -1;
-    int aof_index = -1;
+    struct pe_exports *exports = NULL;
+    gpointer index = NULL;
+    status_t ret = VMI_FAILURE;
 
-    // get export table structure
-    if (peparse_get_export_table(vmi, base_vaddr, pid, &et, &et_rva, &et_size) != VMI_SUCCESS) {
-        dbprint("--PEParse: failed to get export table\n");
+    if ((exports = peparse_get_exports(vmi, base_vaddr, pid)) == NULL) {
         return VMI_FAILURE;
     }
 
-    if(rva>=et_rva && rva < et_rva+et_size) {
-        dbprint("--PEParse: symbol @ %u:0x%"PRIx64" is forwarded\n", pid, base_vaddr+rva);
-        return VMI_FAILURE;
+    if (!g_hash_table_lookup_extended(exports->by_name, symbol, NULL, &index)) {
+        dbprint("--PEParse: %s is not exported\n", symbol);
+        goto done;
     }
 
+    *rva = exports->functions[GPOINTER_TO_UINT(index)];
 
-    addr_t base1 = base_vaddr + et.address_of_names;
-    addr_t base2 = base_vaddr + et.address_of_name_ordinals;
-    addr_t base3 = base_vaddr + et.address_of_functions;
-    uint32_t i = 0;
+    // handle forwarded functions
+    // If the function's RVA is inside the exports section (as given by the
+    // VirtualAddress and Size fields in the idd), the symbol is forwarded.
+    if (*rva >= exports->et_rva && *rva < exports->et_rva + exports->et_size) {
+        dbprint("--PEParse: %s @ %u:0x%"PRIx64" is forwarded\n", symbol, pid, base_vaddr);
+        goto done;
+    }
+    ret = VMI_SUCCESS;
 
-    for (; i < et.number_of_functions; ++i) {
-        uint32_t name_rva = 0;
-        uint16_t ordinal = 0;
-        uint32_t loc = 0;
+done:
+    peparse_put_exports(exports);
+    return ret;
+}
 
-        if(VMI_FAILURE==vmi_read_16_va(vmi, base2 + i * sizeof(uint16_t), pid, &ordinal))
-            continue;
-        if(VMI_FAILURE==vmi_read_32_va(vmi, base3 + ordinal + sizeof(uint32_t), pid, &loc))
-            continue;
+/* returns the closest named export at or below an RVA, as "name" or
+ * "name+0xoffset" */
+status_t
+windows_rva_to_export(
+    vmi_instance_t vmi,
+    addr_t rva,
+    addr_t base_vaddr,
+    uint32_t pid,
+    char **sym)
+{
+    struct pe_exports *exports = NULL;
+    struct pe_export *match = NULL;
+    char *name = NULL;
+    size_t low = 0, high = 0, length = 0;
+    status_t ret = VMI_FAILURE;
 
-        if(loc==rva) {
+    if ((exports = peparse_get_exports(vmi, base_vaddr, pid)) == NULL) {
+        return VMI_FAILURE;
+    }
 
-            if(i < et.number_of_names && VMI_SUCCESS==vmi_read_32_va(vmi, base1 + i * sizeof(uint32_t), pid, &name_rva) && name_rva) {
-                if(NULL != (*sym = rva_to_string(vmi, (addr_t) name_rva, base_vaddr, pid)))
-                    return VMI_SUCCESS;
-            }
+    if (rva >= exports->et_rva && rva < exports->et_rva + exports->et_size) {
+        dbprint("--PEParse: symbol @ %u:0x%"PRIx64" is forwarded\n", pid, base_vaddr+rva);
+        goto done;
+    }
+    if (rva >= exports->size_of_image) {
+        dbprint("--PEParse: 0x%"PRIx64" is outside the image @ %u:0x%"PRIx64"\n",
+                rva, pid, base_vaddr);
+        goto done;
+    }
+
+    /* find the first export above the rva */
+    high = exports->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
 
-            dbprint("--PEParse: symbol @ %u:0x%"PRIx64" is exported by ordinal only\n", pid, base_vaddr+rva);
-            break;
+        if (exports->by_rva[mid].rva <= rva) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
         }
     }
+    if (low == 0) {
+        dbprint("--PEParse: no export @ or below %u:0x%"PRIx64"\n", pid, base_vaddr+rva);
+        goto done;
+    }
 
-    return VMI_FAILURE;
-}
+    match = &exports->by_rva[low - 1];
+    while (match > exports->by_rva && (match - 1)->rva == match->rva) {
+        --match;
+    }
 
+    name = exports->names + match->name;
+    length = strlen(name) + sizeof("+0x") + 16;
+    *sym = safe_malloc(length);
+    if (rva == match->rva) {
+        snprintf(*sym, length, "%s", name);
+    }
+    else {
+        snprintf(*sym, length, "%s+0x%"PRIx64, name, rva - match->rva);
+    }
+    ret = VMI_SUCCESS;
 
+done:
+    peparse_put_exports(exports);
+    return ret;
+}
@@ -162,13 +162,19 @@ find_pname_offset(
     }
 
     for (block_pa = 4096; block_pa < vmi->size; block_pa += BLOCK_SIZE) {
-        read = vmi_read_pa(vmi, block_pa, block_buffer, BLOCK_SIZE);
-        if (BLOCK_SIZE != read) {
-            continue;
+        /* scan the block in place if the driver can map it */
+        const unsigned char *block = vmi_map_pa(vmi, block_pa, BLOCK_SIZE);
+
+        if (NULL == block) {
+            read = vmi_read_pa(vmi, block_pa, block_buffer, BLOCK_SIZE);
+            if (BLOCK_SIZE != read) {
+                continue;
+            }
+            block = block_buffer;
         }
 
         for (offset = 0; offset < BLOCK_SIZE; offset += 8) {
-            memcpy(&value, block_buffer + offset, 4);
+            memcpy(&value, block + offset, 4);
 
             if (check(value)) { // look for specific magic #
                 dbprint
@@ -195,11 +201,17 @@ find_pname_offset(
                     dbprint
                         ("--%s: found Idle process at 0x%.8"PRIx64" + 0x%x\n",
                          __FUNCTION__, block_pa + offset, i);
+                    if (block != block_buffer) {
+                        vmi_unmap(vmi, block);
+                    }
                     boyer_moore_fini(bm);
                     return i;
                 }
             }
         }
+        if (block != block_buffer) {
+            vmi_unmap(vmi, block);
+        }
     }
     boyer_moore_fini(bm);
     return 0;
@@ -0,0 +1,362 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Persistent profile cache.  With profile_cache set in the configuration,
+ * what Windows initialization discovers by scanning memory (the KdVersionBlock, the
+ * System process, the kernel base and page mode, and the EPROCESS offsets)
+ * is saved to that directory, one file per kernel build.  A later init
+ * picks the file whose kernel is still at the saved physical address,
+ * which costs one read per file, and starts from its values.
+ */
+
+#include "libvmi.h"
+#include "private.h"
+#include "peparse.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#define PROFILE_PREFIX "windows-"
+#define PROFILE_SUFFIX ".profile"
+#define MAX_HEADER_BYTES 1024
+
+struct windows_profile {
+    uint64_t fingerprint;
+    uint64_t page_mode;
+    uint64_t ntoskrnl;
+    uint64_t ntoskrnl_va;
+    uint64_t kdvb;
+    uint64_t sysproc;
+    uint64_t tasks;
+    uint64_t pdbase;
+    uint64_t pid;
+    uint64_t pname;
+};
+
+/* the fields of a profile file, in the order they are written */
+static const struct {
+    const char *key;
+    size_t offset;
+} profile_fields[] = {
+    { "fingerprint", offsetof(struct windows_profile, fingerprint) },
+    { "page_mode", offsetof(struct windows_profile, page_mode) },
+    { "ntoskrnl", offsetof(struct windows_profile, ntoskrnl) },
+    { "ntoskrnl_va", offsetof(struct windows_profile, ntoskrnl_va) },
+    { "win_kdvb", offsetof(struct windows_profile, kdvb) },
+    { "win_sysproc", offsetof(struct windows_profile, sysproc) },
+    { "win_tasks", offsetof(struct windows_profile, tasks) },
+    { "win_pdbase", offsetof(struct windows_profile, pdbase) },
+    { "win_pid", offsetof(struct windows_profile, pid) },
+    { "win_pname", offsetof(struct windows_profile, pname) },
+};
+
+#define PROFILE_FIELDS (sizeof(profile_fields) / sizeof(profile_fields[0]))
+
+static inline uint64_t
+fnv1a(
+    uint64_t hash,
+    const void *data,
+    size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* identifies a kernel build by fields of its PE headers that stay the
+ * same when the image is loaded at a different address */
+static status_t
+kernel_fingerprint(
+    vmi_instance_t vmi,
+    addr_t ntoskrnl,
+    uint64_t *fingerprint)
+{
+    uint8_t image[MAX_HEADER_BYTES];
+    struct pe_header *pe_header = NULL;
+    struct optional_header_pe32 *oh_pe32 = NULL;
+    struct optional_header_pe32plus *oh_pe32plus = NULL;
+    uint16_t magic = 0;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    if (!ntoskrnl ||
+        vmi_read_pa(vmi, ntoskrnl, image, MAX_HEADER_BYTES) != MAX_HEADER_BYTES ||
+        VMI_FAILURE == peparse_validate_pe_image(image, MAX_HEADER_BYTES)) {
+        return VMI_FAILURE;
+    }
+
+    peparse_assign_headers(image, NULL, &pe_header, &magic, NULL,
+                           &oh_pe32, &oh_pe32plus);
+    hash = fnv1a(hash, &pe_header->machine, sizeof(pe_header->machine));
+    hash = fnv1a(hash, &pe_header->time_date_stamp,
+                 sizeof(pe_header->time_date_stamp));
+    if (oh_pe32) {
+        hash = fnv1a(hash, &oh_pe32->size_of_image, sizeof(uint32_t));
+        hash = fnv1a(hash, &oh_pe32->checksum, sizeof(uint32_t));
+    }
+    else if (oh_pe32plus) {
+        hash = fnv1a(hash, &oh_pe32plus->size_of_image, sizeof(uint32_t));
+        hash = fnv1a(hash, &oh_pe32plus->checksum, sizeof(uint32_t));
+    }
+    else {
+        return VMI_FAILURE;
+    }
+
+    *fingerprint = hash;
+    return VMI_SUCCESS;
+}
+
+static status_t
+profile_read(
+    const char *path,
+    struct windows_profile *profile)
+{
+    FILE *f = NULL;
+    char key[64];
+    uint64_t value = 0;
+    size_t i = 0;
+
+    if ((f = fopen(path, "r")) == NULL) {
+        return VMI_FAILURE;
+    }
+
+    memset(profile, 0, sizeof(struct windows_profile));
+    while (fscanf(f, " %63[a-z_] = %"SCNx64" ;", key, &value) == 2) {
+        for (i = 0; i < PROFILE_FIELDS; ++i) {
+            if (strcmp(key, profile_fields[i].key) == 0) {
+                *(uint64_t *) ((char *) profile + profile_fields[i].offset) = value;
+            }
+        }
+    }
+    fclose(f);
+
+    return profile->fingerprint ? VMI_SUCCESS : VMI_FAILURE;
+}
+
+/* a profile matching the kernel image may still be stale: the System
+ * process must carry its name and its page directory must map the
+ * kernel where the profile says it is */
+static status_t
+profile_verify(
+    vmi_instance_t vmi,
+    struct windows_profile *profile)
+{
+    char name[16];
+    addr_t kpgd = 0;
+
+    if (!profile->sysproc || !profile->pname || !profile->ntoskrnl_va) {
+        return VMI_FAILURE;
+    }
+    if (vmi_read_pa(vmi, profile->sysproc + profile->pname, name,
+                    sizeof(name)) != sizeof(name) ||
+        strncmp(name, "System", sizeof(name))) {
+        return VMI_FAILURE;
+    }
+    if (VMI_FAILURE ==
+        vmi_read_addr_pa(vmi, profile->sysproc + profile->pdbase, &kpgd) ||
+        !kpgd) {
+        return VMI_FAILURE;
+    }
+    if (vmi_pagetable_lookup(vmi, kpgd, profile->ntoskrnl_va) !=
+        profile->ntoskrnl) {
+        return VMI_FAILURE;
+    }
+    return VMI_SUCCESS;
+}
+
+static char *
+profile_format(
+    struct windows_profile *profile)
+{
+    char *text = safe_malloc(PROFILE_FIELDS * 48);
+    size_t len = 0;
+    size_t i = 0;
+
+    for (i = 0; i < PROFILE_FIELDS; ++i) {
+        len += sprintf(text + len, "%s = 0x%"PRIx64";\n", profile_fields[i].key,
+                       *(uint64_t *) ((char *) profile + profile_fields[i].offset));
+    }
+    return text;
+}
+
+void
+windows_profile_load(
+    vmi_instance_t vmi)
+{
+    struct windows_instance *windows = &vmi->os.windows_instance;
+    struct windows_profile profile;
+    struct dirent *de = NULL;
+    DIR *dir = NULL;
+    char *path = NULL;
+    uint64_t fingerprint = 0;
+    page_mode_t page_mode = vmi->page_mode;
+    int found = 0;
+
+    if ((dir = opendir(vmi->profile_cache)) == NULL) {
+        dbprint("--profile cache %s not readable\n", vmi->profile_cache);
+        return;
+    }
+
+    while (!found && (de = readdir(dir)) != NULL) {
+        size_t len = strlen(de->d_name);
+
+        if (strncmp(de->d_name, PROFILE_PREFIX, strlen(PROFILE_PREFIX)) ||
+            len <= strlen(PROFILE_SUFFIX) ||
+            strcmp(de->d_name + len - strlen(PROFILE_SUFFIX), PROFILE_SUFFIX)) {
+            continue;
+        }
+
+        path = g_strdup_printf("%s/%s", vmi->profile_cache, de->d_name);
+        found = VMI_SUCCESS == profile_read(path, &profile) &&
+            VMI_SUCCESS == kernel_fingerprint(vmi, profile.ntoskrnl, &fingerprint) &&
+            fingerprint == profile.fingerprint;
+        if (found) {
+            dbprint("--using profile %s\n", path);
+        }
+        g_free(path);
+    }
+    closedir(dir);
+
+    if (!found) {
+        return;
+    }
+
+    /* the configuration still has the last word */
+    if (VMI_PM_UNKNOWN == vmi->page_mode) {
+        vmi->page_mode = (page_mode_t) profile.page_mode;
+        v2p_select(vmi);
+    }
+    if (VMI_FAILURE == profile_verify(vmi, &profile)) {
+        dbprint("--profile does not match the running kernel, ignored\n");
+        vmi->page_mode = page_mode;
+        v2p_select(vmi);
+        v2p_cache_flush(vmi);
+        return;
+    }
+    if (!windows->ntoskrnl) {
+        windows->ntoskrnl = profile.ntoskrnl;
+    }
+    if (!windows->ntoskrnl_va) {
+        windows->ntoskrnl_va = profile.ntoskrnl_va;
+    }
+    if (!windows->kdversion_block) {
+        windows->kdversion_block = profile.kdvb;
+    }
+    if (!windows->sysproc) {
+        windows->sysproc = profile.sysproc;
+    }
+    if (!windows->tasks_offset) {
+        windows->tasks_offset = profile.tasks;
+    }
+    if (!windows->pdbase_offset) {
+        windows->pdbase_offset = profile.pdbase;
+    }
+    if (!windows->pid_offset) {
+        windows->pid_offset = profile.pid;
+    }
+    if (!windows->pname_offset) {
+        windows->pname_offset = profile.pname;
+    }
+}
+
+void
+windows_profile_save(
+    vmi_instance_t vmi)
+{
+    struct windows_instance *windows = &vmi->os.windows_instance;
+    struct windows_profile profile;
+    struct windows_profile saved;
+    char *path = NULL;
+    char *tmp = NULL;
+    char *text = NULL;
+    FILE *f = NULL;
+    int fd = -1;
+    int written = 0;
+
+    memset(&profile, 0, sizeof(profile));
+    if (VMI_FAILURE ==
+        kernel_fingerprint(vmi, windows->ntoskrnl, &profile.fingerprint)) {
+        dbprint("--no kernel image to fingerprint, profile not saved\n");
+        return;
+    }
+    profile.page_mode = vmi->page_mode;
+    profile.ntoskrnl = windows->ntoskrnl;
+    profile.ntoskrnl_va = windows->ntoskrnl_va;
+    profile.kdvb = windows->kdversion_block;
+    profile.sysproc = windows->sysproc;
+    profile.tasks = windows->tasks_offset;
+    profile.pdbase = windows->pdbase_offset;
+    profile.pid = windows->pid_offset;
+    /* without it a later init could not check the profile */
+    profile.pname = vmi_get_offset(vmi, "win_pname");
+    if (!profile.sysproc || !profile.pname) {
+        dbprint("--System process not known, profile not saved\n");
+        return;
+    }
+
+    path = g_strdup_printf("%s/" PROFILE_PREFIX "%016"PRIx64 PROFILE_SUFFIX,
+                           vmi->profile_cache, profile.fingerprint);
+    if (VMI_SUCCESS == profile_read(path, &saved) &&
+        !memcmp(&saved, &profile, sizeof(profile))) {
+        goto done;
+    }
+
+    /* write a new file and rename it over the old, so that a concurrent
+     * init never sees half a profile; mkstemp never opens an existing
+     * file or follows a link planted under the name */
+    text = profile_format(&profile);
+    tmp = g_strdup_printf("%s/." PROFILE_PREFIX "XXXXXX", vmi->profile_cache);
+    if ((fd = mkstemp(tmp)) < 0) {
+        errprint("Failed to create a profile in %s.\n", vmi->profile_cache);
+        goto done;
+    }
+    if ((f = fdopen(fd, "w")) != NULL) {
+        written = fputs(text, f) != EOF;
+        written = fclose(f) == 0 && written;
+    }
+    else {
+        close(fd);
+    }
+    if (!written || rename(tmp, path) != 0) {
+        errprint("Failed to save profile %s.\n", path);
+        unlink(tmp);
+    }
+    else {
+        dbprint("--saved profile %s\n", path);
+    }
+
+done:
+    free(text);
+    g_free(tmp);
+    g_free(path);
+}
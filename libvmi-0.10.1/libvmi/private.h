@@ -63,6 +63,8 @@ struct vmi_instance {
 
     char *sysmap;           /**< system map file for domain's running kernel */
 
+    char *profile_cache;    /**< directory of saved startup discoveries, or NULL */
+
     char *image_type;       /**< image type that we are accessing */
 
     char *image_type_complete;  /**< full path for file images */
@@ -89,6 +91,8 @@ struct vmi_instance {
 
     page_mode_t page_mode;  /**< paging mode in use */
 
+    addr_t (*v2p) (vmi_instance_t, addr_t, addr_t, uint32_t *); /**< page table walker for page_mode, see v2p_select() */
+
     uint64_t size;          /**< total size of target's memory */
 
     int hvm;                /**< nonzero if HVM */
@@ -105,6 +109,8 @@ struct vmi_instance {
             int pgd_offset;      /**< mm_struct->pgd */
 
             int name_offset;     /**< task_struct->comm */
+
+            struct linux_symbol_table *symbol_table; /**< parsed System.map, shared */
         } linux_instance;
         struct windows_instance {
 
@@ -134,19 +140,79 @@ struct vmi_instance {
 
     GHashTable *rva_cache;  /**< hash table to hold the rva cache data */
 
-    GHashTable *v2p_cache;  /**< hash table to hold the v2p cache data */
+    GHashTable *export_cache; /**< parsed PE export directories by base and dtb */
+
+    struct v2p_cache *v2p_cache; /**< table to hold the v2p cache data */
+
+    GHashTable *v2p_table_frames; /**< page-table frames read by cached walks */
+
+    uint64_t v2p_table_epoch; /**< epoch of the frames in v2p_table_frames */
+
+    uint32_t v2p_page_shifts; /**< bit n set if the v2p cache holds 2^n pages */
+
+    int v2p_paranoid;       /**< nonzero to check each v2p hit with a read */
+
+    struct pt_cache_entry *pt_cache; /**< upper-level paging entries by dtb and region */
+
+    GHashTable *v2p_misses; /**< pages found unmapped, by dtb and page */
+
+    GHashTable *p2v_frames; /**< translations by physical page, NULL if disabled */
+
+    GHashTable *p2v_spaces; /**< physical pages with translations, by dtb */
+
+    uint64_t p2v_entries;   /**< number of translations in p2v_frames */
+
+    uint32_t p2v_page_shifts; /**< bit n set if p2v_frames holds 2^n pages */
 
     void *driver;           /**< driver-specific information */
 
+    struct driver_instance *driver_table; /**< driver function pointers */
+
     GHashTable *memory_cache;  /**< hash table for memory cache */
 
-    GList *memory_cache_lru;  /**< list holding the most recently used pages */
+    GHashTable *page_maps;  /**< pointers handed out by vmi_map_pa */
+
+    struct memory_cache_entry *memory_cache_lru_head; /**< most recently used page */
+
+    struct memory_cache_entry *memory_cache_lru_tail; /**< least recently used page */
 
     uint32_t memory_cache_age; /**< max age of memory cache entry */
 
-    uint32_t memory_cache_size;/**< current size of memory cache */
+    uint32_t memory_cache_size;/**< current number of pages in memory cache */
+
+    uint64_t memory_cache_bytes;/**< current size of memory cache in bytes */
+
+    uint64_t memory_cache_bytes_max;/**< max size of memory cache in bytes */
+
+    page_cache_policy_t memory_cache_policy;/**< eviction policy of memory cache */
+
+    void *(*memory_cache_get_data) (vmi_instance_t, addr_t, uint32_t); /**< driver callback to fetch a page */
+
+    void (*memory_cache_release_data) (void *, size_t); /**< driver callback to release a page */
+
+    uint32_t (*memory_cache_get_data_batch) (vmi_instance_t, addr_t, uint32_t, void **); /**< driver callback to fetch consecutive pages, may be NULL */
+
+    uint32_t memory_cache_prefetch_window; /**< pages fetched per read-ahead */
+
+    addr_t memory_cache_last_paddr; /**< last page requested from memory cache */
+
+    uint32_t memory_cache_run; /**< consecutive pages requested so far */
+
+    uint64_t memory_cache_prefetched; /**< pages brought in by read-ahead */
 
-    uint32_t memory_cache_size_max;/**< max size of memory cache */
+    uint64_t memory_cache_prefetch_used; /**< read-ahead pages later requested */
+
+    uint64_t memory_cache_prefetch_wasted; /**< read-ahead pages evicted unused */
+
+    cache_stats_t cache_stats[VMI_CACHE_COUNT]; /**< counters for each cache */
+
+    uint64_t epoch;         /**< cache generation, see cache_epoch() */
+
+    int epoch_clock;        /**< nonzero if the epoch also advances every second */
+
+    time_t epoch_clock_sec; /**< clock second the epoch was last advanced for */
+
+    time_t recheck_age;     /**< seconds unmapped pages and pids are trusted, 0 for no limit */
 
     unsigned int num_vcpus; /**< number of VCPUs used by this instance */
 
@@ -223,6 +289,11 @@ typedef struct _windows_unicode_string32 {
 /*-------------------------------------
  * cache.c
  */
+    uint64_t cache_epoch(
+    vmi_instance_t vmi);
+    void cache_epoch_advance(
+    vmi_instance_t vmi);
+
     void pid_cache_init(
     vmi_instance_t vmi);
     void pid_cache_destroy(
@@ -238,6 +309,9 @@ typedef struct _windows_unicode_string32 {
     status_t pid_cache_del(
     vmi_instance_t vmi,
     int pid);
+    int pid_cache_stale(
+    vmi_instance_t vmi,
+    int pid);
     void pid_cache_flush(
     vmi_instance_t vmi);
 
@@ -265,10 +339,59 @@ typedef struct _windows_unicode_string32 {
     void sym_cache_flush(
     vmi_instance_t vmi);
 
+    void rva_cache_init(
+    vmi_instance_t vmi);
+    void rva_cache_destroy(
+    vmi_instance_t vmi);
+    status_t rva_cache_get(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    addr_t rva,
+    char **sym);
+    char *rva_cache_set(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    addr_t rva,
+    char *sym);
+    status_t rva_cache_del(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    uint32_t pid,
+    addr_t rva);
+    void rva_cache_flush(
+    vmi_instance_t vmi);
+
+    struct pe_exports;
+    void export_cache_init(
+    vmi_instance_t vmi);
+    void export_cache_destroy(
+    vmi_instance_t vmi);
+    struct pe_exports *export_cache_get(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb);
+    status_t export_cache_set(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb,
+    struct pe_exports *exports);
+    void export_cache_del(
+    vmi_instance_t vmi,
+    addr_t base_addr,
+    addr_t dtb);
+    void export_cache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb);
+
     void v2p_cache_init(
     vmi_instance_t vmi);
     void v2p_cache_destroy(
     vmi_instance_t vmi);
+    status_t v2p_cache_set_capacity(
+    vmi_instance_t vmi,
+    uint32_t entries);
     status_t v2p_cache_get(
     vmi_instance_t vmi,
     addr_t va,
@@ -278,13 +401,70 @@ typedef struct _windows_unicode_string32 {
     vmi_instance_t vmi,
     addr_t va,
     addr_t dtb,
-    addr_t pa);
+    addr_t pa,
+    uint32_t page_shift);
     status_t v2p_cache_del(
     vmi_instance_t vmi,
     addr_t va,
     addr_t dtb);
     void v2p_cache_flush(
     vmi_instance_t vmi);
+    void v2p_cache_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb);
+    void v2p_cache_note_table(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    addr_t dtb);
+    void v2p_cache_invalidate_tables(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    size_t length);
+    status_t v2p_miss_get(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb);
+    void v2p_miss_set(
+    vmi_instance_t vmi,
+    addr_t va,
+    addr_t dtb);
+    void p2v_index_set(
+    vmi_instance_t vmi,
+    int enable);
+    void p2v_index_add(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    addr_t pa,
+    uint32_t page_shift);
+    void p2v_index_flush_dtb(
+    vmi_instance_t vmi,
+    addr_t dtb);
+    size_t p2v_index_lookup(
+    vmi_instance_t vmi,
+    addr_t pa,
+    vmi_p2v_t **mappings);
+
+/* va bits below the region mapped by each upper-level paging entry, which
+ * are also the page shifts of the large pages those entries can map */
+#define PT_SHIFT_PML4E       39
+#define PT_SHIFT_PDPTE       30
+#define PT_SHIFT_PDE         21
+#define PT_SHIFT_PDE_NOPAE   22
+
+    status_t pt_cache_get(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    int shift,
+    int levels,
+    uint64_t *value);
+    void pt_cache_set(
+    vmi_instance_t vmi,
+    addr_t dtb,
+    addr_t va,
+    int shift,
+    uint64_t value);
 
 /*-----------------------------------------
  * core.c
@@ -304,16 +484,35 @@ typedef struct _windows_unicode_string32 {
     void *vmi_read_page(
     vmi_instance_t vmi,
     addr_t frame_num);
+    void page_maps_destroy(
+    vmi_instance_t vmi);
+    addr_t translate_dtb(
+    vmi_instance_t vmi,
+    int pid);
+    void v2p_select(
+    vmi_instance_t vmi);
+
+/* buffers spanning at least this many pages are read and written through
+ * vmi_translate_range instead of translating every page */
+#define TRANSLATE_RANGE_PAGES 4
 
 /*-----------------------------------------
  * os/linux/...
  */
     status_t linux_init(
     vmi_instance_t instance);
+    void linux_destroy(
+    vmi_instance_t instance);
     status_t linux_system_map_symbol_to_address(
     vmi_instance_t instance,
     char *symbol,
     addr_t *address);
+    status_t linux_system_map_address_to_symbol(
+    vmi_instance_t instance,
+    addr_t address,
+    char **symbol);
+    void linux_system_map_release(
+    vmi_instance_t instance);
     addr_t linux_pid_to_pgd(
     vmi_instance_t vmi,
     int pid);
@@ -339,6 +538,16 @@ typedef struct _windows_unicode_string32 {
     addr_t,
     uint32_t,
     addr_t *);
+    status_t windows_rva_to_export(
+    vmi_instance_t vmi,
+    addr_t rva,
+    addr_t base_vaddr,
+    uint32_t pid,
+    char **sym);
+    void peparse_exports_free(
+    struct pe_exports *exports);
+    size_t peparse_exports_size(
+    struct pe_exports *exports);
     status_t windows_kpcr_lookup(
     vmi_instance_t vmi,
     char *symbol,
@@ -368,6 +577,10 @@ typedef struct _windows_unicode_string32 {
 
     addr_t windows_find_eprocess_list_pid(vmi_instance_t vmi, int pid);
     addr_t windows_find_eprocess_list_pgd(vmi_instance_t vmi, addr_t pgd);
+    void windows_profile_load(
+    vmi_instance_t vmi);
+    void windows_profile_save(
+    vmi_instance_t vmi);
 
 /*-----------------------------------------
  * strmatch.c
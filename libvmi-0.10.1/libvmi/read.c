@@ -86,6 +86,175 @@ vmi_read_pa(
     return buf_offset;
 }
 
+/* the part of one batch request that falls into a single page */
+struct batch_segment {
+    addr_t page;
+    uint32_t offset;
+    uint32_t length;
+    size_t iov;
+    size_t buf_offset;
+};
+
+static int
+batch_segment_compare(
+    const void *a,
+    const void *b)
+{
+    const struct batch_segment *x = a;
+    const struct batch_segment *y = b;
+
+    if (x->page != y->page) {
+        return x->page < y->page ? -1 : 1;
+    }
+    if (x->iov != y->iov) {
+        return x->iov < y->iov ? -1 : 1;
+    }
+    return x->buf_offset < y->buf_offset ? -1 :
+        x->buf_offset > y->buf_offset;
+}
+
+size_t
+vmi_read_pa_batch(
+    vmi_instance_t vmi,
+    const vmi_iov_t *iov,
+    size_t n,
+    status_t *status)
+{
+    struct batch_segment *segments = NULL;
+    addr_t *pages = NULL;
+    void **data = NULL;
+    uint8_t *failed = NULL;
+    size_t nsegments = 0;
+    size_t npages = 0;
+    size_t done = 0;
+    size_t ok = 0;
+    size_t i = 0;
+    size_t s = 0;
+
+    if (NULL == iov || !n) {
+        return 0;
+    }
+
+    /* frame 0 is refused here as it is by vmi_read_pa */
+    failed = safe_malloc(n);
+    for (i = 0; i < n; ++i) {
+        failed[i] = (NULL == iov[i].buf) || !(iov[i].paddr >> vmi->page_shift);
+        if (!failed[i] && iov[i].count) {
+            nsegments += ((iov[i].paddr + iov[i].count - 1) >> vmi->page_shift)
+                - (iov[i].paddr >> vmi->page_shift) + 1;
+        }
+    }
+
+    /* split every request at page boundaries */
+    segments = safe_malloc(nsegments * sizeof(struct batch_segment) + 1);
+    for (i = 0, s = 0; i < n; ++i) {
+        size_t buf_offset = 0;
+
+        while (!failed[i] && buf_offset < iov[i].count) {
+            addr_t paddr = iov[i].paddr + buf_offset;
+            uint32_t offset = (vmi->page_size - 1) & paddr;
+            size_t length = iov[i].count - buf_offset;
+
+            if (offset + length > vmi->page_size) {
+                length = vmi->page_size - offset;
+            }
+            segments[s].page = paddr - offset;
+            segments[s].offset = offset;
+            segments[s].length = length;
+            segments[s].iov = i;
+            segments[s].buf_offset = buf_offset;
+            buf_offset += length;
+            ++s;
+        }
+    }
+    qsort(segments, nsegments, sizeof(struct batch_segment),
+          batch_segment_compare);
+
+    /* every page only once */
+    pages = safe_malloc(nsegments * sizeof(addr_t) + 1);
+    data = safe_malloc(nsegments * sizeof(void *) + 1);
+    for (s = 0; s < nsegments; ++s) {
+        if (!npages || pages[npages - 1] != segments[s].page) {
+            pages[npages++] = segments[s].page;
+        }
+    }
+
+    /* the page data is only valid until the next driver read, so copy
+     * out each batch before asking for the next one */
+    s = 0;
+    while (done < npages) {
+        size_t got = driver_read_pages(vmi, pages + done, npages - done,
+                                       data + done);
+
+        if (!got) {
+            break;
+        }
+        for (i = done; i < done + got; ++i) {
+            for (; s < nsegments && segments[s].page == pages[i]; ++s) {
+                if (NULL == data[i]) {
+                    failed[segments[s].iov] = 1;
+                    continue;
+                }
+                memcpy((char *) iov[segments[s].iov].buf +
+                       segments[s].buf_offset,
+                       (char *) data[i] + segments[s].offset,
+                       segments[s].length);
+            }
+        }
+        done += got;
+    }
+    for (; s < nsegments; ++s) {
+        failed[segments[s].iov] = 1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (status) {
+            status[i] = failed[i] ? VMI_FAILURE : VMI_SUCCESS;
+        }
+        ok += !failed[i];
+    }
+
+    free(segments);
+    free(pages);
+    free(data);
+    free(failed);
+    return ok;
+}
+
+/* read a large buffer one physically contiguous run at a time */
+static size_t
+read_va_range(
+    vmi_instance_t vmi,
+    addr_t vaddr,
+    int pid,
+    void *buf,
+    size_t count)
+{
+    vmi_extent_t *extents = NULL;
+    addr_t dtb = translate_dtb(vmi, pid);
+    size_t buf_offset = 0;
+    size_t n = 0;
+    size_t i = 0;
+
+    if (!dtb) {
+        return 0;
+    }
+
+    n = vmi_translate_range(vmi, dtb, vaddr, count, &extents);
+    for (i = 0; i < n; ++i) {
+        size_t read = vmi_read_pa(vmi, extents[i].paddr,
+                                  (char *) buf + buf_offset,
+                                  extents[i].length);
+
+        buf_offset += read;
+        if (read != extents[i].length) {
+            break;
+        }
+    }
+    free(extents);
+    return buf_offset;
+}
+
 size_t
 vmi_read_va(
     vmi_instance_t vmi,
@@ -106,6 +275,12 @@ vmi_read_va(
         return 0;
     }
 
+    /* whatever the range walk does not cover is read page by page */
+    if (count >= TRANSLATE_RANGE_PAGES * vmi->page_size) {
+        buf_offset = read_va_range(vmi, vaddr, pid, buf, count);
+        count -= buf_offset;
+    }
+
     while (count > 0) {
         size_t read_len = 0;
 
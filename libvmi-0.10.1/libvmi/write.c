@@ -27,10 +27,29 @@
 #include "libvmi.h"
 #include "private.h"
 #include "driver/interface.h"
+#include "driver/memory_cache.h"
 
 ///////////////////////////////////////////////////////////
 // Classic write functions for access to memory
 
+/* write through to the driver and drop whatever the caches derived from
+ * the old contents */
+static status_t
+write_through(
+    vmi_instance_t vmi,
+    addr_t paddr,
+    void *buf,
+    size_t count)
+{
+    if (VMI_FAILURE == driver_write(vmi, paddr, buf, count)) {
+        return VMI_FAILURE;
+    }
+
+    memory_cache_invalidate(vmi, paddr, count);
+    v2p_cache_invalidate_tables(vmi, paddr, count);
+    return VMI_SUCCESS;
+}
+
 size_t
 vmi_write_pa(
     vmi_instance_t vmi,
@@ -43,7 +62,7 @@ vmi_write_pa(
                 __FUNCTION__);
         return 0;
     }
-    if (VMI_SUCCESS == driver_write(vmi, paddr, buf, count)) {
+    if (VMI_SUCCESS == write_through(vmi, paddr, buf, count)) {
         return count;
     }
     else {
@@ -51,6 +70,50 @@ vmi_write_pa(
     }
 }
 
+/* write a large buffer one physically contiguous run at a time */
+static size_t
+write_va_range(
+    vmi_instance_t vmi,
+    addr_t vaddr,
+    int pid,
+    void *buf,
+    size_t count)
+{
+    vmi_extent_t *extents = NULL;
+    addr_t dtb = translate_dtb(vmi, pid);
+    size_t buf_offset = 0;
+    size_t n = 0;
+    size_t i = 0;
+
+    if (!dtb) {
+        return 0;
+    }
+
+    n = vmi_translate_range(vmi, dtb, vaddr, count, &extents);
+    for (i = 0; i < n; ++i) {
+        size_t done = 0;
+
+        /* drivers take 32-bit lengths */
+        while (done < extents[i].length) {
+            size_t write_len = extents[i].length - done;
+
+            if (write_len > 0x40000000) {
+                write_len = 0x40000000;
+            }
+            if (VMI_FAILURE ==
+                write_through(vmi, extents[i].paddr + done,
+                              (char *) buf + buf_offset, write_len)) {
+                goto _exit;
+            }
+            done += write_len;
+            buf_offset += write_len;
+        }
+    }
+_exit:
+    free(extents);
+    return buf_offset;
+}
+
 size_t
 vmi_write_va(
     vmi_instance_t vmi,
@@ -70,6 +133,12 @@ vmi_write_va(
         return 0;
     }
 
+    /* whatever the range walk does not cover is written page by page */
+    if (count >= TRANSLATE_RANGE_PAGES * vmi->page_size) {
+        buf_offset = write_va_range(vmi, vaddr, pid, buf, count);
+        count -= buf_offset;
+    }
+
     while (count > 0) {
         size_t write_len = 0;
 
@@ -95,7 +164,7 @@ vmi_write_va(
 
         /* do the write */
         if (VMI_FAILURE ==
-            driver_write(vmi, paddr,
+            write_through(vmi, paddr,
                          ((char *) buf + (addr_t) buf_offset),
                          write_len)) {
             return buf_offset;
@@ -0,0 +1,185 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2012 VMITools Project
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <check.h>
+#include "../libvmi/libvmi.h"
+#include "../libvmi/peparse.h"
+#include "check_tests.h"
+
+/* image and instance of the test running under the image fixture */
+static char *image = NULL;
+static vmi_instance_t image_vmi = NULL;
+
+/* build a memory image where every page is tagged with (image, page) */
+char *
+create_tagged_image (int tag)
+{
+    char *path = strdup("/tmp/libvmi_check_XXXXXX");
+    int fd = mkstemp(path);
+    uint32_t page[PAGE_SIZE / sizeof(uint32_t)];
+    int i = 0;
+    int j = 0;
+
+    fail_unless(fd >= 0, "failed to create memory image");
+    for (i = 0; i < NUM_PAGES; ++i) {
+        for (j = 0; j < PAGE_SIZE / sizeof(uint32_t); ++j) {
+            page[j] = (tag << 16) | i;
+        }
+        fail_unless(write(fd, page, PAGE_SIZE) == PAGE_SIZE,
+                    "failed to write memory image");
+    }
+    close(fd);
+    return path;
+}
+
+void
+image_setup (void)
+{
+    image = create_tagged_image(1);
+    image_vmi = NULL;
+}
+
+void
+image_teardown (void)
+{
+    if (image_vmi) {
+        vmi_destroy(image_vmi);
+        image_vmi = NULL;
+    }
+    unlink(image);
+    free(image);
+    image = NULL;
+}
+
+char *
+get_image (void)
+{
+    return image;
+}
+
+/* (re)open the fixture image with the given flags, completed with config
+ * if one is given and walking page tables in mode unless it is unknown */
+vmi_instance_t
+init_image (uint32_t flags, char *config, page_mode_t mode)
+{
+    if (image_vmi) {
+        vmi_destroy(image_vmi);
+        image_vmi = NULL;
+    }
+    fail_unless(VMI_SUCCESS ==
+                vmi_init(&image_vmi, VMI_FILE | VMI_INIT_PARTIAL | flags,
+                         image),
+                "vmi_init failed");
+    if (config) {
+        vmi_init_complete(&image_vmi, config);
+    }
+    if (VMI_PM_UNKNOWN != mode) {
+        vmi_set_page_mode(image_vmi, mode);
+    }
+    return image_vmi;
+}
+
+/* 32-bit page directory at page 1: 0x400000 maps count pages from first
+ * through the page table at page 2 */
+void
+map_legacy_pages (vmi_instance_t vmi, int first, int count)
+{
+    uint32_t entry = (2 * PAGE_SIZE) | 1;
+    int i = 0;
+
+    vmi_write_32_pa(vmi, PAGE_SIZE + 4, &entry);
+    for (i = 0; i < count; ++i) {
+        entry = ((first + i) * PAGE_SIZE) | 1;
+        vmi_write_32_pa(vmi, 2 * PAGE_SIZE + i * 4, &entry);
+    }
+}
+
+/* PML4 at page 1, PDPT at page 2, PD at page 3: 0x200000 maps count
+ * pages from first through the page table at page 4 */
+void
+map_ia32e_pages (vmi_instance_t vmi, int first, int count)
+{
+    uint64_t entry = (2 * PAGE_SIZE) | 1;
+    int i = 0;
+
+    vmi_write_64_pa(vmi, PAGE_SIZE, &entry);
+    entry = (3 * PAGE_SIZE) | 1;
+    vmi_write_64_pa(vmi, 2 * PAGE_SIZE, &entry);
+    entry = (4 * PAGE_SIZE) | 1;
+    vmi_write_64_pa(vmi, 3 * PAGE_SIZE + 8, &entry);
+    for (i = 0; i < count; ++i) {
+        entry = ((first + i) * PAGE_SIZE) | 1;
+        vmi_write_64_pa(vmi, 4 * PAGE_SIZE + i * 8, &entry);
+    }
+}
+
+/* write a small PE image at pa: a name in its export section, one read
+ * from elsewhere, a forwarded export and one exported by ordinal only */
+void
+write_synthetic_pe (vmi_instance_t vmi, addr_t pa, uint32_t stamp)
+{
+    uint8_t *image = calloc(1, 8 * PAGE_SIZE);
+    struct dos_header *dos = (struct dos_header *) image;
+    struct pe_header *pe = (struct pe_header *) (image + 0x80);
+    struct optional_header_pe32 *oh =
+        (struct optional_header_pe32 *) (image + 0x80 + sizeof(*pe));
+    struct export_table *et = (struct export_table *) (image + 0x1000);
+    uint32_t functions[4] = { 0x2000, 0x2100, 0x1180, 0x2300 };
+    uint32_t names[3] = { 0x1110, 0x3000, 0x1130 };
+    uint16_t ordinals[3] = { 0, 1, 2 };
+
+    dos->signature = IMAGE_DOS_HEADER;
+    dos->offset_to_pe = 0x80;
+    pe->signature = IMAGE_NT_SIGNATURE;
+    pe->size_of_optional_header = sizeof(*oh);
+    oh->magic = IMAGE_PE32_MAGIC;
+    oh->size_of_image = 8 * PAGE_SIZE;
+    oh->idd[IMAGE_DIRECTORY_ENTRY_EXPORT].virtual_address = 0x1000;
+    oh->idd[IMAGE_DIRECTORY_ENTRY_EXPORT].size = 0x200;
+
+    et->time_date_stamp = stamp;
+    et->name = 0x1100;
+    et->number_of_functions = 4;
+    et->number_of_names = 3;
+    et->address_of_functions = 0x1040;
+    et->address_of_names = 0x1060;
+    et->address_of_name_ordinals = 0x1070;
+    functions[0] += stamp;
+    memcpy(image + 0x1040, functions, sizeof(functions));
+    memcpy(image + 0x1060, names, sizeof(names));
+    memcpy(image + 0x1070, ordinals, sizeof(ordinals));
+    strcpy((char *) image + 0x1100, "test.sys");
+    strcpy((char *) image + 0x1110, "Alpha");
+    strcpy((char *) image + 0x1130, "Forwarded");
+    strcpy((char *) image + 0x1180, "other.Thing");
+    strcpy((char *) image + 0x3000, "Beta");
+
+    fail_unless(vmi_write_pa(vmi, pa, image, 8 * PAGE_SIZE) == 8 * PAGE_SIZE,
+                "failed to write PE image");
+    free(image);
+}
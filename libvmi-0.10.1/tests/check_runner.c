@@ -25,6 +25,7 @@
 #include <check.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "../libvmi/libvmi.h"
 #include "check_tests.h"
 
 char *testvm = NULL;
@@ -59,6 +60,7 @@ main (void)
     suite_add_tcase(s, accessor_tcase());
     suite_add_tcase(s, util_tcase());
     suite_add_tcase(s, peparse_tcase());
+    suite_add_tcase(s, cache_tcase());
 
     /* run the tests */
     SRunner *sr = srunner_create(s);
@@ -28,9 +28,29 @@
 /* vm name access */
 char *get_testvm();
 
+/* tagged file images: every page of image holds (image << 16) | page */
+#define NUM_PAGES 64
+#define PAGE_SIZE 0x1000
+char *create_tagged_image (int image);
+
+/* image fixture: a tagged image 1 for each test, opened by init_image
+ * and destroyed with any open instance after the test */
+void image_setup (void);
+void image_teardown (void);
+char *get_image (void);
+vmi_instance_t init_image (uint32_t flags, char *config, page_mode_t mode);
+
+/* page tables in a writable image, rooted at page 1 */
+void map_legacy_pages (vmi_instance_t vmi, int first, int count);
+void map_ia32e_pages (vmi_instance_t vmi, int first, int count);
+
+/* an eight-page PE module with a small export directory */
+void write_synthetic_pe (vmi_instance_t vmi, addr_t pa, uint32_t stamp);
+
 /* test cases */
 TCase *init_tcase (void);
 TCase *translate_tcase (void);
 TCase *read_tcase (void);
+TCase *cache_tcase (void);
 
 #endif /* CHECK_TESTS_H */
@@ -0,0 +1,854 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2012 VMITools Project
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <check.h>
+#include "../libvmi/libvmi.h"
+#include "../libvmi/peparse.h"
+#include "check_tests.h"
+
+#define NUM_INSTANCES 4
+
+/* file images read through the page cache rather than mapped whole */
+#define CACHED_IMAGE (VMI_FILE | VMI_INIT_PARTIAL | VMI_INIT_NOMMAP)
+
+/* interleave reads from several file instances and check that every
+ * instance sees its own pages, including after another is destroyed */
+START_TEST (test_page_cache_multi_instance)
+{
+    vmi_instance_t vmi[NUM_INSTANCES];
+    char *path[NUM_INSTANCES];
+    cache_stats_t stats;
+    uint32_t value = 0;
+    int i = 0;
+    int page = 0;
+    int round = 0;
+
+    for (i = 0; i < NUM_INSTANCES; ++i) {
+        path[i] = create_tagged_image(i + 1);
+        fail_unless(VMI_SUCCESS ==
+                    vmi_init(&vmi[i], CACHED_IMAGE, path[i]),
+                    "vmi_init failed");
+    }
+
+    /* frame 0 is never mapped, so start with the first page after it */
+    for (round = 0; round < 2; ++round) {
+        for (page = 1; page < NUM_PAGES; ++page) {
+            for (i = 0; i < NUM_INSTANCES; ++i) {
+                if (NULL == vmi[i]) {
+                    continue;
+                }
+                fail_unless(VMI_SUCCESS ==
+                            vmi_read_32_pa(vmi[i], page * PAGE_SIZE + 8, &value),
+                            "vmi_read_32_pa failed");
+                fail_unless(value == (((i + 1) << 16) | page),
+                            "read returned data from the wrong instance");
+            }
+        }
+
+        /* every page is fetched once, the second round is served from
+         * each instance's own cache */
+        vmi_get_cache_stats(vmi[0], VMI_CACHE_PAGE, &stats);
+        fail_unless(stats.inserts == NUM_PAGES - 1 &&
+                    stats.lookups == (round + 1) * (NUM_PAGES - 1),
+                    "pages not read through the page cache");
+
+        /* drop one instance in the middle and keep reading the rest */
+        if (vmi[1]) {
+            vmi_destroy(vmi[1]);
+            vmi[1] = NULL;
+        }
+    }
+
+    for (i = 0; i < NUM_INSTANCES; ++i) {
+        if (vmi[i]) {
+            vmi_destroy(vmi[i]);
+        }
+        unlink(path[i]);
+        free(path[i]);
+    }
+}
+END_TEST
+
+/* a budget of a few pages must evict one page at a time and keep
+ * returning correct data under both eviction policies */
+START_TEST (test_page_cache_limits)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_NOMMAP, NULL, VMI_PM_UNKNOWN);
+    cache_stats_t stats;
+    uint32_t value = 0;
+    int page = 0;
+
+    fail_unless(VMI_FAILURE ==
+                vmi_set_page_cache_limits(vmi, 0, 0, 42),
+                "vmi_set_page_cache_limits accepted a bad policy");
+
+    fail_unless(VMI_SUCCESS ==
+                vmi_set_page_cache_limits(vmi, 3 * PAGE_SIZE, 0,
+                                          VMI_PAGE_CACHE_FIFO),
+                "vmi_set_page_cache_limits failed");
+    for (page = 1; page < NUM_PAGES; ++page) {
+        vmi_read_32_pa(vmi, page * PAGE_SIZE, &value);
+        fail_unless(value == ((1 << 16) | page), "wrong data with FIFO");
+        vmi_read_32_pa(vmi, PAGE_SIZE, &value);
+        fail_unless(value == ((1 << 16) | 1), "wrong data with FIFO");
+    }
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGE, &stats);
+    fail_unless(stats.entries == 3 && stats.bytes == 3 * PAGE_SIZE,
+                "cache outgrew its budget");
+    fail_unless(stats.evictions == stats.inserts - 3 && stats.hits > 0,
+                "wrong eviction counters with FIFO");
+
+    /* shrinking below one page still has to work */
+    fail_unless(VMI_SUCCESS ==
+                vmi_set_page_cache_limits(vmi, 0, 0, VMI_PAGE_CACHE_LRU),
+                "vmi_set_page_cache_limits failed");
+    for (page = NUM_PAGES - 1; page > 0; --page) {
+        vmi_read_32_pa(vmi, page * PAGE_SIZE, &value);
+        fail_unless(value == ((1 << 16) | page), "wrong data with LRU");
+    }
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGE, &stats);
+    fail_unless(stats.entries == 1, "more than one page kept without budget");
+}
+END_TEST
+
+/* sequential reads trigger read-ahead, which must not change the data
+ * returned and must account for every page it brings in */
+START_TEST (test_page_cache_prefetch)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_NOMMAP, NULL, VMI_PM_UNKNOWN);
+    uint64_t prefetched = 0;
+    uint64_t used = 0;
+    uint64_t wasted = 0;
+    uint64_t before = 0;
+    uint32_t value = 0;
+    int page = 0;
+
+    vmi_set_page_cache_prefetch(vmi, 8);
+
+    for (page = 1; page < NUM_PAGES; ++page) {
+        vmi_read_32_pa(vmi, page * PAGE_SIZE, &value);
+        fail_unless(value == ((1 << 16) | page), "wrong data with read-ahead");
+    }
+    vmi_get_page_cache_prefetch_stats(vmi, &prefetched, &used, &wasted);
+    fail_unless(prefetched > 0, "sequential reads did not read ahead");
+    fail_unless(used > 0, "read-ahead pages never used");
+    fail_unless(used + wasted <= prefetched, "read-ahead counters disagree");
+
+    /* with read-ahead disabled nothing more is prefetched */
+    vmi_set_page_cache_prefetch(vmi, 0);
+    vmi_set_page_cache_limits(vmi, 0, 0, VMI_PAGE_CACHE_LRU);
+    before = prefetched;
+    for (page = 1; page < NUM_PAGES; ++page) {
+        vmi_read_32_pa(vmi, page * PAGE_SIZE, &value);
+    }
+    vmi_get_page_cache_prefetch_stats(vmi, &prefetched, NULL, NULL);
+    fail_unless(prefetched == before, "read-ahead ran while disabled");
+}
+END_TEST
+
+/* the cache epoch moves on v2p flushes and pause/resume, and nowhere
+ * else while the epoch clock is off */
+START_TEST (test_cache_epoch)
+{
+    vmi_instance_t vmi = init_image(0, NULL, VMI_PM_UNKNOWN);
+    uint64_t epoch = 0;
+    uint32_t value = 0;
+
+    epoch = vmi_get_cache_epoch(vmi);
+    vmi_read_32_pa(vmi, PAGE_SIZE, &value);
+    vmi_read_32_pa(vmi, PAGE_SIZE, &value);
+    fail_unless(vmi_get_cache_epoch(vmi) == epoch, "epoch moved on reads");
+
+    vmi_pidcache_flush(vmi);
+    vmi_symcache_flush(vmi);
+    vmi_rvacache_flush(vmi);
+    fail_unless(vmi_get_cache_epoch(vmi) == epoch,
+                "epoch moved on a pid, sym or rva flush");
+
+    vmi_v2pcache_flush(vmi);
+    fail_unless(vmi_get_cache_epoch(vmi) == epoch + 1,
+                "epoch did not advance on flush");
+
+    vmi_pause_vm(vmi);
+    vmi_resume_vm(vmi);
+    fail_unless(vmi_get_cache_epoch(vmi) == epoch + 3,
+                "epoch did not advance on pause/resume");
+}
+END_TEST
+
+/* the address caches count their lookups, inserts and flushes and
+ * report what they currently hold */
+START_TEST (test_cache_stats)
+{
+    vmi_instance_t vmi = init_image(0, NULL, VMI_PM_UNKNOWN);
+    cache_stats_t stats;
+    addr_t dtb = 0x1000;
+    addr_t va = 0x400000;
+
+    vmi_reset_cache_stats(vmi);
+
+    vmi_pid_to_dtb(vmi, 42);
+    vmi_pidcache_add(vmi, 42, dtb);
+    fail_unless(vmi_pid_to_dtb(vmi, 42) == dtb, "pid cache miss");
+    fail_unless(VMI_SUCCESS ==
+                vmi_get_cache_stats(vmi, VMI_CACHE_PID, &stats),
+                "no pid cache stats");
+    fail_unless(stats.lookups == 2 && stats.hits == 1 && stats.misses == 1,
+                "wrong pid cache lookup counters");
+    fail_unless(stats.inserts == 1 && stats.entries == 1 && stats.bytes > 0,
+                "wrong pid cache occupancy");
+
+    vmi_v2pcache_add(vmi, va, dtb, 2 * PAGE_SIZE);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va + 0x10) ==
+                2 * PAGE_SIZE + 0x10, "v2p cache miss");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.hits == 1 && stats.inserts == 1 && stats.entries == 1,
+                "wrong v2p cache counters");
+
+    vmi_v2pcache_flush(vmi);
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.evictions == 1 && stats.entries == 0,
+                "flush not counted");
+
+    vmi_reset_cache_stats(vmi);
+    vmi_get_cache_stats(vmi, VMI_CACHE_PID, &stats);
+    fail_unless(stats.lookups == 0 && stats.inserts == 0,
+                "counters not reset");
+    fail_unless(stats.entries == 1, "reset dropped entries");
+
+    fail_unless(VMI_FAILURE ==
+                vmi_get_cache_stats(vmi, VMI_CACHE_COUNT, &stats),
+                "accepted unknown cache");
+}
+END_TEST
+
+/* a read right after a write sees the new data, and writing a page table
+ * drops the translations cached from it, but not those of other dtbs */
+START_TEST (test_cache_write_through)
+{
+    vmi_instance_t vmi = NULL;
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t va = 0x400000;
+    uint32_t pte = 0;
+    addr_t other = 40 * PAGE_SIZE;
+    uint64_t epoch = 0;
+    cache_stats_t stats;
+    uint32_t value = 0xdeadbeef;
+
+    /* without VMI_INIT_WRITE the image is left alone */
+    vmi = init_image(VMI_INIT_NOMMAP, NULL, VMI_PM_UNKNOWN);
+    fail_unless(VMI_FAILURE == vmi_write_32_pa(vmi, 3 * PAGE_SIZE, &value),
+                "read-only image written");
+
+    vmi = init_image(VMI_INIT_NOMMAP | VMI_INIT_WRITE, NULL, VMI_PM_UNKNOWN);
+
+    vmi_reset_cache_stats(vmi);
+    vmi_read_32_pa(vmi, 3 * PAGE_SIZE, &value);
+    fail_unless(value == ((1 << 16) | 3), "wrong data before write");
+    value = 0xdeadbeef;
+    fail_unless(VMI_SUCCESS == vmi_write_32_pa(vmi, 3 * PAGE_SIZE, &value),
+                "write failed");
+    value = 0;
+    vmi_read_32_pa(vmi, 3 * PAGE_SIZE, &value);
+    fail_unless(value == 0xdeadbeef, "read after write returned stale data");
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGE, &stats);
+    fail_unless(stats.misses == 2 && stats.hits == 0,
+                "written page not dropped from the cache");
+    fail_unless(stats.invalidations == 1 && stats.evictions == 0,
+                "written page counted as an eviction");
+
+    /* one 32-bit page directory entry and page table entry for va */
+    fail_unless(VMI_SUCCESS == vmi_set_page_mode(vmi, VMI_PM_LEGACY),
+                "set page mode failed");
+    map_legacy_pages(vmi, 5, 1);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va) == 5 * PAGE_SIZE,
+                "wrong translation");
+    vmi_v2pcache_add(vmi, va, other, 20 * PAGE_SIZE);
+
+    epoch = vmi_get_cache_epoch(vmi);
+    pte = (6 * PAGE_SIZE) | 1;
+    vmi_write_32_pa(vmi, 2 * PAGE_SIZE, &pte);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va) == 6 * PAGE_SIZE,
+                "translation not invalidated by page-table write");
+    fail_unless(vmi_get_cache_epoch(vmi) == epoch,
+                "epoch moved on a page-table write");
+    fail_unless(vmi_pagetable_lookup(vmi, other, va) == 20 * PAGE_SIZE,
+                "other dtb dropped by page-table write");
+}
+END_TEST
+
+START_TEST (test_paging_cache)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_IA32E);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t va = 0x200000;
+    cache_stats_t stats;
+    uint64_t entry = 0;
+    int i = 0;
+
+    /* va maps pages 10-13, or pages 30-33 through the page table at
+     * page 5 */
+    map_ia32e_pages(vmi, 10, 4);
+    for (i = 0; i < 4; ++i) {
+        entry = ((30 + i) * PAGE_SIZE) | 1;
+        vmi_write_64_pa(vmi, 5 * PAGE_SIZE + i * 8, &entry);
+    }
+    vmi_reset_cache_stats(vmi);
+
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va) == 10 * PAGE_SIZE,
+                "wrong first translation");
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGING, &stats);
+    fail_unless(stats.misses == 3 && stats.hits == 0 && stats.entries == 3,
+                "upper levels not cached");
+
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va + PAGE_SIZE) ==
+                11 * PAGE_SIZE, "wrong cached walk");
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGING, &stats);
+    fail_unless(stats.misses == 3 && stats.hits == 3,
+                "walk did not start at the cached pde");
+
+    /* pointing the pde at another page table drops the cached levels */
+    entry = (5 * PAGE_SIZE) | 1;
+    vmi_write_64_pa(vmi, 3 * PAGE_SIZE + 8, &entry);
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGING, &stats);
+    fail_unless(stats.entries == 0, "pde write did not flush");
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va + 3 * PAGE_SIZE) ==
+                33 * PAGE_SIZE, "stale pde used");
+}
+END_TEST
+
+START_TEST (test_v2p_large_pages)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_LEGACY);
+    addr_t dtb = 1 * PAGE_SIZE;
+    cache_stats_t stats;
+    uint32_t entry = 0;
+
+    /* 0x400000 maps page 10, 0x800000 is a 4MB page at physical
+     * address 0 */
+    map_legacy_pages(vmi, 10, 1);
+    entry = 0x81;
+    vmi_write_32_pa(vmi, dtb + 8, &entry);
+    vmi_reset_cache_stats(vmi);
+
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x803010) == 0x3010,
+                "wrong large page translation");
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0xbff000) == 0x3ff000,
+                "wrong large page translation");
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x400020) ==
+                10 * PAGE_SIZE + 0x20, "wrong small page translation");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.hits == 1 && stats.entries == 2,
+                "large page not held in one entry");
+}
+END_TEST
+
+START_TEST (test_v2p_invalidation)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_LEGACY);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t beyond = (NUM_PAGES + 16) * PAGE_SIZE;
+    cache_stats_t stats;
+
+    map_legacy_pages(vmi, 10, 1);
+
+    /* hits are trusted without reading guest memory */
+    vmi_v2pcache_add(vmi, 0x400000, dtb, beyond);
+    vmi_v2pcache_add(vmi, 0x400000, 3 * PAGE_SIZE, beyond);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x400000) == beyond,
+                "v2p hit was checked");
+
+    /* in paranoid mode a hit that cannot be read is dropped */
+    vmi_set_v2p_cache_paranoid(vmi, 1);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x400000) == 10 * PAGE_SIZE,
+                "paranoid hit not checked");
+    vmi_set_v2p_cache_paranoid(vmi, 0);
+
+    /* only the given address space is flushed */
+    vmi_v2pcache_flush_dtb(vmi, 3 * PAGE_SIZE);
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.entries == 1, "wrong dtb flushed");
+    vmi_v2pcache_add(vmi, 0x400000, dtb, beyond);
+    vmi_v2pcache_flush_dtb(vmi, dtb);
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.entries == 0, "dtb flush kept its entries");
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x400000) == 10 * PAGE_SIZE,
+                "flushed translation used");
+
+    /* entries do not survive a pause */
+    vmi_reset_cache_stats(vmi);
+    vmi_pause_vm(vmi);
+    vmi_pagetable_lookup(vmi, dtb, 0x400000);
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.misses == 1 && stats.hits == 0,
+                "entry used after the epoch advanced");
+    vmi_resume_vm(vmi);
+}
+END_TEST
+
+START_TEST (test_v2p_capacity)
+{
+    vmi_instance_t vmi = init_image(0, NULL, VMI_PM_LEGACY);
+    addr_t dtb = 1 * PAGE_SIZE;
+    cache_stats_t stats;
+    uint64_t bytes = 0;
+    int i = 0;
+
+    fail_unless(VMI_SUCCESS == vmi_set_v2p_cache_capacity(vmi, 16),
+                "failed to set the capacity");
+
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    bytes = stats.bytes;
+    for (i = 1; i <= 200; ++i) {
+        vmi_v2pcache_add(vmi, i * PAGE_SIZE, dtb, (i + 1000) * PAGE_SIZE);
+    }
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.entries <= 16 && stats.bytes == bytes,
+                "cache grew beyond its capacity");
+    fail_unless(stats.evictions == 200 - stats.entries,
+                "evictions not counted");
+
+    /* the last translation added is always held */
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 200 * PAGE_SIZE + 8) ==
+                1200 * PAGE_SIZE + 8, "last translation evicted");
+}
+END_TEST
+
+START_TEST (test_v2p_tlb)
+{
+    vmi_instance_t vmi = init_image(0, NULL, VMI_PM_UNKNOWN);
+    addr_t dtb = 1 * PAGE_SIZE;
+    cache_stats_t stats;
+    int i = 0;
+
+    vmi_v2pcache_add(vmi, 0x400000, dtb, 10 * PAGE_SIZE);
+    vmi_reset_cache_stats(vmi);
+
+    /* the second use of a translation comes from the tlb */
+    for (i = 0; i < 4; ++i) {
+        fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x400000 + i * 4) ==
+                    10 * PAGE_SIZE + i * 4, "wrong translation");
+    }
+    vmi_get_cache_stats(vmi, VMI_CACHE_TLB, &stats);
+    fail_unless(stats.lookups == 4 && stats.hits == 3 &&
+                stats.inserts == 1 && stats.entries == 1,
+                "wrong tlb counters");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.lookups == 1 && stats.hits == 1,
+                "tlb hit reached the v2p cache");
+
+    /* changing or flushing a translation also drops it from the tlb */
+    vmi_v2pcache_add(vmi, 0x400000, dtb, 11 * PAGE_SIZE);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, 0x400000) == 11 * PAGE_SIZE,
+                "stale tlb entry used");
+    vmi_pagetable_lookup(vmi, dtb, 0x400000);
+    vmi_v2pcache_flush_dtb(vmi, dtb);
+    vmi_get_cache_stats(vmi, VMI_CACHE_TLB, &stats);
+    fail_unless(stats.entries == 0, "tlb not flushed with its dtb");
+}
+END_TEST
+
+START_TEST (test_v2p_unmapped)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_IA32E);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t va = 0x200000;
+    cache_stats_t stats;
+    uint64_t entry = 0;
+    uint64_t epoch = 0;
+
+    /* only the first page of va is mapped, the tags leave the rest of the
+     * page table empty */
+    map_ia32e_pages(vmi, 10, 1);
+    vmi_pidcache_add(vmi, 1, dtb);
+    vmi_reset_cache_stats(vmi);
+
+    /* a second probe of an unmapped page does not walk again, and does
+     * not drop the dtb of the process */
+    fail_unless(vmi_translate_uv2p(vmi, va + 8 * PAGE_SIZE, 1) == 0,
+                "unmapped page translated");
+    fail_unless(vmi_translate_uv2p(vmi, va + 8 * PAGE_SIZE + 8, 1) == 0,
+                "unmapped page translated");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P_MISS, &stats);
+    fail_unless(stats.hits == 1 && stats.inserts == 1 && stats.entries == 1,
+                "wrong unmapped page counters");
+    vmi_get_cache_stats(vmi, VMI_CACHE_PID, &stats);
+    fail_unless(stats.evictions == 0 && stats.entries == 1,
+                "pid cache purged on an unmapped page");
+
+    /* mapping the page through a page-table write is seen at once */
+    entry = (18 * PAGE_SIZE) | 1;
+    vmi_write_64_pa(vmi, 4 * PAGE_SIZE + 8 * 8, &entry);
+    fail_unless(vmi_translate_uv2p(vmi, va + 8 * PAGE_SIZE, 1) ==
+                18 * PAGE_SIZE, "stale unmapped page entry used");
+
+    /* and an unmapped page does not outlive its epoch */
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va + 9 * PAGE_SIZE) == 0,
+                "unmapped page translated");
+    vmi_resume_vm(vmi);
+    vmi_reset_cache_stats(vmi);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va + 9 * PAGE_SIZE) == 0,
+                "unmapped page translated");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P_MISS, &stats);
+    fail_unless(stats.hits == 0 && stats.evictions == 1 && stats.inserts == 1,
+                "unmapped page kept across epochs");
+
+    /* on a live guest the recheck age expires it without a pause, and a
+     * later miss in the same process checks its dtb again, while the
+     * epoch and the translations stamped with it stay */
+    vmi_set_cache_recheck_age(vmi, 1);
+    vmi_pidcache_add(vmi, 1, dtb);
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va) == 10 * PAGE_SIZE,
+                "wrong translation");
+    epoch = vmi_get_cache_epoch(vmi);
+    vmi_reset_cache_stats(vmi);
+    usleep(1100000);
+    fail_unless(vmi_translate_uv2p(vmi, va + 10 * PAGE_SIZE, 1) == 0,
+                "unmapped page translated");
+    vmi_get_cache_stats(vmi, VMI_CACHE_PID, &stats);
+    fail_unless(stats.evictions == 1, "stale pid kept after a miss");
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va + 9 * PAGE_SIZE) == 0,
+                "unmapped page translated");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P_MISS, &stats);
+    fail_unless(stats.hits == 0 && stats.evictions == 1,
+                "unmapped page outlived the recheck age");
+    fail_unless(vmi_get_cache_epoch(vmi) == epoch, "epoch moved with time");
+    fail_unless(vmi_pagetable_lookup(vmi, dtb, va) == 10 * PAGE_SIZE,
+                "wrong translation");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.evictions == 0, "translation expired with time");
+}
+END_TEST
+
+/* write a small System.map that lists one name twice */
+static char *
+create_system_map (void)
+{
+    char *path = strdup("/tmp/libvmi_check_map_XXXXXX");
+    int fd = mkstemp(path);
+    FILE *f = NULL;
+
+    fail_unless(fd >= 0, "failed to create System.map");
+    f = fdopen(fd, "w");
+    fprintf(f, "c0001000 T _text\n");
+    fprintf(f, "c0008000 D init_task\n");
+    fprintf(f, "c0004000 B swapper_pg_dir\n");
+    fprintf(f, "c0002000 t dup_symbol\n");
+    fprintf(f, "c0001800 t dup_symbol\n");
+    fprintf(f, "c0003000 r __ksymtab_printk\n");
+    fclose(f);
+    return path;
+}
+
+/* System.map lookups come from the parsed table: duplicated names keep
+ * their first row and a rewritten map is parsed again */
+START_TEST (test_system_map_table)
+{
+    vmi_instance_t vmi[2] = { NULL, NULL };
+    char *image = create_tagged_image(0);
+    char *map = create_system_map();
+    char config[256];
+    FILE *f = NULL;
+    int i = 0;
+
+    snprintf(config, sizeof(config),
+             "{ostype = \"Linux\"; sysmap = \"%s\";}", map);
+    for (i = 0; i < 2; ++i) {
+        fail_unless(VMI_SUCCESS ==
+                    vmi_init(&vmi[i], VMI_FILE | VMI_INIT_PARTIAL, image),
+                    "vmi_init failed");
+        fail_unless(VMI_SUCCESS == vmi_init_complete(&vmi[i], config),
+                    "vmi_init_complete failed");
+    }
+
+    for (i = 0; i < 2; ++i) {
+        fail_unless(vmi_translate_ksym2v(vmi[i], "swapper_pg_dir") ==
+                    0xc0004000, "wrong swapper_pg_dir");
+        fail_unless(vmi_translate_ksym2v(vmi[i], "dup_symbol") == 0xc0002000,
+                    "duplicate symbol did not keep its first row");
+        fail_unless(vmi_translate_ksym2v(vmi[i], "__ksymtab_printk") ==
+                    0xc0003000, "wrong __ksymtab_printk");
+        fail_unless(vmi_translate_ksym2v(vmi[i], "printk") == 0,
+                    "found a symbol that is not in the map");
+    }
+    vmi_destroy(vmi[0]);
+    fail_unless(vmi_translate_ksym2v(vmi[1], "_text") == 0xc0001000,
+                "shared table released while still in use");
+    vmi_destroy(vmi[1]);
+
+    /* a rewritten file is parsed again */
+    f = fopen(map, "a");
+    fprintf(f, "c0123000 T late_symbol\n");
+    fclose(f);
+    fail_unless(VMI_SUCCESS ==
+                vmi_init(&vmi[0], VMI_FILE | VMI_INIT_PARTIAL, image),
+                "vmi_init failed");
+    fail_unless(VMI_SUCCESS == vmi_init_complete(&vmi[0], config),
+                "vmi_init_complete failed");
+    fail_unless(vmi_translate_ksym2v(vmi[0], "late_symbol") == 0xc0123000,
+                "stale System.map table reused");
+    vmi_destroy(vmi[0]);
+
+    unlink(map);
+    unlink(image);
+    free(map);
+    free(image);
+}
+END_TEST
+
+/* addresses resolve to the closest symbol at or below them and up to
+ * _end, absolute symbols are skipped and results are served from the RVA
+ * cache */
+START_TEST (test_linux_v2sym)
+{
+    vmi_instance_t vmi = NULL;
+    char *image = create_tagged_image(0);
+    char *map = create_system_map();
+    char config[256];
+    const char *sym = NULL;
+    FILE *f = NULL;
+    cache_stats_t stats;
+
+    f = fopen(map, "a");
+    fprintf(f, "00000000 A __absolute\n");
+    fprintf(f, "c0001000 A __text_start\n");
+    fprintf(f, "c000a000 A _end\n");
+    fclose(f);
+    snprintf(config, sizeof(config),
+             "{ostype = \"Linux\"; sysmap = \"%s\";}", map);
+    fail_unless(VMI_SUCCESS ==
+                vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL, image),
+                "vmi_init failed");
+    fail_unless(VMI_SUCCESS == vmi_init_complete(&vmi, config),
+                "vmi_init_complete failed");
+    vmi_reset_cache_stats(vmi);
+
+    sym = vmi_translate_v2sym(vmi, 0, 0, 0xc0001000);
+    fail_unless(sym && !strcmp(sym, "_text"), "wrong exact symbol");
+    sym = vmi_translate_v2sym(vmi, 0xc0001000, 0, 0x10);
+    fail_unless(sym && !strcmp(sym, "_text+0x10"), "wrong symbol offset");
+    sym = vmi_translate_v2sym(vmi, 0, 0, 0xc0001fff);
+    fail_unless(sym && !strcmp(sym, "dup_symbol+0x7ff"),
+                "wrong symbol below a duplicate");
+    sym = vmi_translate_v2sym(vmi, 0, 0, 0xc0009000);
+    fail_unless(sym && !strcmp(sym, "init_task+0x1000"),
+                "wrong symbol past the last one");
+    fail_unless(vmi_translate_v2sym(vmi, 0, 0, 0xc0000fff) == NULL,
+                "resolved an address below every location");
+    fail_unless(vmi_translate_v2sym(vmi, 0, 0, 0xc000a001) == NULL,
+                "resolved an address past _end");
+    fail_unless(vmi_translate_v2sym(vmi, 0, 0, 0xc0800000) == NULL,
+                "resolved an address far past the last symbol");
+
+    fail_unless(VMI_SUCCESS == vmi_get_cache_stats(vmi, VMI_CACHE_RVA, &stats),
+                "failed to get RVA cache stats");
+    fail_unless(stats.inserts == 4, "results were not cached");
+    sym = vmi_translate_v2sym(vmi, 0, 0, 0xc0001fff);
+    fail_unless(sym && !strcmp(sym, "dup_symbol+0x7ff"), "wrong cached symbol");
+    fail_unless(VMI_SUCCESS == vmi_get_cache_stats(vmi, VMI_CACHE_RVA, &stats),
+                "failed to get RVA cache stats");
+    fail_unless(stats.hits == 1 && stats.inserts == 4,
+                "repeated lookup missed the cache");
+
+    vmi_destroy(vmi);
+    unlink(map);
+    unlink(image);
+    free(map);
+    free(image);
+}
+END_TEST
+
+/* a 32-bit kernel for a full Windows init: the PE image written by
+ * write_synthetic_pe at page 16 mapped at KERNEL_VA, a debugger data
+ * block and a System process whose page directory is page 1 */
+#define KERNEL_VA 0x80000000
+#define KDVB_VA (KERNEL_VA + 8 * PAGE_SIZE)
+#define SYSPROC_PA (25 * PAGE_SIZE)
+#define SYSPROC_VA (KERNEL_VA + 9 * PAGE_SIZE)
+#define WIN_TASKS 0x88
+#define WIN_PDBASE 0x18
+#define WIN_PNAME 0x174
+
+static void
+write_windows_kernel (char *path)
+{
+    vmi_instance_t vmi = NULL;
+    uint8_t page[PAGE_SIZE];
+    uint64_t kdvb_entry = 0;
+    uint32_t entry = 0;
+    int i = 0;
+
+    fail_unless(VMI_SUCCESS ==
+                vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL | VMI_INIT_WRITE,
+                         path),
+                "vmi_init failed");
+    memset(page, 0, PAGE_SIZE);
+    for (i = 1; i <= 2; ++i) {
+        vmi_write_pa(vmi, i * PAGE_SIZE, page, PAGE_SIZE);
+    }
+    vmi_write_pa(vmi, 24 * PAGE_SIZE, page, PAGE_SIZE);
+    vmi_write_pa(vmi, SYSPROC_PA, page, PAGE_SIZE);
+
+    /* KERNEL_VA maps pages 16-47 */
+    entry = (2 * PAGE_SIZE) | 1;
+    vmi_write_32_pa(vmi, PAGE_SIZE + (KERNEL_VA >> 22) * 4, &entry);
+    for (i = 0; i < 32; ++i) {
+        entry = ((16 + i) * PAGE_SIZE) | 1;
+        vmi_write_32_pa(vmi, 2 * PAGE_SIZE + i * 4, &entry);
+    }
+    write_synthetic_pe(vmi, 16 * PAGE_SIZE, 0);
+
+    /* KernBase and PsActiveProcessHead in the debugger data block, the
+     * list head in the same page */
+    kdvb_entry = KERNEL_VA;
+    vmi_write_64_pa(vmi, 24 * PAGE_SIZE + 24, &kdvb_entry);
+    kdvb_entry = KDVB_VA + 0x800;
+    vmi_write_64_pa(vmi, 24 * PAGE_SIZE + 80, &kdvb_entry);
+    entry = SYSPROC_VA + WIN_TASKS;
+    vmi_write_32_pa(vmi, 24 * PAGE_SIZE + 0x800, &entry);
+
+    entry = PAGE_SIZE;
+    vmi_write_32_pa(vmi, SYSPROC_PA + WIN_PDBASE, &entry);
+    entry = KDVB_VA + 0x800;
+    vmi_write_32_pa(vmi, SYSPROC_PA + WIN_TASKS, &entry);
+    vmi_write_pa(vmi, SYSPROC_PA + WIN_PNAME, "System", 7);
+    vmi_destroy(vmi);
+}
+
+static void
+patch_image (char *path, addr_t paddr, void *buf, size_t count)
+{
+    vmi_instance_t vmi = NULL;
+
+    fail_unless(VMI_SUCCESS ==
+                vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL | VMI_INIT_WRITE,
+                         path),
+                "vmi_init failed");
+    fail_unless(vmi_write_pa(vmi, paddr, buf, count) == count,
+                "failed to patch image");
+    vmi_destroy(vmi);
+}
+
+/* the tasks offset a full Windows init ends up with, 0 if it failed */
+static unsigned long
+windows_tasks_offset (char *path, char *config)
+{
+    vmi_instance_t vmi = NULL;
+    unsigned long offset = 0;
+
+    fail_unless(VMI_SUCCESS == vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL,
+                                        path),
+                "vmi_init failed");
+    if (VMI_SUCCESS == vmi_init_complete(&vmi, config)) {
+        offset = vmi_get_offset(vmi, "win_tasks");
+    }
+    vmi_destroy(vmi);
+    return offset;
+}
+
+/* what a configured init saves is used by a later one without the
+ * offsets, but only while its kernel is still in memory */
+START_TEST (test_windows_profile_cache)
+{
+    char *path = get_image();
+    char dir[] = "/tmp/libvmi_profile_XXXXXX";
+    char config[512];
+    addr_t stamp = 16 * PAGE_SIZE + 0x80 +
+        offsetof(struct pe_header, time_date_stamp);
+    uint32_t value = 0;
+
+    fail_unless(mkdtemp(dir) != NULL, "failed to create profile cache");
+    write_windows_kernel(path);
+
+    snprintf(config, sizeof(config),
+             "{ostype = \"Windows\"; profile_cache = \"%s\"; "
+             "win_kdvb = 0x%x; win_sysproc = 0x%x; win_tasks = 0x%x; "
+             "win_pdbase = 0x%x; win_pname = 0x%x;}", dir, KDVB_VA,
+             SYSPROC_PA, WIN_TASKS, WIN_PDBASE, WIN_PNAME);
+    fail_unless(windows_tasks_offset(path, config) == WIN_TASKS,
+                "configured init failed");
+
+    snprintf(config, sizeof(config),
+             "{ostype = \"Windows\"; profile_cache = \"%s\";}", dir);
+    fail_unless(windows_tasks_offset(path, config) == WIN_TASKS,
+                "saved profile not used");
+
+    /* a profile for some other kernel is ignored */
+    value = 1;
+    patch_image(path, stamp, &value, sizeof(value));
+    fail_unless(windows_tasks_offset(path, config) == 0,
+                "profile of another kernel used");
+    value = 0;
+    patch_image(path, stamp, &value, sizeof(value));
+
+    /* so is one that no longer finds the System process */
+    patch_image(path, SYSPROC_PA + WIN_PNAME, "Idle", 5);
+    fail_unless(windows_tasks_offset(path, config) == 0,
+                "profile without its System process used");
+    patch_image(path, SYSPROC_PA + WIN_PNAME, "System", 7);
+
+    /* or whose page directory maps the kernel elsewhere */
+    value = (17 * PAGE_SIZE) | 1;
+    patch_image(path, 2 * PAGE_SIZE, &value, sizeof(value));
+    fail_unless(windows_tasks_offset(path, config) == 0,
+                "profile with a stale page directory used");
+    value = (16 * PAGE_SIZE) | 1;
+    patch_image(path, 2 * PAGE_SIZE, &value, sizeof(value));
+
+    fail_unless(windows_tasks_offset(path, config) == WIN_TASKS,
+                "restored kernel does not match its profile");
+
+    snprintf(config, sizeof(config), "rm -rf %s", dir);
+    fail_unless(system(config) == 0, "failed to remove profile cache");
+}
+END_TEST
+
+/* cache test cases */
+TCase *cache_tcase (void)
+{
+    TCase *tc_cache = tcase_create("LibVMI Cache");
+    tcase_add_checked_fixture(tc_cache, image_setup, image_teardown);
+    tcase_add_test(tc_cache, test_page_cache_multi_instance);
+    tcase_add_test(tc_cache, test_page_cache_limits);
+    tcase_add_test(tc_cache, test_page_cache_prefetch);
+    tcase_add_test(tc_cache, test_cache_epoch);
+    tcase_add_test(tc_cache, test_cache_stats);
+    tcase_add_test(tc_cache, test_cache_write_through);
+    tcase_add_test(tc_cache, test_paging_cache);
+    tcase_add_test(tc_cache, test_v2p_large_pages);
+    tcase_add_test(tc_cache, test_v2p_invalidation);
+    tcase_add_test(tc_cache, test_v2p_capacity);
+    tcase_add_test(tc_cache, test_v2p_tlb);
+    tcase_add_test(tc_cache, test_v2p_unmapped);
+    tcase_add_test(tc_cache, test_system_map_table);
+    tcase_add_test(tc_cache, test_linux_v2sym);
+    tcase_add_test(tc_cache, test_windows_profile_cache);
+    return tc_cache;
+}
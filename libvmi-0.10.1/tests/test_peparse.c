@@ -295,13 +295,108 @@ START_TEST (test_peparse)
 }
 END_TEST
 
+/* exports are resolved from one parse of the export directory, which is
+ * checked again in a later epoch and dropped with its dtb */
+START_TEST (test_export_cache)
+{
+    /* there is no kernel to find, only the OS type is needed */
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, "{ostype = \"Windows\";}",
+                                    VMI_PM_LEGACY);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t base = 0x400000;
+    cache_stats_t stats;
+
+    /* base maps pages 16-23 */
+    map_legacy_pages(vmi, 16, 8);
+    write_synthetic_pe(vmi, 16 * PAGE_SIZE, 0);
+    vmi_pidcache_add(vmi, 1, dtb);
+    vmi_reset_cache_stats(vmi);
+
+    fail_unless(vmi_translate_sym2v(vmi, base, 1, "Alpha") == base + 0x2000,
+                "wrong export in the export section");
+    fail_unless(vmi_translate_sym2v(vmi, base, 1, "Beta") == base + 0x2100,
+                "wrong export named outside the export section");
+    fail_unless(vmi_translate_sym2v(vmi, base, 1, "Forwarded") == 0,
+                "forwarded export resolved");
+    fail_unless(vmi_translate_sym2v(vmi, base, 1, "Alph") == 0,
+                "prefix of an export resolved");
+    vmi_get_cache_stats(vmi, VMI_CACHE_EXPORT, &stats);
+    fail_unless(stats.inserts == 1 && stats.misses == 1 && stats.hits == 3 &&
+                stats.entries == 1, "export directory parsed more than once");
+
+    /* the module is replaced while the guest runs; once it is paused
+     * the new directory is seen */
+    write_synthetic_pe(vmi, 16 * PAGE_SIZE, 0x10);
+    vmi_pause_vm(vmi);
+    vmi_symcache_flush(vmi);
+    fail_unless(vmi_translate_sym2v(vmi, base, 1, "Alpha") == base + 0x2010,
+                "stale export directory used");
+    vmi_get_cache_stats(vmi, VMI_CACHE_EXPORT, &stats);
+    fail_unless(stats.inserts == 2 && stats.evictions == 1,
+                "replaced export directory not parsed again");
+
+    /* an unchanged one is kept */
+    vmi_resume_vm(vmi);
+    vmi_symcache_flush(vmi);
+    fail_unless(vmi_translate_sym2v(vmi, base, 1, "Beta") == base + 0x2100,
+                "wrong export after revalidation");
+    vmi_get_cache_stats(vmi, VMI_CACHE_EXPORT, &stats);
+    fail_unless(stats.inserts == 2 && stats.evictions == 1,
+                "unchanged export directory parsed again");
+
+    vmi_v2pcache_flush_dtb(vmi, dtb);
+    vmi_get_cache_stats(vmi, VMI_CACHE_EXPORT, &stats);
+    fail_unless(stats.entries == 0 && stats.evictions == 2,
+                "export directory kept after its dtb was flushed");
+}
+END_TEST
+
+/* RVAs resolve to the closest named export at or below them, within
+ * SizeOfImage */
+START_TEST (test_export_rva_index)
+{
+    /* there is no kernel to find, only the OS type is needed */
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, "{ostype = \"Windows\";}",
+                                    VMI_PM_LEGACY);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t base = 0x400000;
+    const char *sym = NULL;
+
+    map_legacy_pages(vmi, 16, 8);
+    write_synthetic_pe(vmi, 16 * PAGE_SIZE, 0);
+    vmi_pidcache_add(vmi, 1, dtb);
+
+    sym = vmi_translate_v2sym(vmi, base, 1, 0x2000);
+    fail_unless(sym && !strcmp(sym, "Alpha"), "wrong exact export");
+    sym = vmi_translate_v2sym(vmi, base, 1, 0x2050);
+    fail_unless(sym && !strcmp(sym, "Alpha+0x50"), "wrong nearest export");
+    sym = vmi_translate_v2sym(vmi, base, 1, 0x2100);
+    fail_unless(sym && !strcmp(sym, "Beta"), "wrong export named elsewhere");
+    sym = vmi_translate_v2sym(vmi, base, 1, 0x2300);
+    fail_unless(sym && !strcmp(sym, "Beta+0x200"),
+                "export by ordinal only has a name");
+    fail_unless(vmi_translate_v2sym(vmi, base, 1, 0x1fff) == NULL,
+                "resolved an rva below every export");
+    fail_unless(vmi_translate_v2sym(vmi, base, 1, 0x1180) == NULL,
+                "resolved an rva in the export section");
+    sym = vmi_translate_v2sym(vmi, base, 1, 8 * PAGE_SIZE - 1);
+    fail_unless(sym && !strcmp(sym, "Beta+0x5eff"),
+                "wrong export at the end of the image");
+    fail_unless(vmi_translate_v2sym(vmi, base, 1, 8 * PAGE_SIZE) == NULL,
+                "resolved an rva past SizeOfImage");
+}
+END_TEST
+
 /* translate test cases */
 TCase *peparse_tcase (void)
 {
     TCase *tc_peparse = tcase_create("LibVMI PEparse");
     tcase_set_timeout(tc_peparse, 30);
+    tcase_add_checked_fixture(tc_peparse, image_setup, image_teardown);
     tcase_add_test(tc_peparse, test_peparse);
     // uv2p
+    tcase_add_test(tc_peparse, test_export_cache);
+    tcase_add_test(tc_peparse, test_export_rva_index);
     return tc_peparse;
 }
 
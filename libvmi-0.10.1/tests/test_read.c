@@ -264,10 +264,122 @@ START_TEST (test_vmi_read_64_pa)
 }
 END_TEST
 
+/* a batch may mix requests sharing a page, crossing pages and failing */
+START_TEST (test_read_pa_batch)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_NOMMAP, NULL, VMI_PM_UNKNOWN);
+    uint32_t a = 0, b = 0, c = 0, bad = 0;
+    uint32_t span[2] = { 0, 0 };
+    status_t status[7];
+    vmi_iov_t iov[7] = {
+        { 9 * PAGE_SIZE + 8, &a, sizeof(a) },
+        { 4 * PAGE_SIZE - 4, span, sizeof(span) },
+        { 9 * PAGE_SIZE + 64, &b, sizeof(b) },
+        { NUM_PAGES * PAGE_SIZE, &bad, sizeof(bad) },
+        { 2 * PAGE_SIZE, &c, sizeof(c) },
+        { 2 * PAGE_SIZE, NULL, sizeof(c) },
+        { 8, &bad, sizeof(bad) },
+    };
+    vmi_iov_t many[NUM_PAGES / 2];
+    uint32_t values[NUM_PAGES / 2];
+    cache_stats_t stats;
+    int i = 0;
+
+    fail_unless(vmi_read_pa_batch(vmi, iov, 7, status) == 4,
+                "wrong number of requests read");
+    fail_unless(status[0] == VMI_SUCCESS && status[1] == VMI_SUCCESS &&
+                status[2] == VMI_SUCCESS && status[4] == VMI_SUCCESS,
+                "valid request failed");
+    fail_unless(status[3] == VMI_FAILURE && status[5] == VMI_FAILURE &&
+                status[6] == VMI_FAILURE, "invalid request succeeded");
+    fail_unless(vmi_read_pa(vmi, 8, &bad, sizeof(bad)) == 0 &&
+                vmi_map_pa(vmi, 8, sizeof(bad)) == NULL,
+                "frame 0 read outside the batch");
+    fail_unless(a == ((1 << 16) | 9) && b == a, "wrong data in shared page");
+    fail_unless(span[0] == ((1 << 16) | 3) && span[1] == ((1 << 16) | 4),
+                "wrong data across pages");
+    fail_unless(c == ((1 << 16) | 2), "wrong data");
+
+    /* more pages than the cache holds are fetched over several rounds */
+    vmi_set_page_cache_limits(vmi, 4 * PAGE_SIZE, 0, VMI_PAGE_CACHE_FIFO);
+    for (i = 0; i < NUM_PAGES / 2; ++i) {
+        many[i].paddr = (NUM_PAGES / 2 - i) * PAGE_SIZE;
+        many[i].buf = &values[i];
+        many[i].count = sizeof(values[i]);
+    }
+    fail_unless(vmi_read_pa_batch(vmi, many, NUM_PAGES / 2, NULL) ==
+                NUM_PAGES / 2, "batch larger than the cache failed");
+    for (i = 0; i < NUM_PAGES / 2; ++i) {
+        fail_unless(values[i] == ((1 << 16) | (NUM_PAGES / 2 - i)),
+                    "wrong data in large batch");
+    }
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGE, &stats);
+    fail_unless(stats.entries == 4, "batch outgrew the cache");
+}
+END_TEST
+
+/* mapped pages stay readable in place until unmapped, however much else
+ * goes through the cache */
+START_TEST (test_map_pa)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_NOMMAP | VMI_INIT_WRITE, NULL,
+                                    VMI_PM_UNKNOWN);
+    const uint32_t *map = NULL;
+    const uint32_t *span = NULL;
+    cache_stats_t stats;
+    uint32_t value = 0;
+    int page = 0;
+
+    vmi_set_page_cache_limits(vmi, 2 * PAGE_SIZE, 0, VMI_PAGE_CACHE_FIFO);
+
+    map = vmi_map_pa(vmi, 5 * PAGE_SIZE + 16, sizeof(uint32_t));
+    fail_unless(map != NULL, "vmi_map_pa failed");
+    fail_unless(*map == ((1 << 16) | 5), "wrong mapped data");
+    fail_unless(vmi_map_pa(vmi, 5 * PAGE_SIZE + 16, 4) == (const void *) map,
+                "second mapping of the same address differs");
+    vmi_unmap(vmi, map);
+
+    for (page = 6; page < NUM_PAGES; ++page) {
+        vmi_read_32_pa(vmi, page * PAGE_SIZE, &value);
+    }
+    fail_unless(*map == ((1 << 16) | 5), "mapped page was evicted");
+    vmi_reset_cache_stats(vmi);
+    vmi_read_32_pa(vmi, 5 * PAGE_SIZE, &value);
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGE, &stats);
+    fail_unless(stats.hits == 1 && stats.entries <= 3,
+                "pinned page not held beyond the budget");
+
+    /* a write drops the page from the cache but not from under the map,
+     * which keeps the old bytes; mapping it again gives the new ones */
+    value = 0;
+    vmi_write_32_pa(vmi, 5 * PAGE_SIZE, &value);
+    fail_unless(map[0] == ((1 << 16) | 5) && map[1] == ((1 << 16) | 5),
+                "mapped page was released");
+    vmi_read_32_pa(vmi, 5 * PAGE_SIZE + 4, &value);
+    fail_unless(value == ((1 << 16) | 5), "wrong data after write");
+    vmi_read_32_pa(vmi, 5 * PAGE_SIZE, &value);
+    fail_unless(value == 0, "stale page read after write");
+    span = vmi_map_pa(vmi, 5 * PAGE_SIZE, sizeof(uint32_t));
+    fail_unless(span != NULL && span != map && *span == 0,
+                "mapping after a write did not return the new page");
+    vmi_unmap(vmi, span);
+    vmi_unmap(vmi, map);
+
+    /* only drivers holding the whole image map across pages */
+    span = vmi_map_pa(vmi, 8 * PAGE_SIZE - 4, 8);
+    if (span) {
+        fail_unless(span[0] == ((1 << 16) | 7) && span[1] == ((1 << 16) | 8),
+                    "wrong data in mapped span");
+        vmi_unmap(vmi, span);
+    }
+}
+END_TEST
+
 /* read test cases */
 TCase *read_tcase (void)
 {
     TCase *tc_read = tcase_create("LibVMI Read");
+    tcase_add_checked_fixture(tc_read, image_setup, image_teardown);
     tcase_add_test(tc_read, test_vmi_read_ksym);
     tcase_add_test(tc_read, test_vmi_read_va);
     tcase_add_test(tc_read, test_vmi_read_pa);
@@ -295,6 +407,8 @@ TCase *read_tcase (void)
     tcase_add_test(tc_read, test_vmi_read_64_pa);
     // vmi_read_addr_pa
     // vmi_read_str_pa
+    tcase_add_test(tc_read, test_read_pa_batch);
+    tcase_add_test(tc_read, test_map_pa);
   
     return tc_read;
 }
@@ -22,6 +22,8 @@
  * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include "../libvmi/libvmi.h"
 #include "check_tests.h"
@@ -127,14 +129,240 @@ START_TEST (test_libvmi_ksym2v)
 }
 END_TEST
 
+/* ranges are split into physically contiguous runs, large pages in one
+ * run, and large virtual reads and writes go through them */
+START_TEST (test_translate_range)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_LEGACY);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t va = 0x400000;
+    vmi_extent_t *extents = NULL;
+    uint32_t *buf = malloc(9 * PAGE_SIZE);
+    uint32_t entry = 0;
+    uint32_t value = 0;
+    cache_stats_t stats;
+    size_t n = 0;
+    int i = 0;
+
+    /* va maps pages 10-13 and 20-23, then a hole; va + 4MiB is a large
+     * page at physical address 0 */
+    map_legacy_pages(vmi, 10, 4);
+    for (i = 4; i < 9; ++i) {
+        entry = i < 8 ? ((16 + i) * PAGE_SIZE) | 1 : 0;
+        vmi_write_32_pa(vmi, 2 * PAGE_SIZE + i * 4, &entry);
+    }
+    entry = 0x81;
+    vmi_write_32_pa(vmi, dtb + 8, &entry);
+
+    n = vmi_translate_range(vmi, dtb, va, 9 * PAGE_SIZE, &extents);
+    fail_unless(n == 2, "wrong number of runs");
+    fail_unless(extents[0].vaddr == va && extents[0].paddr == 10 * PAGE_SIZE &&
+                extents[0].length == 4 * PAGE_SIZE, "wrong first run");
+    fail_unless(extents[1].vaddr == va + 4 * PAGE_SIZE &&
+                extents[1].paddr == 20 * PAGE_SIZE &&
+                extents[1].length == 4 * PAGE_SIZE, "wrong second run");
+    free(extents);
+
+    /* the pages walked were cached, and are taken from the cache again */
+    vmi_reset_cache_stats(vmi);
+    n = vmi_translate_range(vmi, dtb, va, 9 * PAGE_SIZE, &extents);
+    fail_unless(n == 2 && extents[1].length == 4 * PAGE_SIZE,
+                "wrong runs from the cache");
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    fail_unless(stats.hits == 8 && stats.inserts == 0,
+                "range not served from the v2p cache");
+    free(extents);
+
+    n = vmi_translate_range(vmi, dtb, 0x803000, 5 * PAGE_SIZE, &extents);
+    fail_unless(n == 1 && extents[0].paddr == 3 * PAGE_SIZE &&
+                extents[0].length == 5 * PAGE_SIZE, "wrong large page run");
+    free(extents);
+
+    vmi_pidcache_add(vmi, 1, dtb);
+    fail_unless(vmi_read_va(vmi, va, 1, buf, 8 * PAGE_SIZE) == 8 * PAGE_SIZE,
+                "read through range failed");
+    for (i = 0; i < 8; ++i) {
+        fail_unless(buf[i * PAGE_SIZE / 4] ==
+                    ((1 << 16) | ((i < 4 ? 10 : 16) + i)),
+                    "wrong data read through range");
+    }
+
+    memset(buf, 0x5a, 5 * PAGE_SIZE);
+    fail_unless(vmi_write_va(vmi, va + 2 * PAGE_SIZE, 1, buf, 5 * PAGE_SIZE) ==
+                5 * PAGE_SIZE, "write through range failed");
+    vmi_read_32_pa(vmi, 13 * PAGE_SIZE + 100, &value);
+    fail_unless(value == 0x5a5a5a5a, "range write missed a page");
+    vmi_read_32_pa(vmi, 23 * PAGE_SIZE, &value);
+    fail_unless(value == ((1 << 16) | 23), "range write went too far");
+
+    fail_unless(vmi_read_va(vmi, va, 1, buf, 9 * PAGE_SIZE) == 8 * PAGE_SIZE,
+                "read did not stop at the hole");
+
+    free(buf);
+}
+END_TEST
+
+static status_t
+collect_extent (vmi_instance_t vmi, vmi_page_extent_t *extent, void *data)
+{
+    vmi_page_extent_t *out = (vmi_page_extent_t *) data;
+
+    while (out->length) {
+        ++out;
+    }
+    *out = *extent;
+    return VMI_SUCCESS;
+}
+
+static status_t
+stop_walk (vmi_instance_t vmi, vmi_page_extent_t *extent, void *data)
+{
+    ++*(int *) data;
+    return VMI_FAILURE;
+}
+
+START_TEST (test_walk_address_space)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_IA32E);
+    addr_t dtb = 1 * PAGE_SIZE;
+    vmi_page_extent_t extents[8];
+    uint8_t zero[PAGE_SIZE];
+    uint64_t entry = 0;
+    int calls = 0;
+    int i = 0;
+
+    /* PML4 at page 1, PDPTs at pages 2 and 5, PD at page 3, page table at
+     * page 4: 0x200000 maps pages 10-13 and then two read-only pages, one
+     * of them not executable, 0x400000 is a 2MB kernel page and the top
+     * 1GB of the address space a 1GB page */
+    memset(zero, 0, sizeof(zero));
+    for (i = 1; i <= 5; ++i) {
+        vmi_write_pa(vmi, i * PAGE_SIZE, zero, PAGE_SIZE);
+    }
+    entry = (2 * PAGE_SIZE) | 7;
+    vmi_write_64_pa(vmi, dtb, &entry);
+    entry = (5 * PAGE_SIZE) | 3;
+    vmi_write_64_pa(vmi, dtb + 511 * 8, &entry);
+    entry = (3 * PAGE_SIZE) | 7;
+    vmi_write_64_pa(vmi, 2 * PAGE_SIZE, &entry);
+    entry = (4 * PAGE_SIZE) | 7;
+    vmi_write_64_pa(vmi, 3 * PAGE_SIZE + 8, &entry);
+    entry = 0x600000 | 0x83;
+    vmi_write_64_pa(vmi, 3 * PAGE_SIZE + 16, &entry);
+    for (i = 0; i < 4; ++i) {
+        entry = ((10 + i) * PAGE_SIZE) | 7;
+        vmi_write_64_pa(vmi, 4 * PAGE_SIZE + i * 8, &entry);
+    }
+    entry = (20 * PAGE_SIZE) | 5;
+    vmi_write_64_pa(vmi, 4 * PAGE_SIZE + 4 * 8, &entry);
+    entry = (21 * PAGE_SIZE) | 5 | (1ULL << 63);
+    vmi_write_64_pa(vmi, 4 * PAGE_SIZE + 5 * 8, &entry);
+    entry = 0x40000000 | 0x83;
+    vmi_write_64_pa(vmi, 5 * PAGE_SIZE + 511 * 8, &entry);
+
+    memset(extents, 0, sizeof(extents));
+    fail_unless(VMI_SUCCESS ==
+                vmi_walk_address_space(vmi, dtb, collect_extent, extents),
+                "walk failed");
+    fail_unless(extents[0].vaddr == 0x200000 &&
+                extents[0].paddr == 10 * PAGE_SIZE &&
+                extents[0].length == 4 * PAGE_SIZE &&
+                extents[0].page_size == PAGE_SIZE &&
+                extents[0].permissions ==
+                (VMI_PAGE_WRITE | VMI_PAGE_USER | VMI_PAGE_EXEC),
+                "wrong first run");
+    fail_unless(extents[1].vaddr == 0x204000 &&
+                extents[1].paddr == 20 * PAGE_SIZE &&
+                extents[1].length == PAGE_SIZE &&
+                extents[1].permissions == (VMI_PAGE_USER | VMI_PAGE_EXEC),
+                "read-only page not split off");
+    fail_unless(extents[2].vaddr == 0x205000 &&
+                extents[2].permissions == VMI_PAGE_USER,
+                "execute-disabled page not split off");
+    fail_unless(extents[3].vaddr == 0x400000 &&
+                extents[3].paddr == 0x600000 &&
+                extents[3].length == 0x200000 &&
+                extents[3].page_size == 0x200000 &&
+                extents[3].permissions == (VMI_PAGE_WRITE | VMI_PAGE_EXEC),
+                "wrong large page");
+    fail_unless(extents[4].vaddr == 0xFFFFFFFFC0000000ULL &&
+                extents[4].paddr == 0x40000000 &&
+                extents[4].page_size == 0x40000000,
+                "wrong 1GB page in the upper half");
+    fail_unless(extents[5].length == 0, "too many runs");
+
+    fail_unless(VMI_FAILURE ==
+                vmi_walk_address_space(vmi, dtb, stop_walk, &calls) &&
+                calls == 1, "walk did not stop");
+}
+END_TEST
+
+/* physical pages resolve to every cached virtual address that maps
+ * them, checked against the page tables when they may be stale */
+START_TEST (test_translate_p2v)
+{
+    vmi_instance_t vmi = init_image(VMI_INIT_WRITE, NULL, VMI_PM_IA32E);
+    addr_t dtb = 1 * PAGE_SIZE;
+    addr_t dtb2 = 6 * PAGE_SIZE;
+    vmi_p2v_t *mappings = NULL;
+    cache_stats_t stats;
+    uint64_t entry = 0;
+
+    vmi_set_p2v_index(vmi, 1);
+
+    /* the PML4 at page 6 shares the tables below the one at page 1, which
+     * map 0x200000 to pages 10 and 11 */
+    map_ia32e_pages(vmi, 10, 2);
+    entry = (2 * PAGE_SIZE) | 1;
+    vmi_write_64_pa(vmi, dtb2, &entry);
+
+    vmi_pagetable_lookup(vmi, dtb, 0x200000);
+    vmi_pagetable_lookup(vmi, dtb, 0x201000);
+    vmi_pagetable_lookup(vmi, dtb2, 0x200010);
+    fail_unless(vmi_translate_p2v(vmi, 10 * PAGE_SIZE + 0x20, &mappings) == 2,
+                "wrong number of mappings");
+    fail_unless(mappings[0].vaddr == 0x200020 && mappings[1].vaddr == 0x200020 &&
+                mappings[0].dtb + mappings[1].dtb == dtb + dtb2,
+                "wrong mappings");
+    free(mappings);
+    vmi_get_cache_stats(vmi, VMI_CACHE_P2V, &stats);
+    fail_unless(stats.entries == 3 && stats.hits == 1, "wrong p2v counters");
+
+    /* flushing a dtb drops only its own entries */
+    vmi_v2pcache_flush_dtb(vmi, dtb2);
+    fail_unless(vmi_translate_p2v(vmi, 10 * PAGE_SIZE, &mappings) == 1 &&
+                mappings[0].dtb == dtb, "dtb flush dropped the wrong entries");
+    free(mappings);
+
+    /* entries of an earlier epoch are checked before they are returned */
+    entry = (12 * PAGE_SIZE) | 1;
+    vmi_write_64_pa(vmi, 4 * PAGE_SIZE, &entry);
+    fail_unless(vmi_translate_p2v(vmi, 10 * PAGE_SIZE, &mappings) == 0 &&
+                mappings == NULL, "stale mapping returned");
+    fail_unless(vmi_translate_p2v(vmi, 11 * PAGE_SIZE, &mappings) == 1 &&
+                mappings[0].vaddr == 0x201000, "valid mapping dropped");
+    free(mappings);
+
+    vmi_set_p2v_index(vmi, 0);
+    vmi_get_cache_stats(vmi, VMI_CACHE_P2V, &stats);
+    fail_unless(stats.entries == 0, "index not freed");
+    fail_unless(vmi_translate_p2v(vmi, 11 * PAGE_SIZE, &mappings) == 0,
+                "disabled index used");
+}
+END_TEST
+
 /* translate test cases */
 TCase *translate_tcase (void)
 {
     TCase *tc_translate = tcase_create("LibVMI Translate");
     tcase_set_timeout(tc_translate, 30);
+    tcase_add_checked_fixture(tc_translate, image_setup, image_teardown);
     tcase_add_test(tc_translate, test_libvmi_ksym2v);
     // uv2p
     tcase_add_test(tc_translate, test_libvmi_kv2p);
     tcase_add_test(tc_translate, test_libvmi_piddtb);
+    tcase_add_test(tc_translate, test_translate_range);
+    tcase_add_test(tc_translate, test_walk_address_space);
+    tcase_add_test(tc_translate, test_translate_p2v);
     return tc_translate;
 }
@@ -0,0 +1,99 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures physical read throughput from a memory image through the
+ * file driver.  The whole image is read front to back with vmi_read_pa
+ * in chunks of the given size and the rate is reported in MB/s.
+ *
+ * Usage: file_read <memory image> <chunk size> <loops>
+ *
+ * A synthetic image can be created with "truncate -s 4G image".
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "common.h"
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    char *image = NULL;
+    size_t chunk = 0;
+    int loops = 0;
+    int i = 0;
+    long int diff;
+    long int *data = NULL;
+    unsigned char *buf = NULL;
+    addr_t pa = 0;
+    uint64_t size = 0;
+    uint64_t total = 0;
+
+    if (argc != 4) {
+        printf("Usage: %s <memory image> <chunk size> <loops>\n", argv[0]);
+        return 1;
+    }
+    image = argv[1];
+    chunk = atoi(argv[2]);
+    loops = atoi(argv[3]);
+    data = malloc(loops * sizeof(long int));
+    buf = malloc(chunk);
+
+    if (VMI_FAILURE ==
+        vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL, image)) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+    size = vmi_get_memsize(vmi);
+
+    for (i = 0; i < loops; ++i) {
+        total = 0;
+        gettimeofday(&ktv_start, 0);
+        /* frame 0 is never mapped, so start at the second page */
+        for (pa = 4096; pa + chunk <= size; pa += chunk) {
+            total += vmi_read_pa(vmi, pa, buf, chunk);
+        }
+        gettimeofday(&ktv_end, 0);
+        print_measurement(ktv_start, ktv_end, &diff);
+        data[i] = diff;
+    }
+    avg_measurement(data, loops);
+    printf("read %"PRIu64" bytes, %f MB/s\n", total,
+           (double) total / (double) data[loops - 1]);
+
+    vmi_destroy(vmi);
+    free(buf);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures the cost of a page cache hit as the number of cached pages
+ * grows.  For each working set size, the pages are read once to populate
+ * the cache and then read again in random order so that every access is
+ * a hit.  The per-read time should stay flat as the working set grows.
+ * The image is opened with VMI_INIT_NOMMAP so that its pages go through
+ * the page cache instead of the file driver's mapping.
+ *
+ * Usage: page_cache <memory image> <loops>
+ *
+ * The image must be a little over 4GB to cover the largest working set
+ * of 1M pages after frame 0; a sparse file is fine.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "common.h"
+
+#define PAGE_SIZE 4096
+#define NUM_HITS 1000000
+
+/* working set sizes in pages, up to 1M pages (4GB) */
+static const uint32_t working_sets[] = {
+    512, 2048, 8192, 32768, 131072, 524288, 1024 * 1024
+};
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    char *image = NULL;
+    int loops = 0;
+    int i = 0;
+    int j = 0;
+    long int diff;
+    long int *data = NULL;
+    double total = 0.0;
+    uint32_t pages = 0;
+    uint32_t w = 0;
+    uint32_t p = 0;
+    uint8_t value = 0;
+    uint32_t *order = malloc(NUM_HITS * sizeof(uint32_t));
+
+    if (argc != 3) {
+        printf("Usage: %s <memory image> <loops>\n", argv[0]);
+        return 1;
+    }
+    image = argv[1];
+    loops = atoi(argv[2]);
+    data = malloc(loops * sizeof(long int));
+
+    if (VMI_FAILURE ==
+        vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL | VMI_INIT_NOMMAP,
+                 image)) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+
+    for (w = 0; w < sizeof(working_sets) / sizeof(working_sets[0]); ++w) {
+        pages = working_sets[w];
+        if ((uint64_t) (pages + 1) * PAGE_SIZE >= vmi_get_memsize(vmi)) {
+            printf("image too small for %u pages\n", pages);
+            break;
+        }
+
+        vmi_set_page_cache_limits(vmi, (uint64_t) pages * PAGE_SIZE, 0,
+                                  VMI_PAGE_CACHE_LRU);
+
+        /* populate the cache, skipping frame 0 which is never mapped */
+        for (p = 1; p <= pages; ++p) {
+            vmi_read_8_pa(vmi, (addr_t) p * PAGE_SIZE, &value);
+        }
+
+        srand(pages);
+        for (j = 0; j < NUM_HITS; ++j) {
+            order[j] = 1 + (rand() % pages);
+        }
+
+        printf("working set %u pages:\n", pages);
+        total = 0.0;
+        for (i = 0; i < loops; ++i) {
+            gettimeofday(&ktv_start, 0);
+            for (j = 0; j < NUM_HITS; ++j) {
+                vmi_read_8_pa(vmi, (addr_t) order[j] * PAGE_SIZE, &value);
+            }
+            gettimeofday(&ktv_end, 0);
+            print_measurement(ktv_start, ktv_end, &diff);
+            data[i] = diff;
+            total += (double) diff;
+        }
+        avg_measurement(data, loops);
+        printf("mean ns per hit %f\n",
+               total / (double) loops * 1000.0 / (double) NUM_HITS);
+    }
+
+    vmi_destroy(vmi);
+    free(order);
+    free(data);
+    return 0;
+}
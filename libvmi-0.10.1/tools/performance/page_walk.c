@@ -0,0 +1,119 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures the cost of page-table walks over a range of a process's user
+ * address space.  Every loop starts with empty translation caches and
+ * translates each page of the range once, so every translation is a v2p
+ * cache miss.  The paging-structure cache statistics then give the guest
+ * reads of upper-level entries that these misses did not have to make.
+ *
+ * Usage: page_walk <vm name> <pid> <start va> <length> <loops>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "common.h"
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    cache_stats_t v2p;
+    cache_stats_t paging;
+    char *name = NULL;
+    int pid = 0;
+    addr_t start = 0;
+    addr_t length = 0;
+    addr_t va = 0;
+    addr_t dtb = 0;
+    uint64_t mapped = 0;
+    int loops = 0;
+    int i = 0;
+    long int diff;
+    long int *data = NULL;
+
+    if (argc != 6) {
+        printf("Usage: %s <vm name> <pid> <start va> <length> <loops>\n",
+               argv[0]);
+        return 1;
+    }
+    name = argv[1];
+    pid = atoi(argv[2]);
+    start = strtoull(argv[3], NULL, 0);
+    length = strtoull(argv[4], NULL, 0);
+    loops = atoi(argv[5]);
+    data = malloc(loops * sizeof(long int));
+
+    if (VMI_FAILURE == vmi_init(&vmi, VMI_AUTO | VMI_INIT_COMPLETE, name)) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+    dtb = vmi_pid_to_dtb(vmi, pid);
+    if (!dtb) {
+        printf("Failed to find the page directory of pid %d.\n", pid);
+        vmi_destroy(vmi);
+        return 1;
+    }
+
+    vmi_pause_vm(vmi);
+    for (i = 0; i < loops; ++i) {
+        vmi_v2pcache_flush(vmi);
+        vmi_reset_cache_stats(vmi);
+        mapped = 0;
+        gettimeofday(&ktv_start, 0);
+        for (va = start; va < start + length; va += 4096) {
+            if (vmi_pagetable_lookup(vmi, dtb, va)) {
+                mapped++;
+            }
+        }
+        gettimeofday(&ktv_end, 0);
+        print_measurement(ktv_start, ktv_end, &diff);
+        data[i] = diff;
+    }
+    vmi_resume_vm(vmi);
+    avg_measurement(data, loops);
+
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &v2p);
+    vmi_get_cache_stats(vmi, VMI_CACHE_PAGING, &paging);
+    printf("%"PRIu64" of %"PRIu64" pages mapped\n", mapped, v2p.misses);
+    if (v2p.misses) {
+        printf("upper-level reads per miss %.3f, saved per miss %.3f\n",
+               (double) paging.misses / (double) v2p.misses,
+               (double) paging.hits / (double) v2p.misses);
+    }
+
+    vmi_destroy(vmi);
+    free(data);
+    return 0;
+}
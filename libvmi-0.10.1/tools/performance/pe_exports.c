@@ -0,0 +1,221 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures export lookups on a synthetic PE module.  A module with the
+ * given number of named exports is written to the image at 0x100000 and
+ * mapped at 0x400000 for pid 1, then every loop times parsing its export
+ * directory and resolving every export by name, by exact RVA and by an
+ * RVA just past each export.
+ *
+ * Usage: pe_exports <memory image> <exports> <loops>
+ *
+ * The image is overwritten; a scratch image can be created with
+ * "truncate -s 16M image".  At most 65536 exports are written.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "libvmi/peparse.h"
+#include "common.h"
+
+#define DTB         0x1000ULL
+#define PT          0x2000ULL
+#define PE_PA       0x100000ULL
+#define PE_VA       0x400000ULL
+#define MAX_EXPORTS 65536
+
+enum { PHASE_PARSE, PHASE_NAME, PHASE_EXACT, PHASE_NEAREST, PHASES };
+
+/* the module: headers, then the export section at 0x1000, then 16 bytes
+ * of code per export with the exports in a scrambled order; returns its
+ * size */
+static size_t
+build_module(
+    uint8_t **module,
+    uint32_t exports)
+{
+    uint32_t section = 0x1000;
+    uint32_t functions = section + sizeof(struct export_table);
+    uint32_t names = functions + exports * sizeof(uint32_t);
+    uint32_t ordinals = names + exports * sizeof(uint32_t);
+    uint32_t strings = ordinals + exports * sizeof(uint16_t);
+    uint32_t code = (strings + exports * 12 + 0xfff) & ~0xfff;
+    size_t size = code + exports * 16;
+    uint8_t *image = calloc(1, size);
+    struct dos_header *dos = (struct dos_header *) image;
+    struct pe_header *pe = (struct pe_header *) (image + 0x80);
+    struct optional_header_pe32 *oh =
+        (struct optional_header_pe32 *) (image + 0x80 + sizeof(*pe));
+    struct export_table *et = (struct export_table *) (image + section);
+    uint32_t i = 0;
+
+    dos->signature = IMAGE_DOS_HEADER;
+    dos->offset_to_pe = 0x80;
+    pe->signature = IMAGE_NT_SIGNATURE;
+    pe->size_of_optional_header = sizeof(*oh);
+    oh->magic = IMAGE_PE32_MAGIC;
+    oh->idd[IMAGE_DIRECTORY_ENTRY_EXPORT].virtual_address = section;
+    oh->idd[IMAGE_DIRECTORY_ENTRY_EXPORT].size = code - section;
+
+    et->name = strings;
+    et->number_of_functions = exports;
+    et->number_of_names = exports;
+    et->address_of_functions = functions;
+    et->address_of_names = names;
+    et->address_of_name_ordinals = ordinals;
+    for (i = 0; i < exports; ++i) {
+        uint32_t rva = code + ((i * 7919) % exports) * 16;
+
+        memcpy(image + functions + i * sizeof(uint32_t), &rva, sizeof(rva));
+        rva = strings + i * 12;
+        memcpy(image + names + i * sizeof(uint32_t), &rva, sizeof(rva));
+        memcpy(image + ordinals + i * sizeof(uint16_t), &i, sizeof(uint16_t));
+        snprintf((char *) image + strings + i * 12, 12, "Export%05u", i);
+    }
+
+    *module = image;
+    return size;
+}
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    static const char *phases[] = { "parse", "by name", "exact rva", "nearest rva" };
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    uint8_t *module = NULL;
+    size_t size = 0;
+    uint32_t exports = 0;
+    uint32_t *rvas = NULL;
+    uint32_t i = 0;
+    uint32_t entry = 0;
+    uint64_t found[PHASES];
+    long int diff;
+    long int *data[PHASES];
+    char name[12];
+    int loops = 0;
+    int phase = 0;
+    int j = 0;
+
+    if (argc != 4) {
+        printf("Usage: %s <memory image> <exports> <loops>\n", argv[0]);
+        return 1;
+    }
+    exports = strtoul(argv[2], NULL, 0);
+    loops = atoi(argv[3]);
+    if (!exports || exports > MAX_EXPORTS || loops <= 0) {
+        printf("Expected 1 to %d exports and at least one loop.\n", MAX_EXPORTS);
+        return 1;
+    }
+
+    if (VMI_FAILURE ==
+        vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL | VMI_INIT_WRITE,
+                 argv[1])) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+    /* the image holds no kernel, only the OS type is needed */
+    vmi_init_complete(&vmi, "{ostype = \"Windows\";}");
+    vmi_set_page_mode(vmi, VMI_PM_LEGACY);
+
+    size = build_module(&module, exports);
+    if (PE_PA + size > vmi_get_memsize(vmi)) {
+        printf("The image needs at least %"PRIu64" bytes.\n", (uint64_t) (PE_PA + size));
+        vmi_destroy(vmi);
+        return 1;
+    }
+    vmi_write_pa(vmi, PE_PA, module, size);
+    entry = PT | 1;
+    vmi_write_32_pa(vmi, DTB + (PE_VA >> 22) * 4, &entry);
+    for (i = 0; i * 4096 < size; ++i) {
+        entry = (PE_PA + i * 4096) | 1;
+        vmi_write_32_pa(vmi, PT + i * 4, &entry);
+    }
+    vmi_pidcache_add(vmi, 1, DTB);
+
+    rvas = malloc(exports * sizeof(uint32_t));
+    for (i = 0; i < exports; ++i) {
+        struct export_table *et = (struct export_table *) (module + 0x1000);
+
+        memcpy(&rvas[i], module + et->address_of_functions + i * 4, 4);
+    }
+    for (phase = 0; phase < PHASES; ++phase) {
+        data[phase] = malloc(loops * sizeof(long int));
+    }
+
+    for (j = 0; j < loops; ++j) {
+        memset(found, 0, sizeof(found));
+        for (phase = 0; phase < PHASES; ++phase) {
+            vmi_symcache_flush(vmi);
+            vmi_rvacache_flush(vmi);
+            if (PHASE_PARSE == phase) {
+                vmi_v2pcache_flush_dtb(vmi, DTB);
+            }
+
+            gettimeofday(&ktv_start, 0);
+            for (i = 0; i < (PHASE_PARSE == phase ? 1 : exports); ++i) {
+                if (PHASE_PARSE == phase || PHASE_NAME == phase) {
+                    snprintf(name, sizeof(name), "Export%05u", i);
+                    found[phase] += !!vmi_translate_sym2v(vmi, PE_VA, 1, name);
+                }
+                else {
+                    found[phase] += !!vmi_translate_v2sym(vmi, PE_VA, 1,
+                        rvas[i] + (PHASE_NEAREST == phase ? 8 : 0));
+                }
+            }
+            gettimeofday(&ktv_end, 0);
+            print_measurement(ktv_start, ktv_end, &diff);
+            data[phase][j] = diff;
+        }
+    }
+
+    for (phase = 0; phase < PHASES; ++phase) {
+        double total = 0.0;
+        uint32_t lookups = PHASE_PARSE == phase ? 1 : exports;
+
+        printf("%s: ", phases[phase]);
+        avg_measurement(data[phase], loops);
+        for (j = 0; j < loops; ++j) {
+            total += (double) data[phase][j];
+        }
+        printf("%s: %"PRIu64" of %u resolved, %.0f lookups per second\n",
+               phases[phase], found[phase], lookups,
+               total ? (double) lookups * loops * 1000000.0 / total : 0.0);
+        free(data[phase]);
+    }
+
+    vmi_destroy(vmi);
+    free(rvas);
+    free(module);
+    return 0;
+}
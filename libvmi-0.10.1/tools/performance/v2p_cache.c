@@ -0,0 +1,128 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures insert and lookup rates of the virtual to physical address
+ * cache.  Translations for the given number of pages, spread over 16
+ * address spaces, are added with vmi_v2pcache_add and then looked up
+ * again with vmi_pagetable_lookup.  Lookups that miss walk the (empty)
+ * page tables of the image, so the hit rate also shows the effect of
+ * the cache capacity.
+ *
+ * Usage: v2p_cache <memory image> <pages> <loops>
+ *
+ * A synthetic image can be created with "truncate -s 64M image".
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "common.h"
+
+#define NUM_DTBS 16
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    cache_stats_t stats;
+    char *image = NULL;
+    uint64_t pages = 0;
+    uint64_t i = 0;
+    int loops = 0;
+    int j = 0;
+    long int diff;
+    long int *insert = NULL;
+    long int *lookup = NULL;
+    addr_t va = 0;
+    addr_t dtb = 0;
+
+    if (argc != 4) {
+        printf("Usage: %s <memory image> <pages> <loops>\n", argv[0]);
+        return 1;
+    }
+    image = argv[1];
+    pages = strtoull(argv[2], NULL, 0);
+    loops = atoi(argv[3]);
+    insert = malloc(loops * sizeof(long int));
+    lookup = malloc(loops * sizeof(long int));
+
+    if (VMI_FAILURE ==
+        vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL, image)) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+    vmi_set_page_mode(vmi, VMI_PM_IA32E);
+
+    for (j = 0; j < loops; ++j) {
+        vmi_v2pcache_flush(vmi);
+        vmi_reset_cache_stats(vmi);
+
+        gettimeofday(&ktv_start, 0);
+        for (i = 0; i < pages; ++i) {
+            va = 0x7f0000000000ULL + (i / NUM_DTBS) * 4096;
+            dtb = (1 + i % NUM_DTBS) * 4096;
+            vmi_v2pcache_add(vmi, va, dtb, (1 + i) * 4096);
+        }
+        gettimeofday(&ktv_end, 0);
+        print_measurement(ktv_start, ktv_end, &diff);
+        insert[j] = diff;
+
+        gettimeofday(&ktv_start, 0);
+        for (i = 0; i < pages; ++i) {
+            va = 0x7f0000000000ULL + (i / NUM_DTBS) * 4096;
+            dtb = (1 + i % NUM_DTBS) * 4096;
+            vmi_pagetable_lookup(vmi, dtb, va);
+        }
+        gettimeofday(&ktv_end, 0);
+        print_measurement(ktv_start, ktv_end, &diff);
+        lookup[j] = diff;
+    }
+
+    printf("insert: ");
+    avg_measurement(insert, loops);
+    printf("lookup: ");
+    avg_measurement(lookup, loops);
+
+    vmi_get_cache_stats(vmi, VMI_CACHE_V2P, &stats);
+    printf("%"PRIu64" entries, %"PRIu64" bytes, %"PRIu64" of %"PRIu64
+           " lookups hit\n", stats.entries, stats.bytes, stats.hits,
+           stats.lookups);
+    printf("%.1f ns per insert, %.1f ns per lookup\n",
+           1000.0 * insert[loops - 1] / pages,
+           1000.0 * lookup[loops - 1] / pages);
+
+    vmi_destroy(vmi);
+    free(insert);
+    free(lookup);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures page-table walks per second in each paging mode.  Page tables
+ * mapping the given number of pages from 0x40000000 on are written to the
+ * image for legacy, PAE and IA-32e paging, and every loop translates each
+ * page once with empty translation caches, so every translation walks
+ * the page tables.
+ *
+ * Usage: v2p_modes <memory image> <pages> <loops>
+ *
+ * The image is overwritten; a scratch image can be created with
+ * "truncate -s 8M image".  At most 262144 pages are mapped.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "common.h"
+
+#define VA_START    0x40000000ULL
+#define PA_START    0x80000000ULL
+#define MAX_PAGES   (512 * 512)
+
+/* write one page of page-table entries */
+static int
+write_table(
+    vmi_instance_t vmi,
+    addr_t table,
+    uint64_t *entries,
+    int wide)
+{
+    uint32_t narrow[1024];
+    int i = 0;
+
+    if (!wide) {
+        for (i = 0; i < 1024; ++i) {
+            narrow[i] = (uint32_t) entries[i];
+        }
+        return vmi_write_pa(vmi, table, narrow, 4096) == 4096;
+    }
+    return vmi_write_pa(vmi, table, entries, 4096) == 4096;
+}
+
+/* the tables of one mode: the top level at dtb, the directories right
+ * after it and the page tables from pt on; returns the next free page */
+static addr_t
+build_tables(
+    vmi_instance_t vmi,
+    page_mode_t mode,
+    addr_t dtb,
+    addr_t pt,
+    uint64_t pages)
+{
+    uint64_t entries[1024];
+    int wide = (VMI_PM_LEGACY != mode);
+    uint64_t per_table = wide ? 512 : 1024;
+    uint64_t tables = (pages + per_table - 1) / per_table;
+    addr_t pd = dtb;
+    uint64_t i = 0;
+    uint64_t j = 0;
+
+    if (VMI_PM_IA32E == mode) {
+        memset(entries, 0, sizeof(entries));
+        entries[0] = (dtb + 4096) | 3;
+        write_table(vmi, dtb, entries, 1);
+        entries[0] = 0;
+        entries[1] = (dtb + 8192) | 3;
+        write_table(vmi, dtb + 4096, entries, 1);
+        pd = dtb + 8192;
+    }
+    else if (VMI_PM_PAE == mode) {
+        memset(entries, 0, sizeof(entries));
+        entries[1] = (dtb + 4096) | 1;
+        write_table(vmi, dtb, entries, 1);
+        pd = dtb + 4096;
+    }
+
+    memset(entries, 0, sizeof(entries));
+    for (i = 0; i < tables; ++i) {
+        entries[(wide ? 0 : 256) + i] = (pt + i * 4096) | 3;
+    }
+    write_table(vmi, pd, entries, wide);
+
+    for (i = 0; i < tables; ++i) {
+        memset(entries, 0, sizeof(entries));
+        for (j = 0; j < per_table && i * per_table + j < pages; ++j) {
+            entries[j] = (PA_START + (i * per_table + j) * 4096) | 3;
+        }
+        write_table(vmi, pt + i * 4096, entries, wide);
+    }
+    return pt + tables * 4096;
+}
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    static const page_mode_t modes[] = {
+        VMI_PM_LEGACY, VMI_PM_PAE, VMI_PM_IA32E
+    };
+    static const char *names[] = { "legacy", "PAE", "IA-32e" };
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    char *image = NULL;
+    addr_t dtb[3];
+    addr_t next = 0;
+    uint64_t pages = 0;
+    uint64_t mapped = 0;
+    uint64_t i = 0;
+    int loops = 0;
+    int m = 0;
+    int j = 0;
+    long int diff;
+    long int *data = NULL;
+    double total = 0.0;
+
+    if (argc != 4) {
+        printf("Usage: %s <memory image> <pages> <loops>\n", argv[0]);
+        return 1;
+    }
+    image = argv[1];
+    pages = strtoull(argv[2], NULL, 0);
+    loops = atoi(argv[3]);
+    if (!pages || pages > MAX_PAGES || loops <= 0) {
+        printf("Expected 1 to %d pages and at least one loop.\n", MAX_PAGES);
+        return 1;
+    }
+    data = malloc(loops * sizeof(long int));
+
+    if (VMI_FAILURE ==
+        vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL | VMI_INIT_WRITE,
+                 image)) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+
+    /* three pages of top-level tables and directories per mode first */
+    next = 10 * 4096;
+    for (m = 0; m < 3; ++m) {
+        dtb[m] = (1 + 3 * m) * 4096;
+        next = build_tables(vmi, modes[m], dtb[m], next, pages);
+    }
+    if (next > vmi_get_memsize(vmi)) {
+        printf("The image needs at least %"PRIu64" bytes.\n", next);
+        vmi_destroy(vmi);
+        return 1;
+    }
+
+    for (m = 0; m < 3; ++m) {
+        vmi_set_page_mode(vmi, modes[m]);
+        for (j = 0; j < loops; ++j) {
+            vmi_v2pcache_flush(vmi);
+            mapped = 0;
+            gettimeofday(&ktv_start, 0);
+            for (i = 0; i < pages; ++i) {
+                if (vmi_pagetable_lookup(vmi, dtb[m], VA_START + i * 4096)) {
+                    mapped++;
+                }
+            }
+            gettimeofday(&ktv_end, 0);
+            print_measurement(ktv_start, ktv_end, &diff);
+            data[j] = diff;
+        }
+
+        printf("%s: ", names[m]);
+        avg_measurement(data, loops);
+        for (total = 0.0, j = 0; j < loops; ++j) {
+            total += (double) data[j];
+        }
+        printf("%s: %"PRIu64" of %"PRIu64" pages mapped, %.0f translations per second\n",
+               names[m], mapped, pages,
+               total ? (double) pages * loops * 1000000.0 / total : 0.0);
+    }
+
+    vmi_destroy(vmi);
+    free(data);
+    return 0;
+}
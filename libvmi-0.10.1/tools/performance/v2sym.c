@@ -0,0 +1,121 @@
+/* The LibVMI Library is an introspection library that simplifies access to 
+ * memory in a target virtual machine or in a file containing a dump of 
+ * a system's physical memory.  LibVMI is based on the XenAccess Library.
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * Author: Bryan D. Payne (bdpayne@acm.org)
+ *
+ * This file is part of LibVMI.
+ *
+ * LibVMI is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * LibVMI is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LibVMI.  If not, see <http://www.gnu.org/licenses/>.
+ */  
+
+/*
+ * Measures reverse symbol lookups with vmi_translate_v2sym on Linux.  The
+ * given number of random addresses between _text and _etext is resolved
+ * twice: the first pass searches the parsed System.map and fills the RVA
+ * cache, the second pass is served from the cache.
+ *
+ * Usage: v2sym <memory image> <System.map> <lookups>
+ *
+ * The image only needs to exist; "truncate -s 1M image" will do.  The
+ * System.map also needs swapper_pg_dir for vmi_init_complete.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include "libvmi/libvmi.h"
+#include "common.h"
+
+    int
+main(
+    int argc,
+    char **argv)
+{
+    static const char *passes[] = { "search", "cached" };
+    vmi_instance_t vmi;
+    struct timeval ktv_start;
+    struct timeval ktv_end;
+    char config[1024];
+    addr_t *addrs = NULL;
+    addr_t text = 0;
+    addr_t etext = 0;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    uint64_t lookups = 0;
+    uint64_t found = 0;
+    uint64_t i = 0;
+    int pass = 0;
+    long int diff;
+
+    if (argc != 4) {
+        printf("Usage: %s <memory image> <System.map> <lookups>\n", argv[0]);
+        return 1;
+    }
+    lookups = strtoull(argv[3], NULL, 0);
+    if (!lookups) {
+        printf("Expected at least one lookup.\n");
+        return 1;
+    }
+    snprintf(config, sizeof(config),
+             "{ostype = \"Linux\"; sysmap = \"%s\";}", argv[2]);
+
+    if (VMI_FAILURE ==
+        vmi_init(&vmi, VMI_FILE | VMI_INIT_PARTIAL, argv[1]) ||
+        VMI_FAILURE == vmi_init_complete(&vmi, config)) {
+        printf("Failed to init LibVMI library.\n");
+        return 1;
+    }
+
+    text = vmi_translate_ksym2v(vmi, "_text");
+    etext = vmi_translate_ksym2v(vmi, "_etext");
+    if (!text || etext <= text) {
+        printf("The System.map needs _text and _etext.\n");
+        vmi_destroy(vmi);
+        return 1;
+    }
+
+    /* xorshift, so every run resolves the same addresses */
+    addrs = malloc(lookups * sizeof(addr_t));
+    for (i = 0; i < lookups; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        addrs[i] = text + seed % (etext - text);
+    }
+
+    for (pass = 0; pass < 2; ++pass) {
+        found = 0;
+        gettimeofday(&ktv_start, 0);
+        for (i = 0; i < lookups; ++i) {
+            if (vmi_translate_v2sym(vmi, 0, 0, addrs[i])) {
+                found++;
+            }
+        }
+        gettimeofday(&ktv_end, 0);
+        printf("%s: ", passes[pass]);
+        print_measurement(ktv_start, ktv_end, &diff);
+        printf("%s: %"PRIu64" of %"PRIu64" addresses resolved, %.0f lookups per second\n",
+               passes[pass], found, lookups,
+               diff ? (double) lookups * 1000000.0 / diff : 0.0);
+    }
+
+    vmi_destroy(vmi);
+    free(addrs);
+    return 0;
+}
@@ -277,6 +277,50 @@ pyvmi_translate_uv2p(
     return Py_BuildValue("K", paddr);
 }
 
+static PyObject *
+pyvmi_translate_p2v(
+    PyObject * self,
+    PyObject * args)
+{
+    addr_t paddr;
+    vmi_p2v_t *mappings = NULL;
+    PyObject *list = NULL;
+    size_t count = 0;
+    size_t i = 0;
+
+    if (!PyArg_ParseTuple(args, "K", &paddr)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid argument(s) to function");
+        return NULL;
+    }
+
+    count = vmi_translate_p2v(vmi(self), paddr, &mappings);
+    list = PyList_New(count);
+    for (i = 0; i < count; ++i) {
+        PyList_SetItem(list, i, Py_BuildValue("(KK)", mappings[i].dtb,
+                                              mappings[i].vaddr));
+    }
+    free(mappings);
+    return list;
+}
+
+static PyObject *
+pyvmi_set_p2v_index(
+    PyObject * self,
+    PyObject * args)
+{
+    int enable;
+
+    if (!PyArg_ParseTuple(args, "i", &enable)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid argument(s) to function");
+        return NULL;
+    }
+
+    vmi_set_p2v_index(vmi(self), enable);
+    return Py_BuildValue("");   // return None
+}
+
 static PyObject *
 pyvmi_translate_ksym2v(
     PyObject * self,
@@ -1902,6 +1946,23 @@ pyvmi_v2pcache_flush(
     return Py_BuildValue("");   // return None
 }
 
+static PyObject *
+pyvmi_v2pcache_flush_dtb(
+    PyObject * self,
+    PyObject * args)
+{
+    addr_t dtb;
+
+    if (!PyArg_ParseTuple(args, "K", &dtb)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid argument(s) to function");
+        return NULL;
+    }
+
+    vmi_v2pcache_flush_dtb(vmi(self), dtb);
+    return Py_BuildValue("");   // return None
+}
+
 static PyObject *
 pyvmi_v2pcache_add(
     PyObject * self,
@@ -1977,6 +2038,84 @@ pyvmi_pidcache_add(
     return Py_BuildValue("");   // return None
 }
 
+static PyObject *
+pyvmi_get_cache_stats(
+    PyObject * self,
+    PyObject * args)
+{
+    char *name;
+    cache_type_t cache;
+    cache_stats_t stats;
+
+    if (!PyArg_ParseTuple(args, "s", &name)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Invalid argument(s) to function");
+        return NULL;
+    }
+
+    if (strcmp(name, "page") == 0) {
+        cache = VMI_CACHE_PAGE;
+    }
+    else if (strcmp(name, "v2p") == 0) {
+        cache = VMI_CACHE_V2P;
+    }
+    else if (strcmp(name, "pid") == 0) {
+        cache = VMI_CACHE_PID;
+    }
+    else if (strcmp(name, "sym") == 0) {
+        cache = VMI_CACHE_SYM;
+    }
+    else if (strcmp(name, "rva") == 0) {
+        cache = VMI_CACHE_RVA;
+    }
+    else if (strcmp(name, "paging") == 0) {
+        cache = VMI_CACHE_PAGING;
+    }
+    else if (strcmp(name, "tlb") == 0) {
+        cache = VMI_CACHE_TLB;
+    }
+    else if (strcmp(name, "v2p_miss") == 0) {
+        cache = VMI_CACHE_V2P_MISS;
+    }
+    else if (strcmp(name, "p2v") == 0) {
+        cache = VMI_CACHE_P2V;
+    }
+    else if (strcmp(name, "export") == 0) {
+        cache = VMI_CACHE_EXPORT;
+    }
+    else {
+        PyErr_SetString(PyExc_ValueError,
+                        "Unknown cache, expected page, v2p, pid, sym, rva, "
+                        "paging, tlb, v2p_miss, p2v or export");
+        return NULL;
+    }
+
+    if (VMI_FAILURE == vmi_get_cache_stats(vmi(self), cache, &stats)) {
+        PyErr_SetString(PyExc_ValueError, "Unable to get cache statistics");
+        return NULL;
+    }
+
+    return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+                         "lookups", stats.lookups,
+                         "hits", stats.hits,
+                         "misses", stats.misses,
+                         "inserts", stats.inserts,
+                         "evictions", stats.evictions,
+                         "invalidations", stats.invalidations,
+                         "refreshes", stats.refreshes,
+                         "entries", stats.entries,
+                         "bytes", stats.bytes);
+}
+
+static PyObject *
+pyvmi_reset_cache_stats(
+    PyObject * self,
+    PyObject * args)
+{
+    vmi_reset_cache_stats(vmi(self));
+    return Py_BuildValue("");   // return None
+}
+
 //-------------------------------------------------------------------
 // Python interface
 
@@ -1988,6 +2127,10 @@ static PyMethodDef pyvmi_instance_methods[] = {
      "Translate kernel virtual address to physical address"},
     {"translate_uv2p", pyvmi_translate_uv2p, METH_VARARGS,
      "Translate user virtual address to physical address"},
+    {"translate_p2v", pyvmi_translate_p2v, METH_VARARGS,
+     "Translate physical address to a list of (dtb, virtual address)"},
+    {"set_p2v_index", pyvmi_set_p2v_index, METH_VARARGS,
+     "Enable or disable the index used by translate_p2v"},
     {"translate_ksym2v", pyvmi_translate_ksym2v, METH_VARARGS,
      "Translate kernel symbol to virtual address"},
     {"pid_to_dtb", pyvmi_pid_to_dtb, METH_VARARGS,
@@ -2099,6 +2242,8 @@ static PyMethodDef pyvmi_instance_methods[] = {
 
     {"v2pcache_flush", pyvmi_v2pcache_flush, METH_VARARGS,
      "Remove all entries from the virtual to physical cache"},
+    {"v2pcache_flush_dtb", pyvmi_v2pcache_flush_dtb, METH_VARARGS,
+     "Remove the entries of one address space from the virtual to physical cache"},
     {"v2pcache_add", pyvmi_v2pcache_add, METH_VARARGS,
      "Add an entry to the virtual to physical cache"},
     {"symcache_flush", pyvmi_symcache_flush, METH_VARARGS,
@@ -2109,6 +2254,11 @@ static PyMethodDef pyvmi_instance_methods[] = {
      "Remove all entries from the pid to dtb cache"},
     {"pidcache_add", pyvmi_pidcache_add, METH_VARARGS,
      "Add an entry to the pid to dtb cache"},
+    {"get_cache_stats", pyvmi_get_cache_stats, METH_VARARGS,
+     "Get statistics for a cache: page, v2p, pid, sym, rva, paging, tlb, "
+     "v2p_miss, p2v or export"},
+    {"reset_cache_stats", pyvmi_reset_cache_stats, METH_VARARGS,
+     "Reset the statistics of all caches"},
 
     {NULL, NULL, 0, NULL}   /* Sentinel */
 };